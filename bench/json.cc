@@ -0,0 +1,739 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#include "zen/alloc.hpp"
+#include "zen/json.hpp"
+#include "zen/json_decoder.hpp"
+#include "zen/json_document.hpp"
+#include "zen/json_encoder.hpp"
+#include "zen/json_parallel.hpp"
+#include "zen/json_path.hpp"
+#include "zen/ndjson.hpp"
+#include "zen/transformer.hpp"
+
+// Every allocation of the process goes through these, so that a benchmark
+// can report how many allocations it needed. The counters are atomic because
+// some of the parsers spawn threads.
+
+static std::atomic<std::size_t> allocation_count = 0;
+static std::atomic<std::size_t> allocated_bytes = 0;
+
+void* operator new(std::size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  if (auto ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+// The default memory resource of std::pmr allocates through these
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  auto align = static_cast<std::size_t>(alignment);
+  if (auto ptr = std::aligned_alloc(align, (size + align - 1) / align * align)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+
+/// Forget about the highest memory usage so far, so that the next call to
+/// peak_rss_kib() only reflects what happened in between.
+static void reset_peak_rss() {
+#ifdef __linux__
+  std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+}
+
+/// Get the highest resident set size of the process in kibibytes, or 0 if
+/// the platform has no means to tell.
+static long peak_rss_kib() {
+#ifdef __linux__
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.rfind("VmHWM:", 0) == 0) {
+      return std::strtol(line.c_str() + 6, nullptr, 10);
+    }
+  }
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+  }
+#endif
+  return 0;
+}
+
+struct bench_result {
+  std::string corpus;
+  std::string name;
+  std::size_t bytes;
+  double seconds;
+  std::size_t allocations;
+  std::size_t allocated_bytes;
+  long peak_rss_kib;
+};
+
+static void print_json_string(std::string_view str, std::ostream& out) {
+  out << '"';
+  for (auto ch: str) {
+    if (ch == '"' || ch == '\\') {
+      out << '\\';
+    }
+    out << ch;
+  }
+  out << '"';
+}
+
+template<typename T>
+static bool succeeded(T& result) {
+  return result.is_right();
+}
+
+static bool succeeded(bool ok) {
+  return ok;
+}
+
+/// Runs benchmarks and collects their results.
+///
+/// Each benchmark runs a number of times and the fastest run is reported,
+/// together with the allocations of that run and the peak memory usage
+/// over all runs.
+class bench_suite {
+
+  std::size_t iterations;
+  std::string filter;
+  bool quiet;
+
+  std::vector<bench_result> results;
+
+public:
+
+  bench_suite(std::size_t iterations, std::string filter, bool quiet):
+    iterations(iterations), filter(std::move(filter)), quiet(quiet) {}
+
+  bool enabled(std::string_view corpus, std::string_view name) const {
+    if (filter.empty()) {
+      return true;
+    }
+    std::string full(corpus);
+    full += '/';
+    full += name;
+    return full.find(filter) != std::string::npos;
+  }
+
+  template<typename F>
+  void run(std::string corpus, std::string name, std::size_t bytes, F fn) {
+    if (!enabled(corpus, name)) {
+      return;
+    }
+    bench_result r { corpus, name, bytes, 0, 0, 0, 0 };
+    reset_peak_rss();
+    for (std::size_t i = 0; i < iterations; ++i) {
+      auto count_before = allocation_count.load();
+      auto bytes_before = allocated_bytes.load();
+      auto start = std::chrono::steady_clock::now();
+      auto result = fn();
+      auto end = std::chrono::steady_clock::now();
+      if (!succeeded(result)) {
+        std::cerr << corpus << "/" << name << ": failed on the generated document\n";
+        std::exit(1);
+      }
+      std::chrono::duration<double> elapsed = end - start;
+      if (i == 0 || elapsed.count() < r.seconds) {
+        r.seconds = elapsed.count();
+        r.allocations = allocation_count.load() - count_before;
+        r.allocated_bytes = allocated_bytes.load() - bytes_before;
+      }
+    }
+    r.peak_rss_kib = peak_rss_kib();
+    if (!quiet) {
+      auto mb = static_cast<double>(r.bytes) / (1024 * 1024);
+      std::cout << r.corpus << "/" << r.name << ": "
+                << mb / r.seconds << " MB/s, "
+                << r.allocations << " allocations, "
+                << r.peak_rss_kib / 1024 << " MiB peak RSS ("
+                << r.seconds << " s)" << std::endl;
+    }
+    results.push_back(std::move(r));
+  }
+
+  void print_json(std::ostream& out) const {
+    out << "{\"iterations\":" << iterations << ",\"results\":[";
+    bool first = true;
+    for (const auto& r: results) {
+      if (!first) {
+        out << ",";
+      }
+      first = false;
+      out << "\n  {\"corpus\":";
+      print_json_string(r.corpus, out);
+      out << ",\"name\":";
+      print_json_string(r.name, out);
+      out << ",\"bytes\":" << r.bytes
+          << ",\"seconds\":" << r.seconds
+          << ",\"mb_per_s\":" << static_cast<double>(r.bytes) / (1024 * 1024) / r.seconds
+          << ",\"allocations\":" << r.allocations
+          << ",\"allocated_bytes\":" << r.allocated_bytes
+          << ",\"peak_rss_kib\":" << r.peak_rss_kib << "}";
+    }
+    out << "\n]}\n";
+  }
+
+};
+
+/// Generates a document of roughly `target_size` bytes that consists of rows
+/// of scalars, so that the time spent scanning the input dominates.
+static std::string generate_document(std::size_t target_size) {
+  std::string out;
+  out.reserve(target_size + 256);
+  out.push_back('[');
+  for (std::size_t i = 0; out.size() < target_size; ++i) {
+    if (i > 0) {
+      out.push_back(',');
+    }
+    out += "[";
+    out += std::to_string(i);
+    out += ",\"record number ";
+    out += std::to_string(i);
+    out += "\",[\"alpha\",\"beta\",\"gamma\"],true,null]";
+  }
+  out.push_back(']');
+  return out;
+}
+
+/// Generates an array of objects that all have the same keys, like a typical
+/// event stream or database export.
+static std::string generate_records(std::size_t target_size) {
+  std::string out;
+  out.reserve(target_size + 256);
+  out.push_back('[');
+  for (std::size_t i = 0; out.size() < target_size; ++i) {
+    if (i > 0) {
+      out.push_back(',');
+    }
+    out += "{\"event_id\":";
+    out += std::to_string(i);
+    out += ",\"event_type\":\"click\",\"user_agent\":\"bench\",\"timestamp\":";
+    out += std::to_string(1700000000 + i);
+    out += ",\"is_authenticated\":true}";
+  }
+  out.push_back(']');
+  return out;
+}
+
+/// Generates rows of integers and floating-point numbers of all magnitudes,
+/// such as sensor readings or coordinates.
+static std::string generate_numbers(std::size_t target_size) {
+  std::mt19937_64 rng(42);
+  std::uniform_real_distribution<double> unit(-1, 1);
+  std::uniform_int_distribution<int> exponent(-30, 30);
+  char buffer[32];
+  std::string out;
+  out.reserve(target_size + 256);
+  out.push_back('[');
+  for (std::size_t i = 0; out.size() < target_size; ++i) {
+    if (i > 0) {
+      out.push_back(',');
+    }
+    out += "[";
+    out += std::to_string(static_cast<long long>(rng() >> 11) - (1ll << 52));
+    out += ",";
+    out += std::to_string(rng() % 1000);
+    for (int j = 0; j < 4; ++j) {
+      std::snprintf(buffer, sizeof(buffer), ",%.17g", unit(rng) * std::pow(10.0, exponent(rng)));
+      out += buffer;
+    }
+    std::snprintf(buffer, sizeof(buffer), ",%.2f]", unit(rng) * 1000);
+    out += buffer;
+  }
+  out.push_back(']');
+  return out;
+}
+
+/// Generates an array of objects that are nested `depth` levels deep, like
+/// the trees of a configuration file or an abstract syntax tree.
+static std::string generate_nested(std::size_t target_size, std::size_t depth = 32) {
+  std::string out;
+  out.reserve(target_size + 256);
+  out.push_back('[');
+  for (std::size_t i = 0; out.size() < target_size; ++i) {
+    if (i > 0) {
+      out.push_back(',');
+    }
+    for (std::size_t level = 0; level < depth; ++level) {
+      out += "{\"level\":";
+      out += std::to_string(level);
+      out += ",\"kind\":\"node\",\"child\":";
+    }
+    out += "{\"leaf\":[";
+    out += std::to_string(i);
+    out += ",true,null]}";
+    out.append(depth, '}');
+  }
+  out.push_back(']');
+  return out;
+}
+
+/// Generates an array of text that is full of escape sequences and
+/// characters outside of ASCII, both raw and escaped.
+static std::string generate_strings(std::size_t target_size) {
+  static const char* const fragments[] = {
+    "plain text without anything special in it ",
+    "a \\\"quoted\\\" word ",
+    "C:\\\\Users\\\\zen\\\\file.json ",
+    "line one\\nline two\\ttabbed ",
+    "caf\\u00e9 na\\u00efve \\u65e5\\u672c ",
+    "smile \\ud83d\\ude00 ",
+    "caf\xc3\xa9 na\xc3\xafve \xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e ",
+    "emoji \xf0\x9f\x98\x80\xf0\x9f\x8e\x89 ",
+  };
+  constexpr std::size_t fragment_count = sizeof(fragments) / sizeof(fragments[0]);
+  std::string out;
+  out.reserve(target_size + 256);
+  out.push_back('[');
+  for (std::size_t i = 0; out.size() < target_size; ++i) {
+    if (i > 0) {
+      out.push_back(',');
+    }
+    out.push_back('"');
+    for (std::size_t j = 0; j < 4; ++j) {
+      out += fragments[(i + j * 3) % fragment_count];
+    }
+    out += std::to_string(i);
+    out.push_back('"');
+  }
+  out.push_back(']');
+  return out;
+}
+
+static constexpr std::size_t catalog_attribute_count = 24;
+
+/// Generates a product catalog where every entry is an object with many
+/// fields of different types.
+static std::string generate_catalog(std::size_t target_size) {
+  std::string out;
+  out.reserve(target_size + 1024);
+  out.push_back('[');
+  for (std::size_t i = 0; out.size() < target_size; ++i) {
+    if (i > 0) {
+      out.push_back(',');
+    }
+    out += "{\"id\":";
+    out += std::to_string(i);
+    out += ",\"sku\":\"SKU-";
+    out += std::to_string(100000 + i);
+    out += "\",\"title\":\"Product ";
+    out += std::to_string(i);
+    out += "\",\"description\":\"A product that is good for many things.\"";
+    out += ",\"price\":";
+    out += std::to_string(i % 1000);
+    out += ".99,\"currency\":\"EUR\",\"in_stock\":";
+    out += i % 3 == 0 ? "false" : "true";
+    out += ",\"tags\":[\"new\",\"sale\",\"popular\"]";
+    out += ",\"dimensions\":{\"width\":10,\"height\":20,\"depth\":5}";
+    for (std::size_t j = 0; j < catalog_attribute_count; ++j) {
+      out += ",\"attribute_";
+      out += std::to_string(j);
+      out += "\":";
+      if (j % 2 == 0) {
+        out += std::to_string(i * j);
+      } else {
+        out += "\"value ";
+        out += std::to_string(j);
+        out += "\"";
+      }
+    }
+    out += "}";
+  }
+  out.push_back(']');
+  return out;
+}
+
+/// A typed catalog entry for the benchmarks of the encoder.
+struct catalog_item {
+
+  long long id;
+  std::string sku;
+  std::string title;
+  std::string description;
+  double price;
+  std::string currency;
+  bool in_stock;
+  std::vector<std::string> tags;
+  std::vector<long long> attributes;
+
+  void transform(zen::transformer& t) {
+    auto s = t.transform_object("catalog_item");
+    transform_fields(s);
+    s.finalize();
+  }
+
+  template<typename TransformerT>
+  void transform_fields(TransformerT& s) {
+    s.transform_field("id", id);
+    s.transform_field("sku", sku);
+    s.transform_field("title", title);
+    s.transform_field("description", description);
+    s.transform_field("price", price);
+    s.transform_field("currency", currency);
+    s.transform_field("in_stock", in_stock);
+    s.transform_field("tags", tags);
+    s.transform_field("attributes", attributes);
+  }
+
+};
+
+static std::vector<catalog_item> generate_catalog_items(std::size_t count) {
+  std::vector<catalog_item> items;
+  items.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    catalog_item item;
+    item.id = i;
+    item.sku = "SKU-" + std::to_string(100000 + i);
+    item.title = "Product " + std::to_string(i);
+    item.description = "A product that is good for many things.";
+    item.price = (i % 1000) + 0.99;
+    item.currency = "EUR";
+    item.in_stock = i % 3 != 0;
+    item.tags = { "new", "sale", "popular" };
+    for (std::size_t j = 0; j < catalog_attribute_count; ++j) {
+      item.attributes.push_back(i * j);
+    }
+    items.push_back(std::move(item));
+  }
+  return items;
+}
+
+static std::size_t encode_catalog(std::vector<catalog_item>& items) {
+  std::ostringstream out;
+  auto encoder = zen::make_json_encoder(out);
+  encoder->transform(items);
+  return out.tellp();
+}
+
+/// Turns a document generated by generate_document() into one row per line.
+static std::string to_lines(std::string_view document) {
+  std::string out;
+  out.reserve(document.size());
+  int depth = 0;
+  for (auto ch: document.substr(1, document.size() - 2)) {
+    if (ch == '[') {
+      ++depth;
+    } else if (ch == ']') {
+      --depth;
+    } else if (ch == ',' && depth == 0) {
+      out.push_back('\n');
+      continue;
+    }
+    out.push_back(ch);
+  }
+  out.push_back('\n');
+  return out;
+}
+
+/// Parses, prints and stringifies a generated document.
+///
+/// The throughput of the serializers is measured in bytes of output rather
+/// than in bytes of input.
+static void run_value_benchmarks(bench_suite& suite, const std::string& corpus, std::string_view text) {
+
+  suite.run(corpus, "parse_json(std::string_view)", text.size(), [&] {
+    return zen::parse_json(text);
+  });
+
+  zen::json_parse_opts utf8_opts;
+  utf8_opts.strings = zen::string_storage::utf8;
+
+  suite.run(corpus, "parse_json(std::string_view) with UTF-8 strings", text.size(), [&] {
+    return zen::parse_json(text, utf8_opts);
+  });
+
+  if (!suite.enabled(corpus, "print(const value&, std::ostream&)")
+      && !suite.enabled(corpus, "to_string(const value&)")
+      && !suite.enabled(corpus, "print_parallel(const value&, output_buffer&)")) {
+    return;
+  }
+
+  auto v = zen::parse_json(text).unwrap();
+  auto printed = zen::to_string(v).size();
+  zen::json_print_opts compact;
+  compact.indentation = "";
+  auto compact_printed = zen::to_string(v, compact).size();
+
+  suite.run(corpus, "print(const value&, std::ostream&)", printed, [&] {
+    std::ostringstream out;
+    zen::print(v, out);
+    return static_cast<std::size_t>(out.tellp()) == printed;
+  });
+
+  suite.run(corpus, "to_string(const value&)", printed, [&] {
+    return zen::to_string(v).size() == printed;
+  });
+
+  suite.run(corpus, "to_string(const value&) without indentation", compact_printed, [&] {
+    return zen::to_string(v, compact).size() == compact_printed;
+  });
+
+  suite.run(corpus, "print_parallel(const value&, output_buffer&)", printed, [&] {
+    zen::output_buffer out;
+    zen::print_parallel(v, out);
+    return out.size() == printed;
+  });
+
+  if (suite.enabled(corpus, "print(const value&, std::ostream&) with UTF-8 strings")) {
+    auto u = zen::parse_json(text, utf8_opts).unwrap();
+    suite.run(corpus, "print(const value&, std::ostream&) with UTF-8 strings", printed, [&] {
+      std::ostringstream out;
+      zen::print(u, out);
+      return static_cast<std::size_t>(out.tellp()) == printed;
+    });
+  }
+}
+
+static const char usage[] =
+  "Usage: zen_bench_json [megabytes] [--iterations=N] [--filter=TEXT] [--json]\n"
+  "\n"
+  "Generates documents of the given size (32 MB by default) and measures how\n"
+  "fast they are parsed and serialized. Only the benchmarks of which\n"
+  "'corpus/name' contains TEXT are run. With --json, the results are printed\n"
+  "as a JSON document instead of as text.\n";
+
+int main(int argc, const char* argv[]) {
+
+  std::size_t megabytes = 32;
+  std::size_t iterations = 3;
+  std::string filter;
+  bool json_output = false;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (arg == "--json") {
+      json_output = true;
+    } else if (arg.rfind("--iterations=", 0) == 0) {
+      iterations = std::strtoul(argv[i] + 13, nullptr, 10);
+    } else if (arg.rfind("--filter=", 0) == 0) {
+      filter = arg.substr(9);
+    } else if (arg == "--help" || arg == "-h") {
+      std::cout << usage;
+      return 0;
+    } else if (!arg.empty() && arg[0] != '-') {
+      megabytes = std::strtoul(argv[i], nullptr, 10);
+    } else {
+      std::cerr << usage;
+      return 1;
+    }
+  }
+
+  if (iterations == 0) {
+    iterations = 1;
+  }
+
+  const auto target_size = megabytes * 1024 * 1024;
+
+  bench_suite suite(iterations, filter, json_output);
+
+  {
+    auto document = generate_document(target_size);
+
+    suite.run("rows", "parse_json(std::istream&)", document.size(), [&] {
+      std::istringstream in(document);
+      return zen::parse_json(in);
+    });
+
+    if (suite.enabled("rows", "parse_json(std::ifstream&)")
+        || suite.enabled("rows", "parse_json_file()")) {
+      auto filename = std::filesystem::temp_directory_path() / "zen-bench.json";
+      std::ofstream(filename, std::ios::binary) << document;
+      suite.run("rows", "parse_json(std::ifstream&)", document.size(), [&] {
+        std::ifstream in(filename, std::ios::binary);
+        return zen::parse_json(in);
+      });
+      suite.run("rows", "parse_json_file()", document.size(), [&] {
+        return zen::parse_json_file(filename);
+      });
+      std::filesystem::remove(filename);
+    }
+
+    run_value_benchmarks(suite, "rows", document);
+
+    suite.run("rows", "parse_json(std::string_view) into a pool_alloc", document.size(), [&] {
+      // The result must be destroyed before the arena it was allocated from
+      zen::pool_alloc arena(1024 * 1024);
+      return zen::parse_json(std::string_view(document), arena).is_right();
+    });
+
+    suite.run("rows", "parse_json(std::string_view) with structural index", document.size(), [&] {
+      zen::json_parse_opts opts;
+      opts.structural_index = true;
+      return zen::parse_json(std::string_view(document), opts);
+    });
+
+    suite.run("rows", "json_push_parser in 16 KiB chunks", document.size(), [&] {
+      zen::json_push_parser parser;
+      std::string_view rest(document);
+      for (std::size_t i = 0; i < rest.size(); i += 16 * 1024) {
+        auto result = parser.feed(rest.substr(i, 16 * 1024));
+        if (result.is_left()) {
+          return zen::json_parse_result(zen::left(result.left()));
+        }
+      }
+      return parser.finish();
+    });
+
+    suite.run("rows", "parse_json_document(std::string_view)", document.size(), [&] {
+      return zen::parse_json_document(std::string_view(document));
+    });
+
+    suite.run("rows", "parse_json_document(std::string_view) with borrowed strings", document.size(), [&] {
+      zen::json_parse_opts opts;
+      opts.borrow_strings = true;
+      return zen::parse_json_document(std::string_view(document), opts);
+    });
+
+    suite.run("rows", "validate_json(std::string_view)", document.size(), [&] {
+      return zen::validate_json(document);
+    });
+
+    suite.run("rows", "parse_json_events(std::string_view)", document.size(), [&] {
+      zen::json_handler handler;
+      return zen::parse_json_events(std::string_view(document), handler);
+    });
+
+    {
+      // A payload of which only a few fields are needed
+      auto payload = "{\"rows\":" + document + ",\"id\":42,\"meta\":{\"kind\":\"rows\"}}";
+      zen::json_query_set fields;
+      fields.add(zen::compile_json_pointer("/id").unwrap());
+      fields.add(zen::compile_json_pointer("/meta/kind").unwrap());
+      suite.run("rows", "parse_json_paths(std::string_view) selecting 2 fields", payload.size(), [&] {
+        return zen::parse_json_paths(payload, fields);
+      });
+      fields.add(zen::compile_json_path("$.rows[-1][1]").unwrap());
+      suite.run("rows", "parse_json_paths(std::string_view) selecting 3 fields", payload.size(), [&] {
+        return zen::parse_json_paths(payload, fields);
+      });
+    }
+
+    auto lines = to_lines(document);
+
+    suite.run("lines", "parse_json() on each line of std::getline()", lines.size(), [&] {
+      std::istringstream in(lines);
+      std::string line;
+      while (std::getline(in, line)) {
+        if (zen::parse_json(line).is_left()) {
+          return false;
+        }
+      }
+      return true;
+    });
+
+    suite.run("lines", "parse_ndjson(std::string_view)", lines.size(), [&] {
+      std::size_t failed = 0;
+      zen::parse_ndjson(std::string_view(lines), [&](zen::ndjson_record& record) {
+        if (record.result.is_left()) {
+          ++failed;
+        }
+      });
+      return failed == 0;
+    });
+  }
+
+  {
+    auto records = generate_records(target_size);
+    run_value_benchmarks(suite, "records", records);
+    suite.run("records", "parse_json(std::string_view) with interned keys", records.size(), [&] {
+      zen::json_parse_opts opts;
+      opts.intern_keys = true;
+      return zen::parse_json(std::string_view(records), opts);
+    });
+  }
+
+  run_value_benchmarks(suite, "numbers", generate_numbers(target_size));
+  run_value_benchmarks(suite, "nested", generate_nested(target_size));
+  run_value_benchmarks(suite, "strings", generate_strings(target_size));
+
+  {
+    auto catalog = generate_catalog(target_size);
+    run_value_benchmarks(suite, "catalog", catalog);
+  }
+
+  if (suite.enabled("catalog", "make_json_encoder(std::ostream&)")
+      || suite.enabled("catalog", "encode_json(output_buffer&, T&)")) {
+    // Roughly as many entries as in the generated catalog
+    auto items = generate_catalog_items(target_size / 650 + 1);
+    auto encoded = encode_catalog(items);
+    suite.run("catalog", "make_json_encoder(std::ostream&)", encoded, [&] {
+      return encode_catalog(items) == encoded;
+    });
+    suite.run("catalog", "encode_json(output_buffer&, T&)", encoded, [&] {
+      zen::output_buffer out;
+      zen::encode_json(out, items);
+      return out.size() == encoded;
+    });
+  }
+
+  if (suite.enabled("catalog", "decode_json(std::string_view, T&)")
+      || suite.enabled("catalog", "make_json_decoder(std::istream&)")) {
+    auto items = generate_catalog_items(target_size / 650 + 1);
+    zen::output_buffer text;
+    zen::encode_json(text, items);
+    suite.run("catalog", "decode_json(std::string_view, T&)", text.size(), [&] {
+      std::vector<catalog_item> decoded;
+      return zen::decode_json(text.view(), decoded).is_right() && decoded.size() == items.size();
+    });
+    suite.run("catalog", "make_json_decoder(std::istream&)", text.size(), [&] {
+      std::istringstream in(text.str());
+      auto decoder = zen::make_json_decoder(in);
+      std::vector<catalog_item> decoded;
+      decoder->transform(decoded);
+      return decoder->finish().is_right() && decoded.size() == items.size();
+    });
+  }
+
+  if (json_output) {
+    suite.print_json(std::cout);
+  }
+
+  return 0;
+}
@@ -2,14 +2,19 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
 #include <stdlib.h>
 #include <string.h>
 
 #include <vector>
 
+#include "zen/config.hpp"
+
 ZEN_NAMESPACE_START
 
-#define ZEN_BLOCK_SIZE_NEXT sizeof(char**)
+#define ZEN_BLOCK_SIZE_NEXT sizeof(char*)
 #define ZEN_BLOCK_SIZE_SIZE sizeof(std::size_t)
 
 #define ZEN_BLOCK_OFFSET_NEXT 0
@@ -37,32 +42,51 @@ public:
   }
 
   block next() const noexcept {
-    return block(*reinterpret_cast<char**>(data + ZEN_BLOCK_OFFSET_NEXT));
+    char* next_data;
+    memcpy(&next_data, data + ZEN_BLOCK_OFFSET_NEXT, sizeof(next_data));
+    block out(nullptr);
+    out.data = next_data;
+    return out;
   }
 
   void set_next(block new_next) const noexcept {
-    memcpy(data + ZEN_BLOCK_OFFSET_NEXT, reinterpret_cast<char**>(&new_next.data), ZEN_BLOCK_SIZE_NEXT);
+    memcpy(data + ZEN_BLOCK_OFFSET_NEXT, &new_next.data, sizeof(new_next.data));
   }
 
   std::size_t size() const noexcept {
-    return *reinterpret_cast<std::size_t*>(data + ZEN_BLOCK_OFFSET_SIZE);
+    std::size_t out;
+    memcpy(&out, data + ZEN_BLOCK_OFFSET_SIZE, ZEN_BLOCK_SIZE_SIZE);
+    return out;
   }
 
   void set_size(std::size_t new_size) const noexcept {
-    memcpy(data, reinterpret_cast<char*>(&new_size), ZEN_BLOCK_SIZE_SIZE);
+    memcpy(data + ZEN_BLOCK_OFFSET_SIZE, reinterpret_cast<char*>(&new_size), ZEN_BLOCK_SIZE_SIZE);
   }
 
 };
 
-class pool_alloc {
+/// Hands out memory from large blocks by bumping a pointer.
+///
+/// Individual allocations are never freed. Instead, all memory is returned
+/// at once when the pool is destroyed or release() is called, which takes
+/// time proportional to the number of blocks.
+///
+/// The pool is also a `std::pmr::memory_resource`, so that standard
+/// containers and parsed JSON values can be allocated from it. Requests that
+/// are larger than a block get a block of their own. Containers that use the
+/// pool must not outlive it.
+class pool_alloc : public std::pmr::memory_resource {
 
   block head = nullptr;
   block tail = nullptr;
 
+  // Blocks that were created for a single large allocation
+  block large = nullptr;
+
   std::size_t block_size;
 
-  block create_block() {
-    auto raw = malloc(block_size + ZEN_BLOCK_HEADER_SIZE);
+  block create_block(std::size_t capacity) {
+    auto raw = malloc(capacity + ZEN_BLOCK_HEADER_SIZE);
     if (!raw) {
       return nullptr;
     }
@@ -70,13 +94,24 @@ class pool_alloc {
     return blk;
   }
 
-  char* allocate_from_block(block& blk, std::size_t amount) {
+  char* allocate_from_block(block& blk, std::size_t amount, std::size_t alignment) {
     auto sz = blk.size();
-    if (block_size < amount + sz) {
+    auto start = blk.data + ZEN_BLOCK_OFFSET_DATA;
+    auto addr = reinterpret_cast<std::uintptr_t>(start + sz);
+    auto padding = (alignment - addr % alignment) % alignment;
+    if (block_size < sz + padding + amount) {
       return nullptr;
     }
-    blk.set_size(sz + amount);
-    return blk.data + ZEN_BLOCK_OFFSET_DATA + sz;
+    blk.set_size(sz + padding + amount);
+    return start + sz + padding;
+  }
+
+  static void free_blocks(block blk) {
+    while (blk) {
+      auto next = blk.next();
+      free(blk.data);
+      blk = next;
+    }
   }
 
 public:
@@ -85,30 +120,78 @@ public:
     std::size_t block_size = 16 * 1024
   ): block_size(block_size) {}
 
+  pool_alloc(const pool_alloc& other) = delete;
+  pool_alloc& operator=(const pool_alloc& other) = delete;
+
+  ~pool_alloc() {
+    release();
+  }
+
   std::size_t max_alloc_size() const noexcept {
     return block_size;
   }
 
-  void* allocate(std::size_t byte_count) {
+  /// Allocate `byte_count` bytes from the current block, or return `nullptr`
+  /// if that is not possible.
+  ///
+  /// Unlike allocate(), which comes from `std::pmr::memory_resource`, this
+  /// never creates a block for a single large request and never throws.
+  void* try_allocate(std::size_t byte_count, std::size_t alignment = 1) {
+    if (byte_count + alignment - 1 > block_size) {
+      return nullptr;
+    }
     if (!tail) {
-      head = tail = create_block();
+      head = tail = create_block(block_size);
       if (!tail) {
         return nullptr;
       }
       tail.set_next(nullptr);
     }
-    auto ptr = allocate_from_block(tail, byte_count);
+    auto ptr = allocate_from_block(tail, byte_count, alignment);
     if (ptr) {
       return ptr;
     }
-    auto next = create_block();
+    auto next = create_block(block_size);
     if (!next) {
       return nullptr;
     }
     tail.set_next(next);
     next.set_next(nullptr);
     tail = next;
-    return allocate_from_block(tail, byte_count);
+    return allocate_from_block(tail, byte_count, alignment);
+  }
+
+  /// Free all memory that was allocated from this pool.
+  void release() noexcept {
+    free_blocks(head);
+    free_blocks(large);
+    head = tail = large = nullptr;
+  }
+
+protected:
+
+  void* do_allocate(std::size_t byte_count, std::size_t alignment) override {
+    auto ptr = try_allocate(byte_count, alignment);
+    if (ptr) {
+      return ptr;
+    }
+    // Block data is aligned like anything returned by malloc, so only
+    // over-aligned types need extra room.
+    auto padding = alignment > alignof(std::max_align_t) ? alignment : 0;
+    auto blk = create_block(byte_count + padding);
+    if (!blk) {
+      throw std::bad_alloc();
+    }
+    blk.set_next(large);
+    large = blk;
+    auto addr = reinterpret_cast<std::uintptr_t>(blk.data + ZEN_BLOCK_OFFSET_DATA);
+    return blk.data + ZEN_BLOCK_OFFSET_DATA + (alignment - addr % alignment) % alignment;
+  }
+
+  void do_deallocate(void*, std::size_t, std::size_t) override {}
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
   }
 
 };
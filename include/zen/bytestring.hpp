@@ -45,8 +45,8 @@ public:
   const char* ptr;
   const std::size_t sz;
 
-  template<typename BS>
-  bytestring_view(const BS& data) ZEN_NOEXCEPT:
+  template<std::size_t N>
+  bytestring_view(const basic_bytestring<N>& data) ZEN_NOEXCEPT:
     ptr(data.ptr), sz(data.sz) {}
 
   bool operator==(const char* other) const ZEN_NOEXCEPT {
@@ -208,20 +208,35 @@ public:
     return is_right();
   }
 
-  R unwrap() requires (has_display<L>) {
+  R unwrap() & requires (has_display<L>) {
     if (!has_right_v) {
       ZEN_PANIC("error: %s", display(left_value).c_str());
     }
     return right_value;
   }
 
-  R unwrap() requires (!has_display<L>) {
+  R unwrap() & requires (!has_display<L>) {
     if (!has_right_v) {
       ZEN_PANIC("trying to unwrap a zen::either which is left-valued");
     }
     return right_value;
   }
 
+  /// Unwrapping a temporary moves the value out instead of copying it.
+  R unwrap() && requires (has_display<L>) {
+    if (!has_right_v) {
+      ZEN_PANIC("error: %s", display(left_value).c_str());
+    }
+    return std::move(right_value);
+  }
+
+  R unwrap() && requires (!has_display<L>) {
+    if (!has_right_v) {
+      ZEN_PANIC("trying to unwrap a zen::either which is left-valued");
+    }
+    return std::move(right_value);
+  }
+
   L unwrap_left() {
     if (has_right_v) {
       ZEN_PANIC("trying to unwrap the left side a zen::either which is right-valued");
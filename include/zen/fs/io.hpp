@@ -1,6 +1,9 @@
 #ifndef ZEN_FS_FILE_HPP
 #define ZEN_FS_FILE_HPP
 
+#include <string_view>
+#include <system_error>
+
 #include "zen/either.hpp"
 #include "zen/bytestring.hpp"
 #include "zen/fs/path.hpp"
@@ -11,6 +14,73 @@ namespace fs {
 
 either<std::error_code, bytestring> read_file(const path& filename); 
 
+/// The read-only contents of a file that is mapped into memory.
+///
+/// Pages are loaded by the operating system as they are touched, so opening
+/// a large file is cheap and its contents are never copied. The kernel is
+/// told that the file will be read sequentially, so that it can read ahead
+/// aggressively and drop pages that were already visited.
+///
+/// On platforms without `mmap()` the file is read into memory instead.
+class mapped_file {
+
+  const char* ptr = nullptr;
+  std::size_t sz = 0;
+
+  // Set when the contents were read into a buffer instead of being mapped
+  bool owned = false;
+
+  void release() noexcept;
+
+public:
+
+  mapped_file() = default;
+
+  mapped_file(const char* ptr, std::size_t sz, bool owned) noexcept:
+    ptr(ptr), sz(sz), owned(owned) {}
+
+  mapped_file(const mapped_file& other) = delete;
+  mapped_file& operator=(const mapped_file& other) = delete;
+
+  mapped_file(mapped_file&& other) noexcept:
+    ptr(other.ptr), sz(other.sz), owned(other.owned) {
+      other.ptr = nullptr;
+      other.sz = 0;
+    }
+
+  mapped_file& operator=(mapped_file&& other) noexcept {
+    if (this != &other) {
+      release();
+      ptr = other.ptr;
+      sz = other.sz;
+      owned = other.owned;
+      other.ptr = nullptr;
+      other.sz = 0;
+    }
+    return *this;
+  }
+
+  ~mapped_file() {
+    release();
+  }
+
+  const char* data() const noexcept {
+    return ptr;
+  }
+
+  std::size_t size() const noexcept {
+    return sz;
+  }
+
+  std::string_view view() const noexcept {
+    return std::string_view(ptr, sz);
+  }
+
+};
+
+/// Map the contents of `filename` into memory for reading.
+either<std::error_code, mapped_file> map_file(const path& filename);
+
 }
 
 ZEN_NAMESPACE_END
@@ -1,6 +1,12 @@
+#ifndef ZEN_HASH_HPP
+#define ZEN_HASH_HPP
+
 
 #include <functional>
 #include <string>
+#include <string_view>
+
+#include "zen/config.hpp"
 
 namespace std {
 
@@ -10,7 +16,7 @@ namespace std {
     typename Allocator
   > struct hash<std::basic_string<CharT, Traits, Allocator>> {
 
-    std::size_t operator()(const std::basic_string<CharT, Traits, Allocator> str) const noexcept {
+    std::size_t operator()(const std::basic_string<CharT, Traits, Allocator>& str) const noexcept {
       std::size_t h = 17;
       for (auto ch: str) {
         h = h * 19 + ch;
@@ -22,4 +28,31 @@ namespace std {
 
 }
 
+ZEN_NAMESPACE_START
+
+/// Hashes a string or a view of one by its characters.
+///
+/// A string and a view of it hash the same, so that a view can be looked up
+/// in a container of strings. The result is the same as that of std::hash
+/// for strings above.
+struct string_hash {
+
+  template<typename CharT, typename Traits>
+  std::size_t operator()(std::basic_string_view<CharT, Traits> str) const noexcept {
+    std::size_t h = 17;
+    for (auto ch: str) {
+      h = h * 19 + ch;
+    }
+    return h;
+  }
+
+  template<typename CharT, typename Traits, typename Allocator>
+  std::size_t operator()(const std::basic_string<CharT, Traits, Allocator>& str) const noexcept {
+    return (*this)(std::basic_string_view<CharT, Traits>(str));
+  }
+
+};
+
+ZEN_NAMESPACE_END
 
+#endif // of #ifndef ZEN_HASH_HPP
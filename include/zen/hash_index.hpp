@@ -1,6 +1,7 @@
 #ifndef ZEN_HASHINDEX_HPP
 #define ZEN_HASHINDEX_HPP
 
+#include <memory_resource>
 #include <type_traits>
 #include <vector>
 
@@ -9,7 +10,7 @@
 ZEN_NAMESPACE_START
 
 template<typename T, typename KeyT>
-using hash_bucket = std::vector<T>;
+using hash_bucket = std::pmr::vector<T>;
 
 template<
   typename T,
@@ -95,21 +96,17 @@ class hash_index {
 
   std::hash<KeyT> hasher;
 
-  std::vector<bucket> buckets;
+  std::pmr::vector<bucket> buckets;
 
-  const KeyT& get_key(const T& element) {
+  static const KeyT& get_key(const T& element) {
     // FIXME This needs to be generalized
     return element->first;
   }
 
 public:
 
-  hash_index() {
-    buckets.reserve(256);
-    for (std::size_t i = 0; i < 256; ++i) {
-      buckets.push_back(bucket {});
-    }
-  }
+  hash_index(std::pmr::memory_resource* resource = std::pmr::get_default_resource()):
+    buckets(256, resource) {}
 
   using value_type = T;
   using reference = T&;
@@ -129,27 +126,35 @@ public:
     const auto bucket_index = h % buckets.size();
     auto& bucket = buckets[bucket_index];
     std::size_t i = 0;
-    const auto end = bucket.end();
-    for (auto it = bucket.begin(); it != end; ++it, ++i) {
+    const auto bucket_end = bucket.end();
+    for (auto it = bucket.begin(); it != bucket_end; ++it, ++i) {
       if (get_key(*it) == key) {
-        return hash_index_iterator(bucket, bucket_index, i);
+        return iterator(buckets, bucket_index, i);
       }
     }
     return end();
   }
 
-  const_iterator lookup(const KeyT& key) const {
-    const auto h = hasher(key);
-    const auto bucket_index = h % buckets.size();
-    auto& bucket = buckets[bucket_index];
-    std::size_t i = 0;
-    const auto end = bucket.end();
-    for (auto it = bucket.begin(); it != end; ++it, ++i) {
-      if (get_key(*it) == key) {
-        return const_hash_index_iterator(bucket, bucket_index, i);
+  /// Get the element that has the given key, or `nullptr` if there is none.
+  ///
+  /// `key` may be of any type that compares equal to `KeyT` and of which
+  /// `std::hash` gives the same result for equal keys.
+  template<typename K>
+  const T* find(const K& key) const {
+    return find(key, std::hash<K>{}(key));
+  }
+
+  /// Like find(key), for callers that have already computed the hash of
+  /// `key` with `std::hash<KeyT>`.
+  template<typename K>
+  const T* find(const K& key, std::size_t hash) const {
+    const auto& bucket = buckets[hash % buckets.size()];
+    for (const auto& element: bucket) {
+      if (get_key(element) == key) {
+        return &element;
       }
     }
-    return cend();
+    return nullptr;
   }
 
   iterator begin() noexcept {
@@ -0,0 +1,120 @@
+/// \file zen/integer_format.hpp
+/// \brief Writing integers in decimal without going through a stream.
+///
+/// Formatting with `std::ostream` looks up the locale and makes several
+/// virtual calls for every number. The functions in this header write the
+/// digits straight into a character buffer, two digits at a time with the
+/// help of a lookup table.
+///
+/// ```cpp
+/// char buffer[zen::max_integer_length];
+/// auto end = zen::format_integer(-42, buffer);
+/// std::string_view text(buffer, end - buffer); // "-42"
+/// ```
+
+#ifndef ZEN_INTEGER_FORMAT_HPP
+#define ZEN_INTEGER_FORMAT_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "zen/config.hpp"
+
+ZEN_NAMESPACE_START
+
+/// The most characters that format_integer() writes, which is what the
+/// smallest 64-bit signed integer takes.
+static constexpr const std::size_t max_integer_length = 20;
+
+namespace integer_format_detail {
+
+  inline constexpr const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+  inline constexpr const std::uint64_t powers_of_10[20] = {
+    1ull,
+    10ull,
+    100ull,
+    1000ull,
+    10000ull,
+    100000ull,
+    1000000ull,
+    10000000ull,
+    100000000ull,
+    1000000000ull,
+    10000000000ull,
+    100000000000ull,
+    1000000000000ull,
+    10000000000000ull,
+    100000000000000ull,
+    1000000000000000ull,
+    10000000000000000ull,
+    100000000000000000ull,
+    1000000000000000000ull,
+    10000000000000000000ull,
+  };
+
+  /// Get the number of decimal digits of `n`, which must be at least 10.
+  inline unsigned count_digits(std::uint64_t n) {
+    // An estimate of log10(n) based on log2(n), which is off by at most one
+    unsigned t = (64 - __builtin_clzll(n)) * 1233 >> 12;
+    return t + 1 - (n < powers_of_10[t]);
+  }
+
+  inline char* format_unsigned(std::uint64_t n, char* out) {
+    if (n < 10) {
+      *out = static_cast<char>('0' + n);
+      return out + 1;
+    }
+    auto end = out + count_digits(n);
+    auto curr = end;
+    while (n >= 100) {
+      auto i = (n % 100) * 2;
+      n /= 100;
+      curr -= 2;
+      std::memcpy(curr, digit_pairs + i, 2);
+    }
+    if (n >= 10) {
+      std::memcpy(curr - 2, digit_pairs + n * 2, 2);
+    } else {
+      curr[-1] = static_cast<char>('0' + n);
+    }
+    return end;
+  }
+
+}
+
+/// Write the decimal representation of `value` to `out` and return a
+/// pointer past the last character that was written.
+///
+/// `out` must have room for at least `max_integer_length` characters.
+template<typename T>
+char* format_integer(T value, char* out) {
+  static_assert(std::is_integral_v<T> && !std::is_same_v<T, bool>, "can only format integers");
+  static_assert(sizeof(T) <= sizeof(std::uint64_t), "integers larger than 64 bits are not supported");
+  if constexpr (std::is_signed_v<T>) {
+    using unsigned_type = std::make_unsigned_t<T>;
+    auto magnitude = static_cast<unsigned_type>(value);
+    if (value < 0) {
+      *out++ = '-';
+      magnitude = unsigned_type(0) - magnitude;
+    }
+    return integer_format_detail::format_unsigned(magnitude, out);
+  } else {
+    return integer_format_detail::format_unsigned(value, out);
+  }
+}
+
+ZEN_NAMESPACE_END
+
+#endif // of #ifndef ZEN_INTEGER_FORMAT_HPP
@@ -2,9 +2,16 @@
 #define ZEN_JSON_HPP
 
 #include <memory>
+#include <memory_resource>
 #include <istream>
 #include <ostream>
+#include <string_view>
+#include <system_error>
+#include <variant>
 
+#include "zen/bytestring.hpp"
+#include "zen/fs/path.hpp"
+#include "zen/output_buffer.hpp"
 #include "zen/transformer.hpp"
 #include "zen/value.hpp"
 #include "zen/either.hpp"
@@ -30,51 +37,301 @@ enum class json_token_type {
 enum class json_parse_error {
   unrecognised_escape_sequence,
   unexpected_character,
+  /// A string contains bytes that are not valid UTF-8
+  invalid_utf8,
+  /// The document is nested deeper than json_validate_max_depth
+  max_depth_exceeded,
+  /// A value can't be decoded into the type that was asked for
+  type_mismatch,
+  /// A number does not fit in the type that it is decoded into
+  number_out_of_range,
+  /// The document has more words or longer strings than a json_document
+  /// can address
+  document_too_large,
 };
 
 using json_parse_result = either<json_parse_error, value>;
 
-json_parse_result parse_json(std::istream& in);
-json_parse_result parse_json(const std::string& in);
+struct json_parse_opts {
+
+  /// Locate all structural characters of the input with SIMD instructions
+  /// before building any values.
+  ///
+  /// This pays off for large documents, where the parser can then skip over
+  /// whitespace and string contents without looking at every byte. Inputs
+  /// larger than 4 GiB are always parsed in a single pass.
+  bool structural_index = false;
+
+  /// Let strings that contain no escape sequences point into the input
+  /// instead of copying them, so that the input must outlive the result.
+  ///
+  /// Only parse_json_document() supports this. Values returned by
+  /// parse_json() always own their strings.
+  bool borrow_strings = false;
+
+  /// Let all objects in the result that have the same key share one copy of
+  /// it, instead of giving every object its own.
+  ///
+  /// This saves memory and hashing work for documents with many objects of
+  /// the same shape, such as an array of records, at the cost of a table
+  /// lookup for every key. The table only lives for the duration of the
+  /// parse.
+  bool intern_keys = false;
+
+  /// Intern keys into a table that outlives the parse, so that documents that
+  /// are parsed one after the other share their keys as well. Implies
+  /// `intern_keys`.
+  ///
+  /// parse_ndjson() gives each of its threads a table of its own instead.
+  key_table* keys = nullptr;
+
+  /// Whether strings and keys are decoded into code points or kept in UTF-8.
+  ///
+  /// UTF-8 takes a quarter of the memory for most text and is written back
+  /// out without converting it. Strings then come out as a utf8_string and
+  /// keys as object_keys that hold UTF-8. Keys from `keys` are stored the way
+  /// that table says.
+  string_storage strings = string_storage::code_points;
 
-struct json_encode_opts {
-  std::string indentation = "";
 };
 
-std::unique_ptr<transformer> make_json_decoder(
-  std::istream& input,
-  json_encode_opts opts = {}
+/// Parse a single JSON value from the contiguous buffer `data` of `size`
+/// bytes.
+///
+/// This is the fastest way to parse JSON. All other overloads of this function
+/// forward to it.
+json_parse_result parse_json(const char* data, std::size_t size, json_parse_opts opts = {});
+
+/// Parse a single JSON value, allocating all of its arrays, objects, keys and
+/// strings from `resource`.
+///
+/// With a `zen::pool_alloc` as the resource, nothing has to be freed
+/// element by element: releasing the pool discards the whole document. The
+/// result must not be used after the resource is gone, unless it is copied
+/// first.
+///
+/// ```cpp
+/// zen::pool_alloc arena;
+/// auto doc = zen::parse_json(input, arena).unwrap();
+/// ```
+json_parse_result parse_json(
+  const char* data,
+  std::size_t size,
+  std::pmr::memory_resource& resource,
+  json_parse_opts opts = {}
+);
+
+json_parse_result parse_json(
+  std::string_view in,
+  std::pmr::memory_resource& resource,
+  json_parse_opts opts = {}
+);
+
+/// Parse a single JSON value from a NUL-terminated string.
+json_parse_result parse_json(const char* in, json_parse_opts opts = {});
+
+json_parse_result parse_json(std::string_view in, json_parse_opts opts = {});
+json_parse_result parse_json(const std::string& in, json_parse_opts opts = {});
+json_parse_result parse_json(bytestring_view in, json_parse_opts opts = {});
+
+/// Parse a single JSON value from a stream.
+///
+/// The stream is read until the end into an intermediate buffer. If the data
+/// is already in memory, prefer one of the other overloads.
+json_parse_result parse_json(std::istream& in, json_parse_opts opts = {});
+
+/// Either the file could not be read or it does not hold valid JSON.
+using json_file_error = std::variant<std::error_code, json_parse_error>;
+
+using json_file_result = either<json_file_error, value>;
+
+/// Parse a single JSON value from the file at `filename`.
+///
+/// The file is mapped into memory and parsed in place, so it is never
+/// copied into an intermediate buffer and memory use is that of the result.
+/// The mapping is released before this function returns.
+json_file_result parse_json_file(const fs::path& filename, json_parse_opts opts = {});
+
+/// Receives the contents of a JSON document as it is being parsed.
+///
+/// Override the callbacks you are interested in. Every callback returns
+/// whether parsing should continue, so that a handler can stop as soon as it
+/// has found what it was looking for.
+///
+/// Strings and keys are passed as UTF-8 with all escape sequences decoded.
+/// The views are only valid for the duration of the call.
+class json_handler {
+public:
+
+  virtual bool on_null() { return true; }
+  virtual bool on_boolean(bool) { return true; }
+  virtual bool on_integer(bigint) { return true; }
+  virtual bool on_fractional(fractional) { return true; }
+  virtual bool on_string(std::string_view) { return true; }
+
+  virtual bool on_object_start() { return true; }
+  virtual bool on_key(std::string_view) { return true; }
+  virtual bool on_object_end() { return true; }
+
+  virtual bool on_array_start() { return true; }
+  virtual bool on_array_end() { return true; }
+
+  virtual ~json_handler() {}
+
+};
+
+using json_events_result = either<json_parse_error, void>;
+
+/// Parse a single JSON value and report its contents to `handler` without
+/// building a value.
+///
+/// Apart from the input itself, memory use only grows with the nesting depth
+/// of the document and the length of the longest string that contains escape
+/// sequences.
+json_events_result parse_json_events(
+  const char* data,
+  std::size_t size,
+  json_handler& handler,
+  json_parse_opts opts = {}
+);
+
+json_events_result parse_json_events(
+  std::string_view in,
+  json_handler& handler,
+  json_parse_opts opts = {}
 );
 
+/// How deeply validate_json() lets arrays and objects be nested.
+static constexpr const std::size_t json_validate_max_depth = 1024;
+
+using json_validate_result = either<json_parse_error, void>;
+
+/// Check that `data` holds exactly one well-formed JSON value, optionally
+/// surrounded by whitespace, without building anything.
+///
+/// This is stricter than parse_json(): strings must be valid UTF-8 without
+/// any unescaped control characters, and `\u` escapes of characters outside
+/// of the Basic Multilingual Plane must be complete surrogate pairs.
+///
+/// Nothing is allocated. The nesting of the document is tracked in a fixed
+/// stack of one bit per level, so documents that are nested deeper than
+/// json_validate_max_depth are rejected. String contents are scanned 64 bytes
+/// at a time.
+json_validate_result validate_json(const char* data, std::size_t size);
+
+json_validate_result validate_json(std::string_view in);
+
+/// Parses a single JSON value that arrives in chunks, such as the body of a
+/// network request.
+///
+/// Each chunk is processed as soon as it is fed and is not referenced
+/// afterwards. Only a token that is cut in two by the end of a chunk is kept
+/// until the rest of it arrives, so the input never has to be assembled in
+/// one buffer.
+///
+/// ```cpp
+/// zen::json_push_parser parser;
+/// while (auto n = receive(buffer, sizeof(buffer))) {
+///   if (parser.feed(buffer, n).is_left()) {
+///     return;
+///   }
+/// }
+/// auto doc = parser.finish().unwrap();
+/// ```
+class json_push_parser {
+
+  class impl;
+
+  std::unique_ptr<impl> state;
+
+  std::pmr::memory_resource* resource;
+
+  json_parse_opts opts;
+
+public:
+
+  /// Create a parser that allocates the result from `resource`.
+  ///
+  /// Of the options, only `intern_keys` and `keys` apply.
+  json_push_parser(
+    std::pmr::memory_resource& resource = *std::pmr::get_default_resource(),
+    json_parse_opts opts = {}
+  );
+
+  json_push_parser(json_push_parser&& other) noexcept;
+  json_push_parser& operator=(json_push_parser&& other) noexcept;
+
+  ~json_push_parser();
+
+  /// Parse the next chunk of the input.
+  ///
+  /// Once an error is returned, every further call returns it as well.
+  json_events_result feed(const char* data, std::size_t size);
+
+  json_events_result feed(std::string_view chunk) {
+    return feed(chunk.data(), chunk.size());
+  }
+
+  /// Signal that the input has ended and get the value that was parsed.
+  ///
+  /// Afterwards, the parser is ready to parse a new value.
+  json_parse_result finish();
+
+};
+
+struct json_print_opts {
+
+  /// What to write for each level of nesting.
+  ///
+  /// When empty, the value is written on a single line without any
+  /// whitespace.
+  std::string indentation = "  ";
+
+};
+
+void print(const value& v, std::ostream& out, const json_print_opts& opts = {});
+
+/// Write `v` into `out` without flushing it.
+void print(const value& v, output_buffer& out, const json_print_opts& opts = {});
+
+std::string to_string(const value& v, const json_print_opts& opts = {});
+
+/// Write `str` as a quoted JSON string, escaping quotes, backslashes and
+/// control characters.
+///
+/// `str` is expected to be UTF-8 and is copied as-is otherwise.
+void write_json_string(output_buffer& out, std::string_view str);
+
+/// Write a string of code points as a quoted JSON string in UTF-8.
+void write_json_string(output_buffer& out, code_point_view str);
+
+struct json_encode_opts {
+  std::string indentation = "";
+};
+
 struct json_decode_opts {
 
 };
 
+/// Create an encoder that writes to `output`.
+///
+/// The encoder is only known as a transformer, so every value goes through
+/// a virtual call. encode_json() in zen/json_encoder.hpp avoids that for
+/// types with a `transform_fields()` template.
 std::unique_ptr<transformer> make_json_encoder(
   std::ostream& output,
-  json_decode_opts opts = {}
+  json_encode_opts opts = {}
 );
 
-template<typename InputT, typename T>
-void decode_json(InputT input, T& value) {
-  auto decoder = make_json_decoder(input);
-  decode(decoder, value);
-}
-
-template<typename OutputT, typename T>
-void encode_json(OutputT output, T& value) {
-  auto encoder = make_json_encoder(output);
-  decode(encoder, value);
-}
-
-template<typename OutputT, typename T>
-void encode_json_pretty(OutputT output, T& value) {
-  json_encode_opts opts = {
-    .indentation = "    ",
-  };
-  auto encoder = make_json_encoder(output, opts);
-  decode(encoder, value);
-}
+/// Create an encoder that writes into `output`.
+///
+/// Unlike the encoder that writes to a `std::ostream`, this encoder leaves
+/// flushing the buffer to the caller, so that many values can be written to
+/// the sink of the buffer in one go.
+std::unique_ptr<transformer> make_json_encoder(
+  output_buffer& output,
+  json_encode_opts opts = {}
+);
 
 ZEN_NAMESPACE_END
 
@@ -0,0 +1,517 @@
+/// \file zen/json_decoder.hpp
+/// \brief Decoding JSON straight into C++ types.
+///
+/// json_decoder reads its input one token at a time and assigns what it
+/// finds to the fields of the value that is being decoded, so that no
+/// zen::value is ever built. Memory use only depends on how deeply the input
+/// is nested.
+///
+/// Like json_encoder, the decoder implements the virtual interface of
+/// zen::transformer, but it is faster to use it directly. Types with a
+/// `transform_fields()` template are then decoded with a table of their
+/// field names that is built the first time the type is decoded. Each key
+/// in the input is looked up in that table and only the matching field is
+/// decoded, so the keys may appear in any order. Keys that are not in the
+/// table are skipped without decoding their values.
+///
+/// Fields that are missing from the input keep the value they had.
+///
+/// ```cpp
+/// point p;
+/// auto result = zen::decode_json(std::string_view("{\"y\":2,\"x\":1}"), p);
+/// ```
+
+#ifndef ZEN_JSON_DECODER_HPP
+#define ZEN_JSON_DECODER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "zen/config.hpp"
+#include "zen/either.hpp"
+#include "zen/json.hpp"
+#include "zen/meta.hpp"
+#include "zen/transformer.hpp"
+
+ZEN_NAMESPACE_START
+
+using json_decode_result = either<json_parse_error, void>;
+
+namespace json_detail {
+
+  /// The names of the fields that a type reports in `transform_fields()`,
+  /// in the order in which they are reported.
+  class field_table {
+
+    std::vector<std::string> names;
+
+    /// Only used when there are too many names to search them one by one.
+    std::unordered_map<std::string_view, std::size_t> positions;
+
+    static constexpr std::size_t max_linear_search = 8;
+
+    struct name_collector {
+
+      std::vector<std::string>& names;
+
+      template<typename T>
+      void transform_field(std::string_view name, T&&) {
+        names.emplace_back(name);
+      }
+
+    };
+
+  public:
+
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    /// Collect the fields of the type of `value`.
+    ///
+    /// The type must report the same fields in the same order every time.
+    template<typename T>
+    static field_table of(T& value) {
+      field_table table;
+      name_collector collector { table.names };
+      value.transform_fields(collector);
+      if (table.names.size() > max_linear_search) {
+        for (std::size_t i = table.names.size(); i-- > 0;) {
+          table.positions[table.names[i]] = i;
+        }
+      }
+      return table;
+    }
+
+    /// Get the position of the field called `name`, or npos if there is no
+    /// such field.
+    ///
+    /// Keys usually follow the order of the fields, so the field at
+    /// `expected` is tried first.
+    std::size_t find(std::string_view name, std::size_t expected) const {
+      if (expected < names.size() && names[expected] == name) {
+        return expected;
+      }
+      if (names.size() > max_linear_search) {
+        auto match = positions.find(name);
+        return match == positions.end() ? npos : match->second;
+      }
+      for (std::size_t i = 0; i < names.size(); ++i) {
+        if (names[i] == name) {
+          return i;
+        }
+      }
+      return npos;
+    }
+
+  };
+
+}
+
+class json_decoder final : public transformer {
+
+  /// Decodes the single field at `target` from `transform_fields()`.
+  class field_decoder {
+
+    json_decoder& decoder;
+    std::size_t target;
+    std::size_t position = 0;
+
+  public:
+
+    field_decoder(json_decoder& decoder, std::size_t target):
+      decoder(decoder), target(target) {}
+
+    template<typename T>
+    void transform_field(std::string_view, T&& value) {
+      if (position++ == target) {
+        decoder.transform(value);
+      }
+    }
+
+  };
+
+  /// An object that is decoded through the virtual interface.
+  struct object_frame {
+
+    /// Where the first key of the object starts.
+    const char* body;
+
+    bool first = true;
+
+    /// Whether the keys were collected in `index` because the fields were
+    /// not requested in the order of the input.
+    bool indexed = false;
+
+    std::vector<std::pair<std::string, const char*>> index;
+
+    /// Where the object ends, once it has been indexed.
+    const char* end = nullptr;
+
+  };
+
+  // Used when the decoder was given a std::istream
+  std::string own_input;
+
+  const char* curr;
+  const char* end;
+
+  std::optional<json_parse_error> error;
+
+  /// How many objects and arrays are open.
+  std::size_t depth = 0;
+
+  /// Holds strings that contain escape sequences while they are decoded.
+  std::string scratch;
+
+  // State of the virtual interface. Frames are kept around after an object
+  // is done with, so that their indices don't have to be allocated again.
+  std::vector<object_frame> objects;
+  std::size_t object_depth = 0;
+  std::vector<bool> sequences;
+
+  /// How many fields deep the decoder is in a field that isn't in the
+  /// input. Everything is ignored until that field ends.
+  std::size_t missing = 0;
+
+  void skip_whitespace() {
+    while (curr != end && (*curr == ' ' || *curr == '\n' || *curr == '\r' || *curr == '\t')) {
+      ++curr;
+    }
+  }
+
+  /// Stop decoding because of `e`. Only the first error is kept.
+  void fail(json_parse_error e);
+
+  /// Consume the opening bracket `open` of an object or array.
+  bool enter(char open);
+
+  /// Move to the next member of an object or array, consuming the comma in
+  /// front of it. Returns false after consuming the closing bracket `close`.
+  bool next_member(char close, bool& first);
+
+  /// Read a key and the colon after it.
+  bool read_key(std::string_view& key);
+
+  /// Skip over the value that comes next without decoding it.
+  void skip();
+
+  /// Whether the value that comes next is `null`.
+  bool at_null() {
+    skip_whitespace();
+    return curr != end && *curr == 'n';
+  }
+
+  void read_null();
+
+  bool read_signed(std::int64_t& value);
+  bool read_unsigned(std::uint64_t& value);
+
+  template<typename T>
+  void read_integer(T& value) {
+    if constexpr (std::is_signed_v<T>) {
+      std::int64_t n;
+      if (!read_signed(n)) {
+        return;
+      }
+      if (n < std::numeric_limits<T>::min() || n > std::numeric_limits<T>::max()) {
+        fail(json_parse_error::number_out_of_range);
+        return;
+      }
+      value = static_cast<T>(n);
+    } else {
+      std::uint64_t n;
+      if (!read_unsigned(n)) {
+        return;
+      }
+      if (n > std::numeric_limits<T>::max()) {
+        fail(json_parse_error::number_out_of_range);
+        return;
+      }
+      value = static_cast<T>(n);
+    }
+  }
+
+  void read_fractional(double& value);
+
+  /// Read a string, which stays valid until the next string is read.
+  bool read_string(std::string_view& value);
+
+  void find_field(const std::string& name);
+  void index_object(object_frame& frame);
+
+public:
+
+  /// Create a decoder that reads from `input`, which must outlive the
+  /// decoder.
+  explicit json_decoder(std::string_view input, const json_decode_opts& opts = {});
+
+  /// Create a decoder that reads `input` until the end.
+  explicit json_decoder(std::istream& input, const json_decode_opts& opts = {});
+
+  json_decoder(const json_decoder& other) = delete;
+  json_decoder& operator=(const json_decoder& other) = delete;
+
+  /// Check that nothing but whitespace follows the value that was decoded
+  /// and report the first error that occurred, if any.
+  json_decode_result finish();
+
+  void transform(bool& v) override;
+
+  void transform(char& v) override;
+
+  void transform(short& v) override {
+    if (missing == 0) {
+      read_integer(v);
+    }
+  }
+
+  void transform(int& v) override {
+    if (missing == 0) {
+      read_integer(v);
+    }
+  }
+
+  void transform(long& v) override {
+    if (missing == 0) {
+      read_integer(v);
+    }
+  }
+
+  void transform(long long& v) override {
+    if (missing == 0) {
+      read_integer(v);
+    }
+  }
+
+  void transform(unsigned char& v) override {
+    if (missing == 0) {
+      read_integer(v);
+    }
+  }
+
+  void transform(unsigned short& v) override {
+    if (missing == 0) {
+      read_integer(v);
+    }
+  }
+
+  void transform(unsigned int& v) override {
+    if (missing == 0) {
+      read_integer(v);
+    }
+  }
+
+  void transform(unsigned long& v) override {
+    if (missing == 0) {
+      read_integer(v);
+    }
+  }
+
+  void transform(unsigned long long& v) override {
+    if (missing == 0) {
+      read_integer(v);
+    }
+  }
+
+  void transform(float& v) override {
+    if (missing == 0) {
+      double d = v;
+      read_fractional(d);
+      v = static_cast<float>(d);
+    }
+  }
+
+  void transform(double& v) override {
+    if (missing == 0) {
+      read_fractional(v);
+    }
+  }
+
+  void transform(std::string& v) override {
+    std::string_view str;
+    if (missing == 0 && read_string(str)) {
+      v.assign(str);
+    }
+  }
+
+  template<typename T>
+  void transform(std::optional<T>& value) {
+    if (at_null()) {
+      read_null();
+      value.reset();
+      return;
+    }
+    if (!value.has_value()) {
+      value.emplace();
+    }
+    transform(*value);
+  }
+
+  template<typename T1, typename T2>
+  void transform(std::pair<T1, T2>& value) {
+    if (!enter('[')) {
+      return;
+    }
+    bool first = true;
+    if (!next_member(']', first)) {
+      fail(json_parse_error::type_mismatch);
+      return;
+    }
+    transform(value.first);
+    if (!next_member(']', first)) {
+      fail(json_parse_error::type_mismatch);
+      return;
+    }
+    transform(value.second);
+    while (next_member(']', first)) {
+      skip();
+    }
+  }
+
+  /// Decode the value of a smart pointer, allocating it if needed.
+  ///
+  /// Raw pointers are only decoded into when they point to something.
+  template<typename T>
+  std::enable_if_t<meta::is_pointer_v<T>> transform(T& value) {
+    if (at_null()) {
+      read_null();
+      if constexpr (!std::is_pointer_v<T>) {
+        value = nullptr;
+      }
+      return;
+    }
+    if (value == nullptr) {
+      if constexpr (std::is_pointer_v<T>) {
+        skip();
+        return;
+      } else {
+        value = T(new std::remove_reference_t<decltype(*value)>());
+      }
+    }
+    transform(*value);
+  }
+
+  template<typename T>
+  std::enable_if_t<meta::is_container_v<T>> transform(T& value) {
+    static_assert(meta::has_emplace_back_v<T>, "can only decode into containers that have emplace_back()");
+    if (!enter('[')) {
+      return;
+    }
+    value.clear();
+    bool first = true;
+    while (next_member(']', first)) {
+      transform(value.emplace_back());
+    }
+  }
+
+  template<typename T>
+  std::enable_if_t<has_transform_fields_method_v<T, field_decoder>> transform(T& value) {
+    static const auto fields = json_detail::field_table::of(value);
+    if (!enter('{')) {
+      return;
+    }
+    bool first = true;
+    std::size_t expected = 0;
+    std::string_view key;
+    while (next_member('}', first)) {
+      if (!read_key(key)) {
+        return;
+      }
+      auto position = fields.find(key, expected);
+      if (position == json_detail::field_table::npos) {
+        skip();
+        continue;
+      }
+      expected = position + 1;
+      field_decoder decoder(*this, position);
+      value.transform_fields(decoder);
+    }
+  }
+
+  template<typename T>
+  std::enable_if_t<has_transform_method_v<T> && !has_transform_fields_method_v<T, field_decoder>> transform(T& value) {
+    value.transform(*this);
+  }
+
+  void start_transform_optional() override {}
+
+  /// Consume a `null`, or skip over whatever value comes instead.
+  void transform_nil() override;
+
+  void end_transform_optional() override {}
+
+  void start_transform_object(const std::string& tag_name) override;
+
+  /// Move to the value of the field `name`, which may come anywhere in the
+  /// object.
+  void start_transform_field(const std::string& name) override;
+
+  void end_transform_field() override {
+    if (missing > 0) {
+      --missing;
+    }
+  }
+
+  void end_transform_object() override;
+
+  void start_transform_sequence() override;
+
+  void transform_size(std::size_t) override {}
+
+  void start_transform_element() override;
+
+  void end_transform_element() override {}
+
+  void end_transform_sequence() override;
+
+  bool is_decoding() override {
+    return missing == 0;
+  }
+
+  bool has_value() override {
+    return !at_null();
+  }
+
+  bool has_element() override {
+    skip_whitespace();
+    return !error && curr != end && *curr != ']';
+  }
+
+};
+
+/// Create a decoder that reads `input` until the end.
+///
+/// Call json_decoder::finish() after decoding a value to find out whether it
+/// succeeded. decode_json() does that by itself.
+std::unique_ptr<json_decoder> make_json_decoder(
+  std::istream& input,
+  json_decode_opts opts = {}
+);
+
+/// Decode the JSON document in `input` into `value`.
+template<typename T>
+json_decode_result decode_json(std::string_view input, T& value, const json_decode_opts& opts = {}) {
+  json_decoder decoder(input, opts);
+  decoder.transform(value);
+  return decoder.finish();
+}
+
+template<typename T>
+json_decode_result decode_json(std::istream& input, T& value, const json_decode_opts& opts = {}) {
+  json_decoder decoder(input, opts);
+  decoder.transform(value);
+  return decoder.finish();
+}
+
+ZEN_NAMESPACE_END
+
+#endif // of #ifndef ZEN_JSON_DECODER_HPP
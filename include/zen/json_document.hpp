@@ -0,0 +1,434 @@
+/// \file zen/json_document.hpp
+/// \brief Read-only JSON documents that are stored in a flat tape.
+///
+/// A `zen::value` tree allocates a node for every element, every object key
+/// and every string, which makes parsed documents several times larger than
+/// the input. A `json_document` instead stores the entire document in one
+/// array of 64-bit words, called the tape, plus one buffer that holds the
+/// contents of all strings.
+///
+/// Each word on the tape starts with a one-byte tag, followed by a 56-bit
+/// payload:
+///
+/// | Tag   | Payload                                                    |
+/// |-------|------------------------------------------------------------|
+/// | `n`   | Unused (`null`)                                            |
+/// | `t`   | Unused (`true`)                                            |
+/// | `f`   | Unused (`false`)                                           |
+/// | `l`   | Unused. The next word holds the integer.                   |
+/// | `d`   | Unused. The next word holds the bits of the double.        |
+/// | `"`   | Offset of the string in the string buffer                  |
+/// | `'`   | Offset of the string in the input, and its size            |
+/// | `{`   | Index of the word after the matching `}`, and the size     |
+/// | `}`   | Index of the matching `{`                                  |
+/// | `[`   | Index of the word after the matching `]`, and the size     |
+/// | `]`   | Index of the matching `[`                                  |
+///
+/// Object members are stored as a string word for the key, directly followed
+/// by the value. Each string in the string buffer is prefixed by its length
+/// as a 32-bit integer and followed by a NUL byte.
+///
+/// When `json_parse_opts::borrow_strings` is set, strings without escape
+/// sequences are not copied at all. Their words hold the offset in the input
+/// in the lower 32 bits and the size in the upper 24 bits of the payload, and
+/// the input has to be kept alive for as long as the document is used. This
+/// is meant for inputs that are memory-mapped or otherwise stay in memory.
+///
+/// Containers that end past the 2^32-th word of the tape and strings that
+/// have to be copied but are 4 GiB or longer can't be addressed. Parsing
+/// such a document fails with `json_parse_error::document_too_large`.
+///
+/// Nothing is decoded until it is accessed. Looking up an object member is a
+/// linear scan over the keys of that object, skipping over nested containers
+/// in constant time.
+///
+/// ```cpp
+/// auto doc = zen::parse_json_document(input).unwrap();
+/// auto port = doc.root()["server"]["port"].as_integer();
+/// ```
+
+#ifndef ZEN_JSON_DOCUMENT_HPP
+#define ZEN_JSON_DOCUMENT_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "zen/config.hpp"
+#include "zen/either.hpp"
+#include "zen/json.hpp"
+#include "zen/value.hpp"
+
+ZEN_NAMESPACE_START
+
+class json_element;
+class json_array;
+class json_object;
+
+class json_document {
+
+  friend class json_element;
+  friend class json_array;
+  friend class json_object;
+  friend class json_tape_builder;
+
+  std::vector<std::uint64_t> tape;
+  std::string strings;
+  const char* input = nullptr;
+
+public:
+
+  static constexpr const std::uint64_t payload_mask = (std::uint64_t(1) << 56) - 1;
+
+  /// Get the value at the top of the document.
+  json_element root() const;
+
+  /// The amount of bytes that are used to store this document, excluding
+  /// the input that borrowed strings point to.
+  std::size_t memory_usage() const noexcept {
+    return tape.capacity() * sizeof(std::uint64_t) + strings.capacity();
+  }
+
+};
+
+using json_document_result = either<json_parse_error, json_document>;
+
+json_document_result parse_json_document(
+  const char* data,
+  std::size_t size,
+  json_parse_opts opts = {}
+);
+
+json_document_result parse_json_document(
+  std::string_view in,
+  json_parse_opts opts = {}
+);
+
+/// A reference to a single value inside a json_document.
+///
+/// Elements are cheap to copy. They are only valid for as long as the
+/// document they were obtained from.
+class json_element {
+
+  friend class json_document;
+  friend class json_array;
+  friend class json_object;
+  friend class json_array_iterator;
+  friend class json_object_iterator;
+
+  const json_document* doc;
+  std::size_t index;
+
+  json_element(const json_document* doc, std::size_t index):
+    doc(doc), index(index) {}
+
+  char tag() const noexcept {
+    return static_cast<char>(doc->tape[index] >> 56);
+  }
+
+  std::uint64_t payload() const noexcept {
+    return doc->tape[index] & json_document::payload_mask;
+  }
+
+  /// The index of the first word after this value.
+  std::size_t next_index() const noexcept {
+    switch (tag()) {
+      case '{':
+      case '[':
+        return payload() & 0xFFFFFFFF;
+      case 'l':
+      case 'd':
+        return index + 2;
+      default:
+        return index + 1;
+    }
+  }
+
+public:
+
+  value_type get_type() const noexcept {
+    switch (tag()) {
+      case 'n':
+        return value_type::null;
+      case 't':
+      case 'f':
+        return value_type::boolean;
+      case 'l':
+        return value_type::integer;
+      case 'd':
+        return value_type::fractional;
+      case '"':
+      case '\'':
+        return value_type::string;
+      case '{':
+        return value_type::object;
+      case '[':
+        return value_type::array;
+      default:
+        ZEN_UNREACHABLE
+    }
+  }
+
+  bool is_null() const noexcept {
+    return tag() == 'n';
+  }
+
+  bool is_true() const noexcept {
+    return tag() == 't';
+  }
+
+  bool is_false() const noexcept {
+    return tag() == 'f';
+  }
+
+  bool is_boolean() const noexcept {
+    return tag() == 't' || tag() == 'f';
+  }
+
+  bool is_integer() const noexcept {
+    return tag() == 'l';
+  }
+
+  bool is_fractional() const noexcept {
+    return tag() == 'd';
+  }
+
+  bool is_string() const noexcept {
+    return tag() == '"' || tag() == '\'';
+  }
+
+  bool is_object() const noexcept {
+    return tag() == '{';
+  }
+
+  bool is_array() const noexcept {
+    return tag() == '[';
+  }
+
+  bool as_boolean() const {
+    ZEN_ASSERT(is_boolean());
+    return tag() == 't';
+  }
+
+  bigint as_integer() const {
+    ZEN_ASSERT(is_integer());
+    return static_cast<bigint>(doc->tape[index + 1]);
+  }
+
+  fractional as_fractional() const {
+    ZEN_ASSERT(is_fractional());
+    fractional out;
+    std::memcpy(&out, &doc->tape[index + 1], sizeof(out));
+    return out;
+  }
+
+  /// Get the contents of this string as UTF-8.
+  std::string_view as_string() const {
+    ZEN_ASSERT(is_string());
+    if (tag() == '\'') {
+      return std::string_view(doc->input + (payload() & 0xFFFFFFFF), payload() >> 32);
+    }
+    auto ptr = doc->strings.data() + payload();
+    std::uint32_t size;
+    std::memcpy(&size, ptr, sizeof(size));
+    return std::string_view(ptr + sizeof(size), size);
+  }
+
+  json_array as_array() const;
+
+  json_object as_object() const;
+
+  /// Look up a member of this object.
+  std::optional<json_element> find(std::string_view key) const;
+
+  /// Get the member of this object named `key`, which must exist.
+  json_element operator[](std::string_view key) const;
+
+  /// Get the element of this array at position `i`, which must exist.
+  json_element operator[](std::size_t i) const;
+
+};
+
+class json_array_iterator {
+
+  friend class json_array;
+
+  json_element element;
+
+  json_array_iterator(json_element element):
+    element(element) {}
+
+public:
+
+  using value_type = json_element;
+  using reference = json_element;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::forward_iterator_tag;
+
+  json_element operator*() const {
+    return element;
+  }
+
+  json_array_iterator& operator++() {
+    element.index = element.next_index();
+    return *this;
+  }
+
+  bool operator==(const json_array_iterator& other) const {
+    return element.index == other.element.index;
+  }
+
+  bool operator!=(const json_array_iterator& other) const {
+    return element.index != other.element.index;
+  }
+
+};
+
+/// A view of the elements of an array in a json_document.
+class json_array {
+
+  friend class json_element;
+
+  json_element element;
+
+  json_array(json_element element):
+    element(element) {}
+
+public:
+
+  using iterator = json_array_iterator;
+
+  std::size_t size() const;
+
+  bool empty() const noexcept {
+    return element.index + 1 == (element.payload() & 0xFFFFFFFF) - 1;
+  }
+
+  iterator begin() const {
+    return json_element(element.doc, element.index + 1);
+  }
+
+  iterator end() const {
+    return json_element(element.doc, (element.payload() & 0xFFFFFFFF) - 1);
+  }
+
+};
+
+class json_object_iterator {
+
+  friend class json_object;
+
+  json_element key;
+
+  json_object_iterator(json_element key):
+    key(key) {}
+
+public:
+
+  using value_type = std::pair<std::string_view, json_element>;
+  using reference = value_type;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::forward_iterator_tag;
+
+  value_type operator*() const {
+    return { key.as_string(), json_element(key.doc, key.index + 1) };
+  }
+
+  json_object_iterator& operator++() {
+    key.index = json_element(key.doc, key.index + 1).next_index();
+    return *this;
+  }
+
+  bool operator==(const json_object_iterator& other) const {
+    return key.index == other.key.index;
+  }
+
+  bool operator!=(const json_object_iterator& other) const {
+    return key.index != other.key.index;
+  }
+
+};
+
+/// A view of the members of an object in a json_document, in the order in
+/// which they appeared in the input.
+class json_object {
+
+  friend class json_element;
+
+  json_element element;
+
+  json_object(json_element element):
+    element(element) {}
+
+public:
+
+  using iterator = json_object_iterator;
+
+  std::size_t size() const;
+
+  bool empty() const noexcept {
+    return element.index + 1 == (element.payload() & 0xFFFFFFFF) - 1;
+  }
+
+  std::optional<json_element> find(std::string_view key) const {
+    for (auto [name, member]: *this) {
+      if (name == key) {
+        return member;
+      }
+    }
+    return {};
+  }
+
+  iterator begin() const {
+    return json_element(element.doc, element.index + 1);
+  }
+
+  iterator end() const {
+    return json_element(element.doc, (element.payload() & 0xFFFFFFFF) - 1);
+  }
+
+};
+
+inline json_element json_document::root() const {
+  return json_element(this, 0);
+}
+
+inline json_array json_element::as_array() const {
+  ZEN_ASSERT(is_array());
+  return json_array(*this);
+}
+
+inline json_object json_element::as_object() const {
+  ZEN_ASSERT(is_object());
+  return json_object(*this);
+}
+
+inline std::optional<json_element> json_element::find(std::string_view key) const {
+  return as_object().find(key);
+}
+
+inline json_element json_element::operator[](std::string_view key) const {
+  auto result = find(key);
+  ZEN_ASSERT(result.has_value());
+  return *result;
+}
+
+inline json_element json_element::operator[](std::size_t i) const {
+  auto array = as_array();
+  auto curr = array.begin();
+  auto end = array.end();
+  for (; i > 0; --i) {
+    ZEN_ASSERT(curr != end);
+    ++curr;
+  }
+  ZEN_ASSERT(curr != end);
+  return *curr;
+}
+
+ZEN_NAMESPACE_END
+
+#endif // of #ifndef ZEN_JSON_DOCUMENT_HPP
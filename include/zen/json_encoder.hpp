@@ -0,0 +1,351 @@
+/// \file zen/json_encoder.hpp
+/// \brief Encoding C++ types as JSON without virtual calls.
+///
+/// json_encoder implements the virtual interface of zen::transformer, but
+/// it can also be used directly. Types that define `transform_fields()` as a
+/// template then receive the encoder itself instead of an
+/// object_transformer, so that the encoding of every field, container and
+/// number is resolved at compile time and can be inlined. Types that only
+/// define `transform(transformer&)` still work, because the encoder passes
+/// itself to them as a regular transformer.
+///
+/// ```cpp
+/// struct point {
+///
+///   int x;
+///   int y;
+///
+///   template<typename TransformerT>
+///   void transform_fields(TransformerT& t) {
+///     t.transform_field("x", x);
+///     t.transform_field("y", y);
+///   }
+///
+/// };
+///
+/// std::vector<point> points { { 1, 2 }, { 3, 4 } };
+/// zen::output_buffer out;
+/// zen::encode_json(out, points); // [{"x":1,"y":2},{"x":3,"y":4}]
+/// ```
+
+#ifndef ZEN_JSON_ENCODER_HPP
+#define ZEN_JSON_ENCODER_HPP
+
+#include <cstddef>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "zen/config.hpp"
+#include "zen/integer_format.hpp"
+#include "zen/json.hpp"
+#include "zen/meta.hpp"
+#include "zen/output_buffer.hpp"
+#include "zen/transformer.hpp"
+
+ZEN_NAMESPACE_START
+
+namespace json_detail {
+
+  template<typename T>
+  void write_integer(output_buffer& out, T value) {
+    auto ptr = out.prepare(max_integer_length);
+    out.commit(format_integer(value, ptr) - ptr);
+  }
+
+  /// Write the shortest representation of `value` that reads back as the
+  /// same number.
+  ///
+  /// Integral values get a `.0` suffix so that they are read back as
+  /// fractional numbers. JSON has no infinities or NaN, so they are written
+  /// as `null`.
+  void write_fractional(output_buffer& out, float value);
+  void write_fractional(output_buffer& out, double value);
+
+}
+
+class json_encoder final : public transformer {
+
+  std::string indentation;
+
+  // Used when the encoder was given a std::ostream
+  output_buffer own_buffer;
+
+  output_buffer& out;
+
+  /// How many objects and arrays are open.
+  std::size_t depth = 0;
+
+  /// Whether nothing has been written yet in the innermost object or array.
+  bool first = true;
+
+  void write_newline() {
+    if (indentation.empty()) {
+      return;
+    }
+    out.put('\n');
+    for (std::size_t i = 0; i < depth; ++i) {
+      out.write(indentation);
+    }
+  }
+
+  /// Write what comes before a field or an element.
+  void start_member() {
+    if (!first) {
+      out.put(',');
+    }
+    first = false;
+    write_newline();
+  }
+
+  void write_key(std::string_view name) {
+    start_member();
+    write_json_string(out, name);
+    out.put(':');
+    if (!indentation.empty()) {
+      out.put(' ');
+    }
+  }
+
+  /// Makes the output visible to the stream as soon as a value is complete,
+  /// so that callers can use the stream while the encoder is alive.
+  void end_value() {
+    if (depth == 0 && &out == &own_buffer) {
+      out.flush();
+    }
+  }
+
+  void start_container(char open) {
+    out.put(open);
+    ++depth;
+    first = true;
+  }
+
+  void end_container(char close) {
+    --depth;
+    write_newline();
+    out.put(close);
+    first = false;
+    end_value();
+  }
+
+public:
+
+  json_encoder(std::ostream& stream, const json_encode_opts& opts = {}):
+    indentation(opts.indentation), own_buffer(stream), out(own_buffer) {}
+
+  /// Create an encoder that writes into `out` and leaves flushing it to the
+  /// caller.
+  json_encoder(output_buffer& out, const json_encode_opts& opts = {}):
+    indentation(opts.indentation), out(out) {}
+
+  /// Create an encoder for values that are nested `depth` levels deep in
+  /// objects or arrays of which the opening brackets have already been
+  /// written.
+  ///
+  /// `first` tells whether anything has been written in the innermost
+  /// object or array.
+  json_encoder(output_buffer& out, const json_encode_opts& opts, std::size_t depth, bool first):
+    indentation(opts.indentation), out(out), depth(depth), first(first) {}
+
+  void transform(bool& v) override {
+    out.write(v ? std::string_view("true") : std::string_view("false"));
+    end_value();
+  }
+
+  void transform(char& v) override {
+    write_json_string(out, std::string_view(&v, 1));
+    end_value();
+  }
+
+  void transform(short& v) override {
+    json_detail::write_integer(out, v);
+    end_value();
+  }
+
+  void transform(int& v) override {
+    json_detail::write_integer(out, v);
+    end_value();
+  }
+
+  void transform(long& v) override {
+    json_detail::write_integer(out, v);
+    end_value();
+  }
+
+  void transform(long long& v) override {
+    json_detail::write_integer(out, v);
+    end_value();
+  }
+
+  void transform(unsigned char& v) override {
+    json_detail::write_integer(out, v);
+    end_value();
+  }
+
+  void transform(unsigned short& v) override {
+    json_detail::write_integer(out, v);
+    end_value();
+  }
+
+  void transform(unsigned int& v) override {
+    json_detail::write_integer(out, v);
+    end_value();
+  }
+
+  void transform(unsigned long& v) override {
+    json_detail::write_integer(out, v);
+    end_value();
+  }
+
+  void transform(unsigned long long& v) override {
+    json_detail::write_integer(out, v);
+    end_value();
+  }
+
+  void transform(float& v) override {
+    json_detail::write_fractional(out, v);
+    end_value();
+  }
+
+  void transform(double& v) override {
+    json_detail::write_fractional(out, v);
+    end_value();
+  }
+
+  void transform(std::string& v) override {
+    write_json_string(out, v);
+    end_value();
+  }
+
+  template<typename T>
+  void transform(std::optional<T>& value) {
+    if (value.has_value()) {
+      transform(*value);
+    } else {
+      transform_nil();
+    }
+  }
+
+  template<typename T1, typename T2>
+  void transform(std::pair<T1, T2>& value) {
+    start_container('[');
+    start_member();
+    transform(value.first);
+    start_member();
+    transform(value.second);
+    end_container(']');
+  }
+
+  template<typename T>
+  std::enable_if_t<meta::is_pointer_v<T>> transform(T& value) {
+    if (value == nullptr) {
+      transform_nil();
+    } else {
+      transform(*value);
+    }
+  }
+
+  template<typename T>
+  std::enable_if_t<meta::is_container_v<T>> transform(T& value) {
+    start_container('[');
+    for (auto& element: value) {
+      start_member();
+      transform(element);
+    }
+    end_container(']');
+  }
+
+  /// Write `value` as an object of the fields that its `transform_fields()`
+  /// method reports.
+  template<typename T>
+  std::enable_if_t<has_transform_fields_method_v<T, json_encoder>> transform(T& value) {
+    start_container('{');
+    value.transform_fields(*this);
+    end_container('}');
+  }
+
+  template<typename T>
+  std::enable_if_t<has_transform_method_v<T> && !has_transform_fields_method_v<T, json_encoder>> transform(T& value) {
+    value.transform(*this);
+  }
+
+  /// Write a field of the object that is being encoded by
+  /// `transform_fields()`.
+  template<typename T>
+  void transform_field(std::string_view name, T&& value) {
+    write_key(name);
+    transform(value);
+  }
+
+  void start_transform_optional() override {}
+
+  void transform_nil() override {
+    out.write("null", 4);
+    end_value();
+  }
+
+  void end_transform_optional() override {}
+
+  void start_transform_object(const std::string&) override {
+    start_container('{');
+  }
+
+  void start_transform_field(const std::string& name) override {
+    write_key(name);
+  }
+
+  void end_transform_field() override {}
+
+  void end_transform_object() override {
+    end_container('}');
+  }
+
+  void start_transform_sequence() override {
+    start_container('[');
+  }
+
+  void transform_size(std::size_t) override {}
+
+  void start_transform_element() override {
+    start_member();
+  }
+
+  void end_transform_element() override {}
+
+  void end_transform_sequence() override {
+    end_container(']');
+  }
+
+};
+
+/// Write `value` into `out` as JSON.
+///
+/// Unlike going through make_json_encoder(), the type of `value` is known
+/// here, so that types with a `transform_fields()` template are encoded
+/// without any virtual calls.
+template<typename T>
+void encode_json(output_buffer& out, T& value, const json_encode_opts& opts = {}) {
+  json_encoder encoder(out, opts);
+  encoder.transform(value);
+}
+
+template<typename T>
+void encode_json(std::ostream& out, T& value, const json_encode_opts& opts = {}) {
+  json_encoder encoder(out, opts);
+  encoder.transform(value);
+}
+
+template<typename OutputT, typename T>
+void encode_json_pretty(OutputT& out, T& value) {
+  json_encode_opts opts;
+  opts.indentation = "    ";
+  encode_json(out, value, opts);
+}
+
+ZEN_NAMESPACE_END
+
+#endif // of #ifndef ZEN_JSON_ENCODER_HPP
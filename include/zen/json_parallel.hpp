@@ -0,0 +1,154 @@
+/// \file zen/json_parallel.hpp
+/// \brief Writing large JSON arrays on several threads.
+///
+/// The elements of a top-level array are cut into chunks that are encoded
+/// on a pool of worker threads, each into its own buffer. The calling thread
+/// writes the buffers in order as soon as they are ready, so the output is
+/// byte-for-byte the same as that of the sequential encoder. When writing to
+/// a file descriptor, several buffers are written at once with `writev()`.
+///
+/// Only a bounded number of chunks is held in memory at any time, so
+/// arrays that are much larger than the available memory can be written
+/// to a file.
+///
+/// ```cpp
+/// zen::json_parallel_opts opts;
+/// opts.threads = 8;
+/// auto result = zen::print_parallel(documents, STDOUT_FILENO, {}, opts);
+/// ```
+
+#ifndef ZEN_JSON_PARALLEL_HPP
+#define ZEN_JSON_PARALLEL_HPP
+
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "zen/either.hpp"
+#include "zen/json.hpp"
+#include "zen/json_encoder.hpp"
+#include "zen/output_buffer.hpp"
+#include "zen/transformer.hpp"
+#include "zen/value.hpp"
+
+ZEN_NAMESPACE_START
+
+struct json_parallel_opts {
+
+  /// The amount of worker threads. Zero means one per hardware thread.
+  std::size_t threads = 0;
+
+  /// The amount of array elements that make up one unit of work.
+  std::size_t chunk_size = 4096;
+
+};
+
+using json_write_result = either<std::error_code, void>;
+
+namespace json_detail {
+
+  using encode_chunk_fn = std::function<void(std::size_t begin, std::size_t end, output_buffer& out)>;
+
+  /// Write an array of `size` elements, of which the elements from `begin`
+  /// to `end` are written into a buffer by `encode_chunk`.
+  ///
+  /// An empty array is written as `empty_array`. The output goes to `out` if
+  /// it isn't null and to `fd` otherwise.
+  json_write_result write_array_parallel(
+    std::size_t size,
+    bool pretty,
+    std::string_view empty_array,
+    const encode_chunk_fn& encode_chunk,
+    const json_parallel_opts& opts,
+    output_buffer* out,
+    int fd
+  );
+
+  /// Write the elements of an array as print() would, without the brackets.
+  void print_elements(
+    const value* begin,
+    const value* end,
+    output_buffer& out,
+    const json_print_opts& opts,
+    bool first
+  );
+
+  template<typename T>
+  json_write_result encode_json_parallel(
+    std::vector<T>& items,
+    const json_encode_opts& encode_opts,
+    const json_parallel_opts& opts,
+    output_buffer* out,
+    int fd
+  ) {
+    bool pretty = !encode_opts.indentation.empty();
+    return write_array_parallel(
+      items.size(),
+      pretty,
+      pretty ? "[\n]" : "[]",
+      [&](std::size_t begin, std::size_t end, output_buffer& chunk) {
+        json_encoder encoder(chunk, encode_opts, 1, begin == 0);
+        for (auto i = begin; i < end; ++i) {
+          encoder.start_transform_element();
+          encoder.transform(items[i]);
+        }
+      },
+      opts,
+      out,
+      fd
+    );
+  }
+
+}
+
+/// Write `v` into `out` like print() does, encoding the elements of `v` on
+/// several threads if it is an array.
+void print_parallel(
+  const value& v,
+  output_buffer& out,
+  const json_print_opts& print_opts = {},
+  const json_parallel_opts& opts = {}
+);
+
+/// Write `v` to the file descriptor `fd` like print() does, encoding the
+/// elements of `v` on several threads if it is an array.
+json_write_result print_parallel(
+  const value& v,
+  int fd,
+  const json_print_opts& print_opts = {},
+  const json_parallel_opts& opts = {}
+);
+
+/// Write `items` into `out` like encode_json() does, encoding the elements
+/// on several threads.
+///
+/// The elements are encoded concurrently, so their `transform()` method
+/// must not modify any state that they share.
+template<typename T>
+void encode_json_parallel(
+  std::vector<T>& items,
+  output_buffer& out,
+  const json_encode_opts& encode_opts = {},
+  const json_parallel_opts& opts = {}
+) {
+  json_detail::encode_json_parallel(items, encode_opts, opts, &out, -1);
+}
+
+/// Write `items` to the file descriptor `fd` like encode_json() does,
+/// encoding the elements on several threads.
+template<typename T>
+json_write_result encode_json_parallel(
+  std::vector<T>& items,
+  int fd,
+  const json_encode_opts& encode_opts = {},
+  const json_parallel_opts& opts = {}
+) {
+  return json_detail::encode_json_parallel(items, encode_opts, opts, nullptr, fd);
+}
+
+ZEN_NAMESPACE_END
+
+#endif // of #ifndef ZEN_JSON_PARALLEL_HPP
@@ -0,0 +1,243 @@
+/// \file zen/json_path.hpp
+/// \brief Compiled JSON Pointer and JSONPath queries over zen::value.
+///
+/// A path is parsed once into a list of steps, with every object key already
+/// decoded and hashed. Evaluating it afterwards is a sequence of hash
+/// lookups in the objects of the document.
+///
+/// Two syntaxes are accepted:
+///
+///  - JSON Pointer as defined in RFC 6901, e.g. `/servers/0/host`
+///  - A subset of JSONPath made up of `$`, `.name`, `['name']`, `[n]`,
+///    `[-n]` (counting from the end), `.*` and `[*]`, e.g.
+///    `$.servers[*].host`. Recursive descent (`..`), filters and slices are
+///    not supported.
+///
+/// When many paths have to be evaluated against the same document, add them
+/// to a json_query_set, which walks the document only once for all of them.
+///
+/// If the document is only needed for the values that the paths select, pass
+/// the set to parse_json_paths() instead. It builds the selected values and
+/// skips over the rest of the input without building anything.
+///
+/// ```cpp
+/// auto port = zen::compile_json_pointer("/server/port").unwrap();
+/// if (auto match = port.find(doc)) {
+///   std::cout << match->as_integer() << "\n";
+/// }
+/// ```
+
+#ifndef ZEN_JSON_PATH_HPP
+#define ZEN_JSON_PATH_HPP
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "zen/config.hpp"
+#include "zen/either.hpp"
+#include "zen/hash.hpp"
+#include "zen/json.hpp"
+#include "zen/string.hpp"
+#include "zen/value.hpp"
+
+ZEN_NAMESPACE_START
+
+enum class json_path_error {
+  unexpected_character,
+  unterminated_string,
+  invalid_escape_sequence,
+  invalid_index,
+};
+
+enum class json_path_step_kind {
+  /// Select the member of an object with the given key
+  member,
+  /// Select the element of an array at the given index
+  index,
+  /// Select every member of an object or every element of an array
+  wildcard,
+};
+
+struct json_path_step {
+
+  json_path_step_kind kind;
+
+  /// The key of a member step
+  string key;
+
+  /// The hash of `key`, as computed by zen::string_hash
+  std::size_t hash = 0;
+
+  /// The position that is selected by an index step. Negative indices count
+  /// from the end of the array.
+  ///
+  /// A JSON Pointer token such as `0` can refer to both an object member and
+  /// an array element, so member steps set `has_index` when their key is a
+  /// valid array index.
+  std::ptrdiff_t index = 0;
+
+  bool has_index = false;
+
+};
+
+class json_path {
+
+  friend class json_query_set;
+
+  std::vector<json_path_step> steps;
+
+public:
+
+  json_path(std::vector<json_path_step> steps = {}):
+    steps(std::move(steps)) {}
+
+  const std::vector<json_path_step>& get_steps() const noexcept {
+    return steps;
+  }
+
+  /// Returns true if this path selects at most one value.
+  bool is_singular() const noexcept;
+
+  /// Get the first value that is selected by this path, or `nullptr` if it
+  /// does not select anything in `root`.
+  const value* find(const value& root) const;
+
+  value* find(value& root) const {
+    return const_cast<value*>(find(static_cast<const value&>(root)));
+  }
+
+  /// Add every value that is selected by this path to `out`, in document
+  /// order.
+  void evaluate(const value& root, std::vector<const value*>& out) const;
+
+};
+
+using json_path_result = either<json_path_error, json_path>;
+
+/// Compile a JSON Pointer as defined in RFC 6901.
+///
+/// The empty string refers to the root of the document.
+json_path_result compile_json_pointer(std::string_view pointer);
+
+/// Compile a JSONPath expression, which must start with `$`.
+json_path_result compile_json_path(std::string_view path);
+
+/// Evaluates many paths at once with a single walk over the document.
+///
+/// The paths are merged into a tree, so that a prefix that is shared by
+/// several paths is only looked up once.
+class json_query_set {
+
+  friend class json_path_extractor;
+
+  struct node {
+
+    /// The paths that end at this node
+    std::vector<std::size_t> terminals;
+
+    /// Member steps, together with the node they lead to
+    std::vector<std::pair<json_path_step, std::size_t>> members;
+
+    /// The position of each key in `members`, by the hash of the key
+    std::unordered_multimap<std::size_t, std::size_t> member_lookup;
+
+    /// Index steps, together with the node they lead to
+    std::vector<std::pair<std::ptrdiff_t, std::size_t>> indices;
+
+    /// The node that a wildcard leads to, or zero if there is none
+    std::size_t wildcard = 0;
+
+  };
+
+  std::vector<node> nodes;
+
+  std::size_t path_count = 0;
+
+  /// Get the node that a member step equal to `step` leads to, or zero if
+  /// there is no such step.
+  ///
+  /// Steps for the same key are only merged if they also agree on whether
+  /// they can select an array element, because a JSON Pointer token such
+  /// as `1` matches more than a member step of `$['1']` does.
+  static std::size_t find_step(const node& n, const json_path_step& step);
+
+  /// Call `visit` with the node of every member step of `n` for `key`.
+  template<typename K, typename F>
+  static void for_each_member(const node& n, const K& key, std::size_t hash, F&& visit) {
+    auto [begin, end] = n.member_lookup.equal_range(hash);
+    for (auto iter = begin; iter != end; ++iter) {
+      auto& [step, child] = n.members[iter->second];
+      if (step.key == key) {
+        visit(iter->second, child);
+      }
+    }
+  }
+
+  void evaluate_node(
+    std::size_t node_index,
+    const value& v,
+    std::vector<std::vector<const value*>>& results
+  ) const;
+
+  /// Like evaluate_node() but skips the paths that end at the node itself.
+  void evaluate_children(
+    std::size_t node_index,
+    const value& v,
+    std::vector<std::vector<const value*>>& results
+  ) const;
+
+public:
+
+  json_query_set();
+
+  /// Add a path to this set, returning the position of its matches in the
+  /// results of evaluate().
+  std::size_t add(const json_path& path);
+
+  /// The amount of paths in this set.
+  std::size_t size() const noexcept {
+    return path_count;
+  }
+
+  /// Evaluate all paths against `root`.
+  ///
+  /// `results` is resized to the amount of paths and `results[i]` receives
+  /// the values selected by the `i`-th path.
+  void evaluate(
+    const value& root,
+    std::vector<std::vector<const value*>>& results
+  ) const;
+
+};
+
+using json_extract_result = either<json_parse_error, std::vector<std::vector<value>>>;
+
+/// Parse only the parts of a JSON document that are selected by `paths`.
+///
+/// `result[i]` holds the values that are selected by the `i`-th path of the
+/// set, in document order, exactly as json_query_set::evaluate() would find
+/// them in the fully parsed document.
+///
+/// Subtrees that no path can reach are skipped by counting brackets and
+/// quotes, without building values or decoding strings, so the cost depends
+/// mostly on the size of the selected values. The flip side is that skipped
+/// subtrees are only checked for balanced brackets and terminated strings;
+/// other syntax errors inside them go unnoticed.
+json_extract_result parse_json_paths(
+  const char* data,
+  std::size_t size,
+  const json_query_set& paths,
+  json_parse_opts opts = {}
+);
+
+json_extract_result parse_json_paths(
+  std::string_view in,
+  const json_query_set& paths,
+  json_parse_opts opts = {}
+);
+
+ZEN_NAMESPACE_END
+
+#endif // of #ifndef ZEN_JSON_PATH_HPP
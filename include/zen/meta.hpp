@@ -419,6 +419,18 @@ namespace meta {
   template<typename T>
   static constexpr const bool is_container_v = is_container<T>::value;
 
+  /// Whether elements can be appended to `T` with `emplace_back()`.
+  template<typename T, typename = void>
+  struct has_emplace_back : std::false_type {};
+
+  template<typename T>
+  struct has_emplace_back<T,
+      std::void_t<decltype(std::declval<T&>().emplace_back())>
+      > : std::true_type { };
+
+  template<typename T>
+  static constexpr const bool has_emplace_back_v = has_emplace_back<T>::value;
+
   template<typename T, typename U>
   auto static_pointer_cast(U& ptr);
 
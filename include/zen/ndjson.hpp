@@ -0,0 +1,83 @@
+/// \file zen/ndjson.hpp
+/// \brief Parallel reading of newline-delimited JSON (JSON Lines).
+///
+/// Each line of the input holds a single JSON value. The input is cut into
+/// batches of whole lines that are parsed on a pool of worker threads, while
+/// the calling thread keeps reading ahead. Results are handed back to the
+/// calling thread, so the callback does not have to be thread-safe.
+///
+/// ```cpp
+/// zen::ndjson_opts opts;
+/// opts.threads = 8;
+/// zen::parse_ndjson(std::cin, [](zen::ndjson_record& record) {
+///   if (record.result.is_left()) {
+///     std::cerr << "line " << record.index + 1 << " is invalid\n";
+///   }
+/// }, opts);
+/// ```
+
+#ifndef ZEN_NDJSON_HPP
+#define ZEN_NDJSON_HPP
+
+#include <cstdlib>
+#include <functional>
+#include <istream>
+#include <string_view>
+
+#include "zen/json.hpp"
+
+ZEN_NAMESPACE_START
+
+struct ndjson_opts {
+
+  /// The amount of worker threads. Zero means one per hardware thread.
+  std::size_t threads = 0;
+
+  /// Deliver records in the order in which they appear in the input. When
+  /// false, records are delivered as soon as the batch containing them has
+  /// been parsed.
+  bool ordered = true;
+
+  /// The approximate amount of bytes that make up one unit of work. Zero is
+  /// treated as one.
+  std::size_t batch_size = 256 * 1024;
+
+  json_parse_opts parse_opts = {};
+
+};
+
+struct ndjson_record {
+
+  /// The zero-based number of the line this record was found on.
+  std::size_t index;
+
+  json_parse_result result;
+
+};
+
+using ndjson_callback = std::function<void(ndjson_record&)>;
+
+/// Parse every line of `input` and pass the results to `callback`.
+///
+/// Empty lines are skipped. A carriage return at the end of a line is
+/// ignored.
+void parse_ndjson(
+  std::string_view input,
+  const ndjson_callback& callback,
+  ndjson_opts opts = {}
+);
+
+/// Read `input` until the end and parse every line, passing the results to
+/// `callback`.
+///
+/// At most a few batches per thread are kept in memory at any time, so this
+/// can be used on inputs that do not fit in memory.
+void parse_ndjson(
+  std::istream& input,
+  const ndjson_callback& callback,
+  ndjson_opts opts = {}
+);
+
+ZEN_NAMESPACE_END
+
+#endif // of #ifndef ZEN_NDJSON_HPP
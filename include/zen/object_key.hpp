@@ -0,0 +1,358 @@
+/// \file zen/object_key.hpp
+/// \brief Immutable, shareable keys for the members of an object.
+///
+/// The objects in a typical JSON document use the same handful of keys over
+/// and over again. A key_table lets all of these objects point to a single
+/// copy of each key, of which the hash is computed only once.
+
+#ifndef ZEN_OBJECT_KEY_HPP
+#define ZEN_OBJECT_KEY_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <new>
+#include <string_view>
+#include <unordered_map>
+
+#include "zen/config.hpp"
+#include "zen/hash.hpp"
+#include "zen/string.hpp"
+#include "zen/unicode.hpp"
+
+ZEN_NAMESPACE_START
+
+/// A read-only view of a sequence of code points, such as a zen::string.
+using code_point_view = std::basic_string_view<std::uint32_t>;
+
+/// The key of a member of an object.
+///
+/// A key is an immutable string that stores its hash, so that putting it in
+/// a hash index never has to look at its characters. Keys are reference
+/// counted. Copying a key that lives on the default resource only bumps its
+/// count. Keys that live on any other resource, such as an arena, are copied
+/// to the default resource, so that a copied value never depends on the arena
+/// of the original.
+///
+/// A key holds either code points or UTF-8. Both kinds hash the same and
+/// compare equal when they spell the same text, so a UTF-8 key can be looked
+/// up with a zen::string and the other way around.
+class object_key {
+
+  friend class key_table;
+
+  struct rep {
+
+    std::atomic<std::size_t> refs;
+    std::size_t hash;
+    std::size_t size;
+    std::pmr::memory_resource* resource;
+    bool utf8;
+
+    rep(std::size_t hash, std::size_t size, std::pmr::memory_resource* resource, bool utf8):
+      refs(1), hash(hash), size(size), resource(resource), utf8(utf8) {}
+
+    // The code points or bytes directly follow the header
+    std::uint32_t* chars() noexcept {
+      return reinterpret_cast<std::uint32_t*>(this + 1);
+    }
+
+    char* bytes() noexcept {
+      return reinterpret_cast<char*>(this + 1);
+    }
+
+    static std::size_t byte_count(std::size_t size, bool utf8) noexcept {
+      return sizeof(rep) + size * (utf8 ? 1 : sizeof(std::uint32_t));
+    }
+
+  };
+
+  rep* r = nullptr;
+
+  static rep* create(const void* data, std::size_t size, bool utf8, std::size_t hash, std::pmr::memory_resource* resource) {
+    auto memory = resource->allocate(rep::byte_count(size, utf8), alignof(rep));
+    auto out = new (memory) rep(hash, size, resource, utf8);
+    if (size > 0) {
+      std::memcpy(out->bytes(), data, rep::byte_count(size, utf8) - sizeof(rep));
+    }
+    return out;
+  }
+
+  static void release(rep* r) noexcept {
+    if (r == nullptr || r->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+      return;
+    }
+    auto resource = r->resource;
+    auto bytes = rep::byte_count(r->size, r->utf8);
+    r->~rep();
+    resource->deallocate(r, bytes, alignof(rep));
+  }
+
+  /// Get another reference to the same key, even if it is not on the default
+  /// resource.
+  object_key share() const noexcept {
+    object_key out;
+    out.r = r;
+    if (r != nullptr) {
+      r->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    return out;
+  }
+
+  static bool same_code_points(code_point_view a, std::string_view b) noexcept {
+    auto iter = a.begin();
+    for (auto ch: utf8_code_points(b)) {
+      if (iter == a.end() || *iter != ch) {
+        return false;
+      }
+      ++iter;
+    }
+    return iter == a.end();
+  }
+
+public:
+
+  /// Hash the code points of `text` the same way as zen::string_hash
+  /// hashes a zen::string.
+  static std::size_t hash_utf8(std::string_view text) noexcept {
+    std::size_t h = 17;
+    std::size_t i = 0;
+    // ASCII bytes are their own code point, so only the rest is decoded
+    for (; i < text.size() && static_cast<unsigned char>(text[i]) < 0x80; ++i) {
+      h = h * 19 + static_cast<unsigned char>(text[i]);
+    }
+    if (i < text.size()) {
+      for (auto ch: utf8_code_points(text.substr(i))) {
+        h = h * 19 + ch;
+      }
+    }
+    return h;
+  }
+
+  /// Create the empty key.
+  object_key() noexcept = default;
+
+  /// Create a key with a copy of `text` that is allocated from `resource`.
+  object_key(
+    code_point_view text,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()
+  ): r(create(text.data(), text.size(), false, string_hash{}(text), resource)) {}
+
+  object_key(const string& text):
+    object_key(code_point_view(text)) {}
+
+  /// Create a key that keeps a copy of the UTF-8 text `text` as-is.
+  explicit object_key(
+    std::string_view text,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()
+  ): r(create(text.data(), text.size(), true, hash_utf8(text), resource)) {}
+
+  object_key(const object_key& other) {
+    if (other.r == nullptr) {
+      return;
+    }
+    auto resource = std::pmr::get_default_resource();
+    if (other.r->resource->is_equal(*resource)) {
+      r = other.r;
+      r->refs.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      r = create(other.r + 1, other.r->size, other.r->utf8, other.r->hash, resource);
+    }
+  }
+
+  object_key(object_key&& other) noexcept:
+    r(other.r) {
+      other.r = nullptr;
+    }
+
+  object_key& operator=(const object_key& other) {
+    object_key copy(other);
+    std::swap(r, copy.r);
+    return *this;
+  }
+
+  object_key& operator=(object_key&& other) noexcept {
+    std::swap(r, other.r);
+    return *this;
+  }
+
+  ~object_key() {
+    release(r);
+  }
+
+  /// Whether this key holds UTF-8 rather than code points.
+  bool is_utf8() const noexcept {
+    return r != nullptr && r->utf8;
+  }
+
+  /// The code points of a key that is not in UTF-8.
+  ///
+  /// A key in UTF-8 has no code points to point to and gives an empty view,
+  /// so check is_utf8() first, or use utf8_code_points() on utf8() to get
+  /// the code points of any key.
+  code_point_view view() const noexcept {
+    ZEN_ASSERT(!is_utf8());
+    return r == nullptr || r->utf8 ? code_point_view() : code_point_view(r->chars(), r->size);
+  }
+
+  /// Only explicit, so that a key in UTF-8 can't pass for an empty one
+  /// without anyone asking for it.
+  explicit operator code_point_view() const noexcept {
+    return view();
+  }
+
+  /// The text of a key that is in UTF-8.
+  std::string_view utf8() const noexcept {
+    ZEN_ASSERT(r == nullptr || r->utf8);
+    return r == nullptr ? std::string_view() : std::string_view(r->bytes(), r->size);
+  }
+
+  /// The amount of code points in this key, or of bytes if it is in UTF-8.
+  std::size_t size() const noexcept {
+    return r == nullptr ? 0 : r->size;
+  }
+
+  bool empty() const noexcept {
+    return size() == 0;
+  }
+
+  /// The hash of this key, which is the same as that of a zen::string with
+  /// the same contents.
+  std::size_t hash() const noexcept {
+    return r == nullptr ? string_hash{}(code_point_view()) : r->hash;
+  }
+
+  friend bool operator==(const object_key& a, const object_key& b) noexcept {
+    if (a.r == b.r) {
+      return true;
+    }
+    if (a.hash() != b.hash()) {
+      return false;
+    }
+    if (a.is_utf8() == b.is_utf8()) {
+      return a.is_utf8() ? a.utf8() == b.utf8() : a.view() == b.view();
+    }
+    return a.is_utf8() ? same_code_points(b.view(), a.utf8()) : same_code_points(a.view(), b.utf8());
+  }
+
+  friend bool operator==(const object_key& a, code_point_view b) noexcept {
+    return a.is_utf8() ? same_code_points(b, a.utf8()) : a.view() == b;
+  }
+
+  friend bool operator==(code_point_view a, const object_key& b) noexcept {
+    return b == a;
+  }
+
+  /// Compare with the UTF-8 text `b`, without creating a key for it.
+  friend bool operator==(const object_key& a, std::string_view b) noexcept {
+    return a.is_utf8() ? a.utf8() == b : same_code_points(a.view(), b);
+  }
+
+  friend bool operator==(std::string_view a, const object_key& b) noexcept {
+    return b == a;
+  }
+
+  friend bool operator==(const object_key& a, const string& b) noexcept {
+    return a == code_point_view(b);
+  }
+
+  friend bool operator==(const string& a, const object_key& b) noexcept {
+    return b == code_point_view(a);
+  }
+
+  template<typename T>
+  friend bool operator!=(const object_key& a, const T& b) noexcept {
+    return !(a == b);
+  }
+
+};
+
+/// Hashes object keys and the text that they can be looked up with, which
+/// is either code points or UTF-8, so that equal keys and text hash the
+/// same.
+struct object_key_hash {
+
+  std::size_t operator()(const object_key& key) const noexcept {
+    return key.hash();
+  }
+
+  std::size_t operator()(code_point_view text) const noexcept {
+    return string_hash{}(text);
+  }
+
+  std::size_t operator()(const string& text) const noexcept {
+    return string_hash{}(text);
+  }
+
+  std::size_t operator()(std::string_view text) const noexcept {
+    return object_key::hash_utf8(text);
+  }
+
+};
+
+/// Hands out a single shared object_key for every distinct key it is given.
+///
+/// Give one to the parser through json_parse_opts::keys to share keys
+/// between several documents. Keys that were handed out stay valid after
+/// the table is destroyed, but if the table allocates from an arena, the
+/// arena must outlive them.
+///
+/// A table must not be used by more than one thread at a time.
+class key_table {
+
+  std::pmr::memory_resource* resource;
+
+  string_storage storage;
+
+  // Storage for the UTF-8 spelling of every key in `entries`
+  std::pmr::monotonic_buffer_resource spellings;
+
+  std::unordered_map<std::string_view, object_key> entries;
+
+  string scratch;
+  std::string utf8_scratch;
+
+public:
+
+  /// Create an empty table that allocates its keys from `resource` and
+  /// stores them as `storage` says.
+  key_table(
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+    string_storage storage = string_storage::code_points
+  ): resource(resource), storage(storage), spellings(resource) {}
+
+  key_table(const key_table& other) = delete;
+  key_table& operator=(const key_table& other) = delete;
+
+  /// Get the key for the UTF-8 text `text`, creating it if this is the first
+  /// time it is seen.
+  object_key intern(std::string_view text);
+
+  string_storage get_storage() const noexcept {
+    return storage;
+  }
+
+  /// The amount of distinct keys in this table.
+  std::size_t size() const noexcept {
+    return entries.size();
+  }
+
+};
+
+ZEN_NAMESPACE_END
+
+namespace std {
+
+  template<>
+  struct hash<ZEN_NAMESPACE::object_key> {
+
+    std::size_t operator()(const ZEN_NAMESPACE::object_key& key) const noexcept {
+      return key.hash();
+    }
+
+  };
+
+}
+
+#endif // of #ifndef ZEN_OBJECT_KEY_HPP
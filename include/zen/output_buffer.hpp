@@ -0,0 +1,173 @@
+#ifndef ZEN_OUTPUT_BUFFER_HPP
+#define ZEN_OUTPUT_BUFFER_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <variant>
+
+#include "zen/config.hpp"
+
+ZEN_NAMESPACE_START
+
+/// A contiguous buffer that serializers write into with plain memory copies.
+///
+/// The buffer hands its contents to a sink in large chunks: a file
+/// descriptor, an output stream or a callback. Without a sink, the buffer
+/// grows to hold everything that was written, which can then be taken out
+/// with view() or str().
+///
+/// The buffer is flushed when it is destroyed. Errors of a file descriptor
+/// can be checked afterwards with error(), but only if flush() is called
+/// explicitly.
+class output_buffer {
+public:
+
+  using callback = std::function<void(const char* data, std::size_t size)>;
+
+  static constexpr std::size_t default_chunk_size = 64 * 1024;
+
+private:
+
+  std::unique_ptr<char[]> buf;
+  std::size_t len = 0;
+  std::size_t cap = 0;
+
+  std::size_t chunk_size;
+
+  std::variant<std::monostate, std::ostream*, int, callback> sink;
+
+  std::error_code last_error;
+
+  void write_to_sink(const char* data, std::size_t size);
+
+  void grow(std::size_t min_capacity);
+
+  /// Make room for at least `size` more bytes, by flushing to the sink or
+  /// by growing the buffer.
+  void make_room(std::size_t size);
+
+  void write_slow(const char* data, std::size_t size);
+
+public:
+
+  /// Create a buffer that keeps everything that is written to it in memory.
+  output_buffer();
+
+  explicit output_buffer(std::ostream& out, std::size_t chunk_size = default_chunk_size);
+
+  /// Create a buffer that writes to `fd`.
+  ///
+  /// The file descriptor is not closed when the buffer is destroyed.
+  explicit output_buffer(int fd, std::size_t chunk_size = default_chunk_size);
+
+  explicit output_buffer(callback fn, std::size_t chunk_size = default_chunk_size);
+
+  output_buffer(const output_buffer& other) = delete;
+  output_buffer& operator=(const output_buffer& other) = delete;
+
+  output_buffer(output_buffer&& other);
+  output_buffer& operator=(output_buffer&& other);
+
+  ~output_buffer();
+
+  /// Whether the contents are handed to a sink rather than kept in memory.
+  bool has_sink() const noexcept {
+    return sink.index() != 0;
+  }
+
+  void write(const char* data, std::size_t size) {
+    if (size == 0) {
+      return;
+    }
+    if (cap - len < size) {
+      write_slow(data, size);
+      return;
+    }
+    std::memcpy(buf.get() + len, data, size);
+    len += size;
+  }
+
+  void write(std::string_view str) {
+    write(str.data(), str.size());
+  }
+
+  void put(char ch) {
+    if (len == cap) {
+      make_room(1);
+    }
+    buf[len++] = ch;
+  }
+
+  /// Write `count` copies of `ch`.
+  void fill(char ch, std::size_t count) {
+    while (count > 0) {
+      if (len == cap) {
+        make_room(1);
+      }
+      auto n = std::min(count, cap - len);
+      std::memset(buf.get() + len, ch, n);
+      len += n;
+      count -= n;
+    }
+  }
+
+  /// Get a pointer to at least `size` bytes at the end of the buffer that
+  /// can be written to directly.
+  ///
+  /// The bytes only become part of the output after calling commit().
+  char* prepare(std::size_t size) {
+    if (cap - len < size) {
+      make_room(size);
+      if (cap - len < size) {
+        grow(len + size);
+      }
+    }
+    return buf.get() + len;
+  }
+
+  /// Add `size` bytes that were written at the pointer returned by
+  /// prepare() to the output.
+  void commit(std::size_t size) noexcept {
+    len += size;
+  }
+
+  /// Hand everything that was buffered to the sink.
+  ///
+  /// Does nothing if there is no sink.
+  void flush();
+
+  /// Get the bytes that were written but not yet flushed.
+  std::string_view view() const noexcept {
+    return std::string_view(buf.get(), len);
+  }
+
+  std::string str() const {
+    return std::string(view());
+  }
+
+  std::size_t size() const noexcept {
+    return len;
+  }
+
+  /// Drop the bytes that were written but not yet flushed.
+  void clear() noexcept {
+    len = 0;
+  }
+
+  /// Get the first error that occurred while writing to a file descriptor.
+  std::error_code error() const noexcept {
+    return last_error;
+  }
+
+};
+
+ZEN_NAMESPACE_END
+
+#endif // of #ifndef ZEN_OUTPUT_BUFFER_HPP
@@ -1,41 +1,185 @@
 #ifndef ZEN_SEQMAP_HPP
 #define ZEN_SEQMAP_HPP
 
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory_resource>
+#include <utility>
 #include <vector>
-#include <list>
 
-#include "zen/hash_index.hpp"
+#include "zen/config.hpp"
 
 ZEN_NAMESPACE_START
 
-template<typename KeyT, typename ValueT>
+/// A map that remembers the order in which its elements were inserted.
+///
+/// The elements are stored next to each other in a single block of memory.
+/// Small maps are searched linearly. A hash index is only built once the map
+/// grows beyond `index_threshold` elements, so that the many small objects
+/// in a typical JSON document don't pay for it.
+///
+/// Like those of a vector, iterators are invalidated when an element is
+/// added.
+///
+/// `HashT` must hash every type of key that the map is searched with the
+/// same way as the equal `KeyT`.
+template<typename KeyT, typename ValueT, typename HashT = std::hash<KeyT>>
 class seq_map {
 public:
 
   using value_type = std::pair<KeyT, ValueT>;
   using reference = value_type&;
   using size_type = std::size_t;
+  using allocator_type = std::pmr::polymorphic_allocator<value_type>;
+
+  static constexpr const size_type index_threshold = 16;
 
 private:
 
-  struct entry {
-    value_type value;
-  };
+  using entries_type = std::pmr::vector<value_type>;
+
+  entries_type entries;
+
+  // An open addressing table that holds the position of each entry plus
+  // one, or zero for an empty slot. It is allocated from the same resource
+  // as the entries and is at most half full.
+  std::uint32_t* slots = nullptr;
+  std::size_t slot_count = 0;
+  unsigned slot_shift = 64;
+
+  std::pmr::memory_resource* resource() const noexcept {
+    return entries.get_allocator().resource();
+  }
+
+  /// Spread the bits of `hash` over the bits that select a slot, so that
+  /// keys of which the hash only differs in its high bits don't collide.
+  std::size_t slot_of(std::size_t hash) const noexcept {
+    return (static_cast<std::uint64_t>(hash) * 0x9E3779B97F4A7C15ull) >> slot_shift;
+  }
+
+  void free_index() noexcept {
+    if (slots != nullptr) {
+      resource()->deallocate(slots, slot_count * sizeof(std::uint32_t), alignof(std::uint32_t));
+      slots = nullptr;
+      slot_count = 0;
+      slot_shift = 64;
+    }
+  }
+
+  void insert_slot(std::size_t hash, size_type position) noexcept {
+    auto i = slot_of(hash);
+    while (slots[i] != 0) {
+      i = (i + 1) & (slot_count - 1);
+    }
+    slots[i] = static_cast<std::uint32_t>(position + 1);
+  }
+
+  void rebuild_index() {
+    free_index();
+    if (entries.size() <= index_threshold) {
+      return;
+    }
+    std::size_t count = 64;
+    unsigned shift = 58;
+    while (count < entries.size() * 2) {
+      count *= 2;
+      --shift;
+    }
+    slots = static_cast<std::uint32_t*>(resource()->allocate(count * sizeof(std::uint32_t), alignof(std::uint32_t)));
+    std::memset(slots, 0, count * sizeof(std::uint32_t));
+    slot_count = count;
+    slot_shift = shift;
+    HashT hasher;
+    for (size_type i = 0; i < entries.size(); ++i) {
+      insert_slot(hasher(entries[i].first), i);
+    }
+  }
 
-  std::list<value_type> entries;
-  hash_index<typename std::list<value_type>::iterator, KeyT> index;
+  template<typename K>
+  typename entries_type::iterator find_linear(const K& key) {
+    for (auto iter = entries.begin(); iter != entries.end(); ++iter) {
+      if (iter->first == key) {
+        return iter;
+      }
+    }
+    return entries.end();
+  }
 
 public:
 
-  using iterator = typename std::list<value_type>::iterator;
-  using const_iterator = typename std::list<value_type>::const_iterator;
+  using iterator = typename entries_type::iterator;
+  using const_iterator = typename entries_type::const_iterator;
+
+  /// Create an empty map that allocates from `resource`.
+  seq_map(std::pmr::memory_resource* resource = std::pmr::get_default_resource()):
+    entries(resource) {}
+
+  seq_map(const seq_map& other):
+    entries(other.entries) {
+      rebuild_index();
+    }
+
+  seq_map(seq_map&& other) noexcept:
+    entries(std::move(other.entries)),
+    slots(std::exchange(other.slots, nullptr)),
+    slot_count(std::exchange(other.slot_count, 0)),
+    slot_shift(std::exchange(other.slot_shift, 64)) {}
 
-  void emplace(const KeyT& key, const ValueT& value) {
-    auto iter = entries.insert(entries.end(), std::make_pair(key, value));
-    index.insert(iter);
+  seq_map& operator=(const seq_map& other) {
+    if (this != &other) {
+      entries = other.entries;
+      rebuild_index();
+    }
+    return *this;
   }
 
-  size_type size() {
+  seq_map& operator=(seq_map&& other) {
+    if (this == &other) {
+      return *this;
+    }
+    free_index();
+    // The elements are only moved over if both maps use the same resource
+    bool same_resource = entries.get_allocator() == other.entries.get_allocator();
+    entries = std::move(other.entries);
+    if (same_resource) {
+      slots = std::exchange(other.slots, nullptr);
+      slot_count = std::exchange(other.slot_count, 0);
+      slot_shift = std::exchange(other.slot_shift, 64);
+    } else {
+      rebuild_index();
+    }
+    return *this;
+  }
+
+  ~seq_map() {
+    free_index();
+  }
+
+  allocator_type get_allocator() const noexcept {
+    return entries.get_allocator();
+  }
+
+  /// Make room for `count` elements, so that adding them allocates
+  /// nothing.
+  void reserve(size_type count) {
+    entries.reserve(count);
+  }
+
+  void emplace(KeyT key, ValueT value) {
+    entries.emplace_back(std::move(key), std::move(value));
+    auto size = entries.size();
+    if (size <= index_threshold) {
+      return;
+    }
+    if (slots == nullptr || size * 2 > slot_count) {
+      rebuild_index();
+    } else {
+      insert_slot(HashT{}(entries.back().first), size - 1);
+    }
+  }
+
+  size_type size() const noexcept {
     return entries.size();
   }
 
@@ -43,12 +187,75 @@ public:
     return entries.empty();
   }
 
-  ValueT& operator[](const KeyT& key) {
-    return *index.lookup(key);
+  /// Find the element with the given key.
+  ///
+  /// Like the other lookup functions, this accepts any type of key that can
+  /// be compared with `KeyT` and is hashed the same way by `HashT`.
+  template<typename K>
+  iterator find(const K& key) {
+    if (slots != nullptr) {
+      return find(key, HashT{}(key));
+    }
+    return find_linear(key);
+  }
+
+  /// Look up `key` using a hash that was computed in advance with `HashT`,
+  /// so that repeated lookups of the same key don't have to hash it again.
+  template<typename K>
+  iterator find(const K& key, std::size_t hash) {
+    if (slots == nullptr) {
+      return find_linear(key);
+    }
+    for (auto i = slot_of(hash);; i = (i + 1) & (slot_count - 1)) {
+      auto slot = slots[i];
+      if (slot == 0) {
+        return entries.end();
+      }
+      if (entries[slot - 1].first == key) {
+        return entries.begin() + (slot - 1);
+      }
+    }
+  }
+
+  template<typename K>
+  const_iterator find(const K& key) const {
+    return const_cast<seq_map*>(this)->find(key);
+  }
+
+  template<typename K>
+  const_iterator find(const K& key, std::size_t hash) const {
+    return const_cast<seq_map*>(this)->find(key, hash);
+  }
+
+  /// Get the value of `key`, which must be present in the map.
+  template<typename K>
+  ValueT& operator[](const K& key) {
+    auto match = find(key);
+    ZEN_ASSERT(match != entries.end());
+    return match->second;
+  }
+
+  template<typename K>
+  const ValueT& operator[](const K& key) const {
+    auto match = find(key);
+    ZEN_ASSERT(match != entries.end());
+    return match->second;
+  }
+
+  iterator begin() {
+    return entries.begin();
+  }
+
+  iterator end() {
+    return entries.end();
+  }
+
+  const_iterator begin() const {
+    return entries.begin();
   }
 
-  const ValueT& operator[](const KeyT& key) const {
-    return *index.lookup(key);
+  const_iterator end() const {
+    return entries.end();
   }
 
   const_iterator cbegin() const {
@@ -0,0 +1,416 @@
+/// \file zen/simd.hpp
+/// \brief Vectorized kernels for scanning text in blocks of 64 bytes.
+///
+/// Scanners that need to find a handful of special characters in a large
+/// buffer spend most of their time looking at bytes that don't matter. The
+/// kernels in this header classify a block of 64 bytes at once and return one
+/// bit per byte, so that the caller can jump straight to the interesting
+/// positions using bit manipulation.
+///
+/// The best implementation for the CPU the program runs on is chosen at
+/// run-time. On platforms without SSE4.2 or AVX2, a portable scalar version is
+/// used that produces exactly the same masks.
+///
+/// ```cpp
+/// auto classify = zen::select_classifier();
+/// zen::block_masks masks;
+/// classify(block, masks);
+/// auto quotes = masks.quote & ~zen::escaped_mask(masks.backslash, carry);
+/// ```
+
+#ifndef ZEN_SIMD_HPP
+#define ZEN_SIMD_HPP
+
+#include <cstdint>
+#include <cstring>
+
+#include "zen/config.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define ZEN_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define ZEN_HAVE_X86_SIMD 0
+#endif
+
+ZEN_NAMESPACE_START
+
+/// The amount of bytes that a single call to a classifier processes.
+static constexpr const std::size_t simd_block_size = 64;
+
+enum class simd_level {
+  scalar,
+  sse42,
+  avx2,
+};
+
+/// The classification of 64 consecutive bytes. Bit `i` of each mask is set
+/// when byte `i` of the block belongs to the given class.
+struct block_masks {
+  std::uint64_t quote;
+  std::uint64_t backslash;
+  /// One of `{`, `}`, `[`, `]`, `:` or `,`
+  std::uint64_t op;
+  /// One of space, tab, carriage return or line feed
+  std::uint64_t whitespace;
+  /// Any byte below 0x20
+  std::uint64_t control;
+  /// One of `{` or `[`
+  std::uint64_t open;
+  /// One of `}` or `]`
+  std::uint64_t close;
+  /// Any byte of 0x80 or above, which is part of a multi-byte UTF-8 sequence
+  std::uint64_t non_ascii;
+};
+
+using classify_fn = void (*)(const unsigned char* block, block_masks& out);
+
+/// Returns a mask of the bytes in a block of 64 bytes that can't appear as-is
+/// inside a JSON string: quotes, backslashes and bytes below 0x20.
+using escape_mask_fn = std::uint64_t (*)(const unsigned char* block);
+
+/// Narrows the code points at the start of `in` that are printable ASCII and
+/// that don't need to be escaped in a JSON string into the bytes at `out`.
+///
+/// Returns how many code points were narrowed, which is at most `size`. The
+/// code point at that position needs special treatment, unless vectorized
+/// implementations stopped early because fewer than 16 code points were left.
+using narrow_ascii_fn = std::size_t (*)(const std::uint32_t* in, std::size_t size, unsigned char* out);
+
+namespace simd_detail {
+
+  enum : unsigned char {
+    quote_class = 1,
+    backslash_class = 2,
+    op_class = 4,
+    whitespace_class = 8,
+    control_class = 16,
+    open_class = 32,
+    close_class = 64,
+  };
+
+  struct class_table {
+    unsigned char entries[256];
+    constexpr class_table(): entries() {
+      for (int i = 0; i < 0x20; ++i) {
+        entries[i] = control_class;
+      }
+      entries['"'] = quote_class;
+      entries['\\'] = backslash_class;
+      entries['{'] = op_class | open_class;
+      entries['}'] = op_class | close_class;
+      entries['['] = op_class | open_class;
+      entries[']'] = op_class | close_class;
+      entries[':'] = op_class;
+      entries[','] = op_class;
+      entries[' '] = whitespace_class;
+      entries['\t'] = whitespace_class | control_class;
+      entries['\n'] = whitespace_class | control_class;
+      entries['\r'] = whitespace_class | control_class;
+    }
+  };
+
+  static constexpr const class_table table {};
+
+}
+
+inline void classify_scalar(const unsigned char* block, block_masks& out) {
+  std::uint64_t quote = 0;
+  std::uint64_t backslash = 0;
+  std::uint64_t op = 0;
+  std::uint64_t whitespace = 0;
+  std::uint64_t control = 0;
+  std::uint64_t open = 0;
+  std::uint64_t close = 0;
+  std::uint64_t non_ascii = 0;
+  for (std::size_t i = 0; i < simd_block_size; ++i) {
+    auto cls = simd_detail::table.entries[block[i]];
+    std::uint64_t bit = std::uint64_t(1) << i;
+    if (cls & simd_detail::quote_class) quote |= bit;
+    if (cls & simd_detail::backslash_class) backslash |= bit;
+    if (cls & simd_detail::op_class) op |= bit;
+    if (cls & simd_detail::whitespace_class) whitespace |= bit;
+    if (cls & simd_detail::control_class) control |= bit;
+    if (cls & simd_detail::open_class) open |= bit;
+    if (cls & simd_detail::close_class) close |= bit;
+    if (block[i] >= 0x80) non_ascii |= bit;
+  }
+  out.quote = quote;
+  out.backslash = backslash;
+  out.op = op;
+  out.whitespace = whitespace;
+  out.control = control;
+  out.open = open;
+  out.close = close;
+  out.non_ascii = non_ascii;
+}
+
+inline bool needs_json_escape(std::uint32_t ch) {
+  return ch < 0x20 || ch == '"' || ch == '\\';
+}
+
+inline std::uint64_t escape_mask_scalar(const unsigned char* block) {
+  std::uint64_t mask = 0;
+  for (std::size_t i = 0; i < simd_block_size; ++i) {
+    if (needs_json_escape(block[i])) {
+      mask |= std::uint64_t(1) << i;
+    }
+  }
+  return mask;
+}
+
+inline std::size_t narrow_ascii_scalar(const std::uint32_t* in, std::size_t size, unsigned char* out) {
+  std::size_t i = 0;
+  for (; i < size && in[i] < 0x80 && !needs_json_escape(in[i]); ++i) {
+    out[i] = static_cast<unsigned char>(in[i]);
+  }
+  return i;
+}
+
+#if ZEN_HAVE_X86_SIMD
+
+__attribute__((target("sse4.2")))
+inline std::uint64_t escape_mask_sse42(const unsigned char* block) {
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+  const __m128i control_limit = _mm_set1_epi8(static_cast<char>(0x20 ^ 0x80));
+  std::uint64_t mask = 0;
+  for (std::size_t i = 0; i < 4; ++i) {
+    auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i * 16));
+    auto special = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+      _mm_cmplt_epi8(_mm_xor_si128(chunk, bias), control_limit)
+    );
+    mask |= std::uint64_t(static_cast<std::uint16_t>(_mm_movemask_epi8(special))) << (i * 16);
+  }
+  return mask;
+}
+
+__attribute__((target("sse4.2")))
+inline std::size_t narrow_ascii_sse42(const std::uint32_t* in, std::size_t size, unsigned char* out) {
+  const __m128i quote = _mm_set1_epi32('"');
+  const __m128i backslash = _mm_set1_epi32('\\');
+  const __m128i low = _mm_set1_epi32(0x20);
+  const __m128i high = _mm_set1_epi32(0x7F);
+  std::size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m128i chunks[4];
+    int bad = 0;
+    for (std::size_t j = 0; j < 4; ++j) {
+      chunks[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + j * 4));
+      // Code points fit in 21 bits, so signed comparisons are fine
+      auto special = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi32(chunks[j], quote), _mm_cmpeq_epi32(chunks[j], backslash)),
+        _mm_or_si128(_mm_cmplt_epi32(chunks[j], low), _mm_cmpgt_epi32(chunks[j], high))
+      );
+      bad |= _mm_movemask_ps(_mm_castsi128_ps(special)) << (j * 4);
+    }
+    auto bytes = _mm_packus_epi16(
+      _mm_packus_epi32(chunks[0], chunks[1]),
+      _mm_packus_epi32(chunks[2], chunks[3])
+    );
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), bytes);
+    if (bad != 0) {
+      return i + __builtin_ctz(bad);
+    }
+  }
+  return i;
+}
+
+__attribute__((target("avx2")))
+inline std::uint64_t escape_mask_avx2(const unsigned char* block) {
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i backslash = _mm256_set1_epi8('\\');
+  const __m256i bias = _mm256_set1_epi8(static_cast<char>(0x80));
+  const __m256i control_limit = _mm256_set1_epi8(static_cast<char>(0x20 ^ 0x80));
+  std::uint64_t mask = 0;
+  for (std::size_t i = 0; i < 2; ++i) {
+    auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i * 32));
+    auto special = _mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, backslash)),
+      _mm256_cmpgt_epi8(control_limit, _mm256_xor_si256(chunk, bias))
+    );
+    mask |= std::uint64_t(static_cast<std::uint32_t>(_mm256_movemask_epi8(special))) << (i * 32);
+  }
+  return mask;
+}
+
+__attribute__((target("sse4.2")))
+inline void classify_sse42(const unsigned char* block, block_masks& out) {
+  const __m128i ops = _mm_setr_epi8('{', '}', '[', ']', ':', ',', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i spaces = _mm_setr_epi8(' ', '\t', '\n', '\r', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i opens = _mm_setr_epi8('{', '[', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i closes = _mm_setr_epi8('}', ']', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  // Signed comparison, so we flip the sign bit to compare as unsigned
+  const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+  const __m128i control_limit = _mm_set1_epi8(static_cast<char>(0x20 ^ 0x80));
+  constexpr const int mode = _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_BIT_MASK;
+  out = {};
+  for (std::size_t i = 0; i < 4; ++i) {
+    auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i * 16));
+    auto shift = i * 16;
+    // Explicit lengths are used so that NUL bytes in the input are
+    // classified like any other byte.
+    out.op |= std::uint64_t(_mm_cvtsi128_si32(_mm_cmpestrm(ops, 6, chunk, 16, mode)) & 0xFFFF) << shift;
+    out.whitespace |= std::uint64_t(_mm_cvtsi128_si32(_mm_cmpestrm(spaces, 4, chunk, 16, mode)) & 0xFFFF) << shift;
+    out.open |= std::uint64_t(_mm_cvtsi128_si32(_mm_cmpestrm(opens, 2, chunk, 16, mode)) & 0xFFFF) << shift;
+    out.close |= std::uint64_t(_mm_cvtsi128_si32(_mm_cmpestrm(closes, 2, chunk, 16, mode)) & 0xFFFF) << shift;
+    out.quote |= std::uint64_t(static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, quote)))) << shift;
+    out.backslash |= std::uint64_t(static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, backslash)))) << shift;
+    auto below = _mm_cmplt_epi8(_mm_xor_si128(chunk, bias), control_limit);
+    out.control |= std::uint64_t(static_cast<std::uint16_t>(_mm_movemask_epi8(below))) << shift;
+    out.non_ascii |= std::uint64_t(static_cast<std::uint16_t>(_mm_movemask_epi8(chunk))) << shift;
+  }
+}
+
+__attribute__((target("avx2")))
+inline std::uint32_t eq_mask_avx2(__m256i chunk, char ch) {
+  return static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(ch))));
+}
+
+__attribute__((target("avx2")))
+inline void classify_avx2(const unsigned char* block, block_masks& out) {
+  const __m256i bias = _mm256_set1_epi8(static_cast<char>(0x80));
+  const __m256i control_limit = _mm256_set1_epi8(static_cast<char>(0x20 ^ 0x80));
+  out = {};
+  for (std::size_t i = 0; i < 2; ++i) {
+    auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i * 32));
+    auto shift = i * 32;
+    std::uint32_t open = eq_mask_avx2(chunk, '{') | eq_mask_avx2(chunk, '[');
+    std::uint32_t close = eq_mask_avx2(chunk, '}') | eq_mask_avx2(chunk, ']');
+    std::uint32_t op = open | close | eq_mask_avx2(chunk, ':') | eq_mask_avx2(chunk, ',');
+    std::uint32_t whitespace = eq_mask_avx2(chunk, ' ') | eq_mask_avx2(chunk, '\t')
+                             | eq_mask_avx2(chunk, '\n') | eq_mask_avx2(chunk, '\r');
+    auto below = _mm256_cmpgt_epi8(control_limit, _mm256_xor_si256(chunk, bias));
+    out.op |= std::uint64_t(op) << shift;
+    out.open |= std::uint64_t(open) << shift;
+    out.close |= std::uint64_t(close) << shift;
+    out.whitespace |= std::uint64_t(whitespace) << shift;
+    out.quote |= std::uint64_t(eq_mask_avx2(chunk, '"')) << shift;
+    out.backslash |= std::uint64_t(eq_mask_avx2(chunk, '\\')) << shift;
+    out.control |= std::uint64_t(static_cast<std::uint32_t>(_mm256_movemask_epi8(below))) << shift;
+    out.non_ascii |= std::uint64_t(static_cast<std::uint32_t>(_mm256_movemask_epi8(chunk))) << shift;
+  }
+}
+
+#endif
+
+/// Determine the most capable instruction set that is supported by the
+/// processor this program is running on.
+inline simd_level detect_simd_level() {
+#if ZEN_HAVE_X86_SIMD
+  static const simd_level level = [] {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      return simd_level::avx2;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+      return simd_level::sse42;
+    }
+    return simd_level::scalar;
+  }();
+  return level;
+#else
+  return simd_level::scalar;
+#endif
+}
+
+inline classify_fn select_classifier(simd_level level = detect_simd_level()) {
+  switch (level) {
+#if ZEN_HAVE_X86_SIMD
+    case simd_level::avx2:
+      return classify_avx2;
+    case simd_level::sse42:
+      return classify_sse42;
+#endif
+    default:
+      return classify_scalar;
+  }
+}
+
+inline escape_mask_fn select_escape_scanner(simd_level level = detect_simd_level()) {
+  switch (level) {
+#if ZEN_HAVE_X86_SIMD
+    case simd_level::avx2:
+      return escape_mask_avx2;
+    case simd_level::sse42:
+      return escape_mask_sse42;
+#endif
+    default:
+      return escape_mask_scalar;
+  }
+}
+
+/// There is no AVX2 version, because code points are narrowed 16 at a time,
+/// which is what fits in a single SSE register.
+inline narrow_ascii_fn select_ascii_narrower(simd_level level = detect_simd_level()) {
+  switch (level) {
+#if ZEN_HAVE_X86_SIMD
+    case simd_level::avx2:
+    case simd_level::sse42:
+      return narrow_ascii_sse42;
+#endif
+    default:
+      return narrow_ascii_scalar;
+  }
+}
+
+/// Computes for each bit the parity of all set bits at and below it.
+///
+/// Applied to a mask of quote characters, this yields a mask of the bytes that
+/// are inside a string, including the opening quote and excluding the closing
+/// quote.
+inline std::uint64_t prefix_xor(std::uint64_t bits) {
+  bits ^= bits << 1;
+  bits ^= bits << 2;
+  bits ^= bits << 4;
+  bits ^= bits << 8;
+  bits ^= bits << 16;
+  bits ^= bits << 32;
+  return bits;
+}
+
+/// Returns a mask of all bytes that are escaped by a backslash, given a mask of
+/// the backslashes in the block.
+///
+/// An odd-length run of backslashes escapes the byte that follows it. `carry`
+/// must be zero for the first block. It is updated to tell the next call
+/// whether its first byte is escaped.
+inline std::uint64_t escaped_mask(std::uint64_t backslash, std::uint64_t& carry) {
+  constexpr const std::uint64_t even_bits = 0x5555555555555555ULL;
+  backslash &= ~carry;
+  std::uint64_t follows_escape = (backslash << 1) | carry;
+  std::uint64_t odd_starts = backslash & ~even_bits & ~follows_escape;
+  std::uint64_t even_ends = odd_starts + backslash;
+  carry = even_ends < odd_starts;
+  std::uint64_t invert = even_ends << 1;
+  return (even_bits ^ invert) & follows_escape;
+}
+
+/// Load a possibly incomplete block into `out`, padding it with `fill`.
+inline const unsigned char* load_partial_block(
+  const unsigned char* data,
+  std::size_t size,
+  unsigned char* out,
+  unsigned char fill = ' '
+) {
+  std::memset(out, fill, simd_block_size);
+  std::memcpy(out, data, size);
+  return out;
+}
+
+inline unsigned count_trailing_zeros(std::uint64_t bits) {
+  ZEN_ASSERT(bits != 0);
+  return __builtin_ctzll(bits);
+}
+
+inline unsigned count_ones(std::uint64_t bits) {
+  return __builtin_popcountll(bits);
+}
+
+ZEN_NAMESPACE_END
+
+#endif // of #ifndef ZEN_SIMD_HPP
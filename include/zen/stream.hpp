@@ -93,10 +93,14 @@ namespace zen {
     }
 
     result<maybe<value_type>> peek(std::size_t offset = 1) override {
-      if (current == end) {
+      auto iter = current;
+      for (std::size_t i = 1; i < offset && iter != end; ++i) {
+        ++iter;
+      }
+      if (iter == end) {
         return right(std::nullopt);
       }
-      return right(*current);
+      return right(*iter);
     }
 
   };
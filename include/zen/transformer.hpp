@@ -27,6 +27,23 @@ struct has_transform_method<T,
 template<typename T>
 static constexpr const bool has_transform_method_v = has_transform_method<T>::value;
 
+/// Whether `T` has a `transform_fields()` method that accepts a
+/// `TransformerT&`.
+///
+/// When `transform_fields()` is a template, a transformer that is known at
+/// compile time can be passed to it directly, so that every field is
+/// transformed without going through a virtual call.
+template<typename T, typename TransformerT, typename = void>
+struct has_transform_fields_method : std::false_type {};
+
+template<typename T, typename TransformerT>
+struct has_transform_fields_method<T, TransformerT,
+    std::void_t<decltype(std::declval<T&>().transform_fields(std::declval<TransformerT&>()))>
+    > : std::true_type { };
+
+template<typename T, typename TransformerT>
+static constexpr const bool has_transform_fields_method_v = has_transform_fields_method<T, TransformerT>::value;
+
 class transformer {
 public:
 
@@ -60,6 +77,26 @@ public:
   virtual void end_transform_element() = 0;
   virtual void end_transform_sequence() = 0;
 
+  /// Whether values are about to be filled in from some input instead of
+  /// being written out.
+  ///
+  /// A decoder has to create the contents of optionals, pointers and
+  /// containers itself, so the transformations of these types ask it with
+  /// has_value() and has_element() what the input holds. Decoders return
+  /// false while they skip over something that is missing from the input,
+  /// so that the value is left as it is.
+  virtual bool is_decoding() { return false; }
+
+  /// Whether the input holds something other than nil at this point.
+  ///
+  /// Only called when is_decoding() returns true.
+  virtual bool has_value() { return false; }
+
+  /// Whether the current sequence in the input has another element.
+  ///
+  /// Only called when is_decoding() returns true.
+  virtual bool has_element() { return false; }
+
   template<typename T>
   void transform(std::optional<T>& value);
 
@@ -95,8 +132,11 @@ public:
   object_transformer(class transformer& transformer):
     parent(transformer) {}
 
+  /// Transform the field `name` of the object.
+  ///
+  /// `value` is passed on by reference, so that decoders can assign to it.
   template<typename T>
-  void transform_field(std::string name, T value) {
+  void transform_field(const std::string& name, T&& value) {
     parent.start_transform_field(name);
     parent.transform(value);
     parent.end_transform_field();
@@ -138,7 +178,7 @@ public:
     parent(transformer)  {}
 
   template<typename T>
-  void transform(T value) {
+  void transform(T&& value) {
     parent.start_transform_element();
     parent.transform(value);
     parent.end_transform_element();
@@ -170,10 +210,20 @@ inline sequence_transformer transformer::transform_sequence(std::size_t size) {
 template<typename T>
 void transformer::transform(std::optional<T>& value) {
   start_transform_optional();
-  if (value.has_value()) {
-    transform_nil();
-  } else {
+  if (is_decoding()) {
+    if (has_value()) {
+      if (!value.has_value()) {
+        value.emplace();
+      }
+      transform(*value);
+    } else {
+      value.reset();
+      transform_nil();
+    }
+  } else if (value.has_value()) {
     transform(*value);
+  } else {
+    transform_nil();
   }
   end_transform_optional();
 }
@@ -192,9 +242,23 @@ void transformer::transform(std::pair<T1, T2>& value) {
 
 template<typename T>
 std::enable_if_t<meta::is_container_v<T>> transformer::transform(T& value) {
+  // Only containers that can be appended to can be decoded
+  if constexpr (meta::has_emplace_back_v<T>) {
+    if (is_decoding()) {
+      start_transform_sequence();
+      value.clear();
+      while (has_element()) {
+        start_transform_element();
+        transform(value.emplace_back());
+        end_transform_element();
+      }
+      end_transform_sequence();
+      return;
+    }
+  }
   start_transform_sequence();
   transform_size(value.size());
-  for (const auto& element: value) {
+  for (auto& element: value) {
     start_transform_element();
     transform(element);
     end_transform_element();
@@ -204,6 +268,24 @@ std::enable_if_t<meta::is_container_v<T>> transformer::transform(T& value) {
 
 template<typename T>
 std::enable_if_t<meta::is_pointer_v<T>> transformer::transform(T& value) {
+  // Decoders can only allocate the value of smart pointers, because raw
+  // pointers don't say who owns them
+  if constexpr (!std::is_pointer_v<T>) {
+    if (is_decoding()) {
+      start_transform_optional();
+      if (!has_value()) {
+        value = nullptr;
+        transform_nil();
+      } else {
+        if (value == nullptr) {
+          value = T(new std::remove_reference_t<decltype(*value)>());
+        }
+        transform(*value);
+      }
+      end_transform_optional();
+      return;
+    }
+  }
   start_transform_optional();
   if (value == nullptr) {
     transform_nil();
@@ -1,11 +1,13 @@
 #ifndef ZEN_UNICODE_HPP
 #define ZEN_UNICODE_HPP
 
+#include <cstddef>
 #include <cstdint>
-#include <istream>
+#include <iterator>
+#include <string>
+#include <string_view>
 
 #include "zen/error.hpp"
-#include "zen/json.hpp"
 #include "zen/stream.hpp"
 
 namespace zen {
@@ -15,6 +17,76 @@ namespace zen {
 
   static constexpr const unicode_char eof = 0xFFFF;
 
+  /// What next_utf8_char() returns for bytes that are not valid UTF-8.
+  static constexpr const unicode_char invalid_utf8_char = 0xFFFFFFFF;
+
+  /// U+FFFD REPLACEMENT CHARACTER, which stands in for bytes that are not
+  /// valid UTF-8.
+  static constexpr const unicode_char replacement_char = 0xFFFD;
+
+  /// Decode the UTF-8 sequence that starts at `curr`, which must not be
+  /// `end`, and move `curr` past it.
+  ///
+  /// Overlong encodings, surrogates and code points beyond U+10FFFF are not
+  /// valid. For those and for sequences that are cut short, this returns
+  /// invalid_utf8_char and skips the longest part that could have started a
+  /// valid sequence, which is at least one byte.
+  inline unicode_char next_utf8_char(const unsigned char*& curr, const unsigned char* end) noexcept {
+    unicode_char ch = *curr++;
+    if (ch < 0x80) {
+      return ch;
+    }
+    // Only the first continuation byte has a restricted range
+    unsigned char min = 0x80;
+    unsigned char max = 0xBF;
+    std::size_t trailing;
+    if (ch >= 0xC2 && ch <= 0xDF) {
+      trailing = 1;
+      ch &= 0x1F;
+    } else if (ch >= 0xE0 && ch <= 0xEF) {
+      trailing = 2;
+      if (ch == 0xE0) {
+        min = 0xA0;
+      } else if (ch == 0xED) {
+        max = 0x9F;
+      }
+      ch &= 0x0F;
+    } else if (ch >= 0xF0 && ch <= 0xF4) {
+      trailing = 3;
+      if (ch == 0xF0) {
+        min = 0x90;
+      } else if (ch == 0xF4) {
+        max = 0x8F;
+      }
+      ch &= 0x07;
+    } else {
+      return invalid_utf8_char;
+    }
+    for (std::size_t i = 0; i < trailing; ++i) {
+      if (curr == end || *curr < min || *curr > max) {
+        return invalid_utf8_char;
+      }
+      ch = (ch << 6) | (*curr++ & 0x3F);
+      min = 0x80;
+      max = 0xBF;
+    }
+    return ch;
+  }
+
+  /// Whether `text` is valid UTF-8, following the rules of next_utf8_char().
+  inline bool is_valid_utf8(std::string_view text) noexcept {
+    auto curr = reinterpret_cast<const unsigned char*>(text.data());
+    auto end = curr + text.size();
+    while (curr != end) {
+      if (*curr < 0x80) {
+        ++curr;
+      } else if (next_utf8_char(curr, end) == invalid_utf8_char) {
+        return false;
+      }
+    }
+    return true;
+  }
+
   class utf8_stream : public buffered_stream<unicode_char> {
 
     stream<unsigned char>& parent;
@@ -27,6 +99,91 @@ namespace zen {
 
   };
 
+  /// The code points of a UTF-8 string, which are decoded one at a time
+  /// while iterating over them.
+  ///
+  /// Byte sequences that are not valid UTF-8 come out as U+FFFD REPLACEMENT
+  /// CHARACTER, as decided by next_utf8_char().
+  ///
+  /// ```cpp
+  /// for (auto ch: zen::utf8_code_points(text)) {
+  ///   // ...
+  /// }
+  /// ```
+  class utf8_code_points {
+
+    std::string_view text;
+
+  public:
+
+    class iterator {
+
+      const unsigned char* curr = nullptr;
+      const unsigned char* end = nullptr;
+      unicode_char ch = 0;
+      bool done = true;
+
+      void advance() {
+        if (curr == end) {
+          done = true;
+          return;
+        }
+        ch = next_utf8_char(curr, end);
+        if (ch == invalid_utf8_char) {
+          ch = replacement_char;
+        }
+      }
+
+    public:
+
+      using iterator_category = std::input_iterator_tag;
+      using value_type = unicode_char;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const unicode_char*;
+      using reference = const unicode_char&;
+
+      iterator(const unsigned char* begin, const unsigned char* end):
+        curr(begin), end(end), done(false) {
+          advance();
+        }
+
+      iterator() = default;
+
+      const unicode_char& operator*() const noexcept {
+        return ch;
+      }
+
+      iterator& operator++() {
+        advance();
+        return *this;
+      }
+
+      /// Only tells whether both iterators are at the end, which is all
+      /// that is needed to loop over the code points.
+      bool operator==(const iterator& other) const noexcept {
+        return done == other.done;
+      }
+
+      bool operator!=(const iterator& other) const noexcept {
+        return done != other.done;
+      }
+
+    };
+
+    utf8_code_points(std::string_view text):
+      text(text) {}
+
+    iterator begin() const {
+      auto data = reinterpret_cast<const unsigned char*>(text.data());
+      return iterator(data, data + text.size());
+    }
+
+    iterator end() const {
+      return iterator();
+    }
+
+  };
+
   unicode_string operator ""_utf8(const char* data, std::size_t sz);
 
 }
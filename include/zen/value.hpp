@@ -1,11 +1,15 @@
 #ifndef ZEN_VALUE_HPP
 #define ZEN_VALUE_HPP
 
-#include <vector>
+#include <cstdint>
 #include <memory>
+#include <memory_resource>
+#include <new>
+#include <vector>
 
 #include "zen/clone_ptr.hpp"
 #include "zen/config.hpp"
+#include "zen/object_key.hpp"
 #include "zen/string.hpp"
 #include "zen/seq_map.hpp"
 
@@ -15,7 +19,7 @@ using bigint = long long;
 
 using fractional = double;
 
-enum class value_type {
+enum class value_type : std::uint8_t {
   array,
   boolean,
   string,
@@ -23,6 +27,7 @@ enum class value_type {
   integer,
   fractional,
   object,
+  utf8_string,
 };
 
 class value;
@@ -30,178 +35,202 @@ class value;
 class null {};
 
 
+/// A JSON value.
+///
+/// A value takes up 16 bytes: 8 bytes of payload and the type. Booleans and
+/// numbers are stored inline. Strings, arrays and objects live in a box that
+/// is allocated from the same memory resource as their contents, so that
+/// values that are parsed into an arena don't touch the heap at all, and so
+/// that an array of values stays dense.
+///
+/// Strings are either a zen::string of code points or, when a document is
+/// parsed with string_storage::utf8, a zen::utf8_string. is_string() and
+/// as_string() only apply to the former.
 class value {
 public:
 
-  using array = std::vector<value>;
-  using object = seq_map<string, value>;
+  // Containers use polymorphic allocators so that an entire document can be
+  // allocated from a single arena. Copies always use the default resource.
+  using array = std::pmr::vector<value>;
+  using object = seq_map<object_key, value, object_key_hash>;
 
 private:
 
-  value_type type;
-
   union {
     bool b;
     bigint i;
     fractional f;
-    string s;
-    array a;
-    object o;
+    string* s;
+    array* a;
+    object* o;
+    utf8_string* u;
   };
 
-public:
-
-  value():
-    type(value_type::null) {}
-
-  value(null):
-    type(value_type::null) {}
-
-  value(bool b):
-    type(value_type::boolean), b(b) {}
-
-  value(bigint i):
-    type(value_type::integer), i(i) {}
-
-  value(fractional f):
-    type(value_type::fractional), f(f) {}
+  value_type type;
 
-  value(object o):
-    type(value_type::object), o(o) {}
+  /// Move `contents` into a box that is allocated from the resource it
+  /// uses itself.
+  template<typename T>
+  static T* box(T&& contents) {
+    auto resource = contents.get_allocator().resource();
+    auto memory = resource->allocate(sizeof(T), alignof(T));
+    return new (memory) T(std::move(contents));
+  }
 
-  value(array value):
-    type(value_type::array) {
-      new (&a) array(value);
+  /// Copy `contents` into a box on the default resource.
+  template<typename T>
+  static T* box_copy(const T& contents) {
+    auto resource = std::pmr::get_default_resource();
+    auto memory = resource->allocate(sizeof(T), alignof(T));
+    try {
+      return new (memory) T(contents);
+    } catch (...) {
+      resource->deallocate(memory, sizeof(T), alignof(T));
+      throw;
     }
+  }
 
-  value(string s):
-    type(value_type::string), s(s) { }
+  template<typename T>
+  static void unbox(T* contents) noexcept {
+    auto resource = contents->get_allocator().resource();
+    contents->~T();
+    resource->deallocate(contents, sizeof(T), alignof(T));
+  }
 
-  value(const value& other): type(other.type) {
+  void copy_from(const value& other) {
     switch (other.type) {
       case value_type::array:
-        new (&a) array(other.a);
+        a = box_copy(*other.a);
         break;
       case value_type::object:
-        new (&o) object(other.o);
+        o = box_copy(*other.o);
+        break;
+      case value_type::string:
+        s = box_copy(*other.s);
+        break;
+      case value_type::utf8_string:
+        u = box_copy(*other.u);
         break;
       case value_type::integer:
-        new (&i) bigint(other.i);
+        i = other.i;
+        break;
+      case value_type::fractional:
+        f = other.f;
         break;
       case value_type::boolean:
         b = other.b;
         break;
       case value_type::null:
         break;
-      case value_type::string:
-        new (&s) string(other.s);
-        break;
-      case value_type::fractional:
-        new (&f) fractional(other.f);
-        break;
     }
+    type = other.type;
   }
 
-  value(value&& other): type(std::move(other.type)) {
+  /// Take over the contents of `other`, leaving it null. Boxed containers
+  /// are simply handed over.
+  void steal(value& other) noexcept {
     switch (other.type) {
       case value_type::array:
-        new (&a) array(std::move(other.a));
+        a = other.a;
         break;
       case value_type::object:
-        new (&o) object(std::move(other.o));
+        o = other.o;
+        break;
+      case value_type::string:
+        s = other.s;
+        break;
+      case value_type::utf8_string:
+        u = other.u;
         break;
       case value_type::integer:
-        new (&i) bigint(std::move(other.i));
+        i = other.i;
+        break;
+      case value_type::fractional:
+        f = other.f;
         break;
       case value_type::boolean:
         b = other.b;
         break;
       case value_type::null:
         break;
-      case value_type::string:
-        new (&s) string(std::move(other.s));
-        break;
-      case value_type::fractional:
-        new (&f) fractional(std::move(other.f));
-        break;
     }
+    type = other.type;
     other.type = value_type::null;
   }
 
+public:
+
+  value():
+    type(value_type::null) {}
+
+  value(null):
+    type(value_type::null) {}
+
+  value(bool b):
+    b(b), type(value_type::boolean) {}
+
+  value(bigint i):
+    i(i), type(value_type::integer) {}
+
+  value(fractional f):
+    f(f), type(value_type::fractional) {}
+
+  value(object o):
+    o(box(std::move(o))), type(value_type::object) {}
+
+  value(array value):
+    a(box(std::move(value))), type(value_type::array) {}
+
+  value(string s):
+    s(box(std::move(s))), type(value_type::string) {}
+
+  value(utf8_string u):
+    u(box(std::move(u))), type(value_type::utf8_string) {}
+
+  value(const value& other) {
+    copy_from(other);
+  }
+
+  value(value&& other) noexcept {
+    steal(other);
+  }
+
   value& operator=(const value& other) {
-    type = other.type;
-    switch (other.type) {
-      case value_type::array:
-        new (&a) array(other.a);
-        break;
-      case value_type::object:
-        new (&o) object(other.o);
-        break;
-      case value_type::integer:
-        new (&i) bigint(other.i);
-        break;
-      case value_type::boolean:
-        b = other.b;
-        break;
-      case value_type::null:
-        break;
-      case value_type::string:
-        new (&s) string(other.s);
-        break;
-      case value_type::fractional:
-        new (&f) fractional(other.f);
-        break;
+    if (this == &other) {
+      return *this;
     }
+    value copy(other);
+    this->~value();
+    steal(copy);
     return *this;
   }
 
-  value& operator=(value&& other) {
-    type = std::move(other.type);
-    switch (other.type) {
-      case value_type::array:
-        new (&a) array(std::move(other.a));
-        break;
-      case value_type::object:
-        new (&o) object(std::move(other.o));
-        break;
-      case value_type::integer:
-        new (&i) bigint(std::move(other.i));
-        break;
-      case value_type::boolean:
-        b = other.b;
-        break;
-      case value_type::null:
-        break;
-      case value_type::string:
-        new (&s) string(std::move(other.s));
-        break;
-      case value_type::fractional:
-        new (&f) fractional(std::move(other.f));
-        break;
+  value& operator=(value&& other) noexcept {
+    if (this == &other) {
+      return *this;
     }
-    other.type = value_type::null;
+    this->~value();
+    steal(other);
     return *this;
   }
 
   inline ~value() {
     switch (type) {
       case value_type::string:
-        s.~string();
+        unbox(s);
         break;
-      case value_type::fractional:
-        f.~fractional();
+      case value_type::utf8_string:
+        unbox(u);
         break;
       case value_type::array:
-        a.~array();
+        unbox(a);
         break;
       case value_type::object:
-        o.~object();
+        unbox(o);
         break;
+      case value_type::fractional:
       case value_type::boolean:
-        break;
       case value_type::integer:
-        i.~bigint();
-        break;
       case value_type::null:
         break;
     }
@@ -223,12 +252,22 @@ public:
 
   inline string& as_string() {
     ZEN_ASSERT(type == value_type::string);
-    return s;
+    return *s;
   }
 
   inline const string& as_string() const {
     ZEN_ASSERT(type == value_type::string);
-    return s;
+    return *s;
+  }
+
+  inline utf8_string& as_utf8_string() {
+    ZEN_ASSERT(type == value_type::utf8_string);
+    return *u;
+  }
+
+  inline const utf8_string& as_utf8_string() const {
+    ZEN_ASSERT(type == value_type::utf8_string);
+    return *u;
   }
 
   inline bigint& as_integer() {
@@ -253,22 +292,22 @@ public:
 
   inline array& as_array() {
     ZEN_ASSERT(type == value_type::array);
-    return a;
+    return *a;
   }
 
   inline const array& as_array() const {
     ZEN_ASSERT(type == value_type::array);
-    return a;
+    return *a;
   }
 
   inline object& as_object() {
     ZEN_ASSERT(type == value_type::object);
-    return o;
+    return *o;
   }
 
   inline const object& as_object() const {
     ZEN_ASSERT(type == value_type::object);
-    return o;
+    return *o;
   }
 
   inline bool is_true() const noexcept {
@@ -299,6 +338,10 @@ public:
     return type == value_type::string;
   }
 
+  inline bool is_utf8_string() const noexcept {
+    return type == value_type::utf8_string;
+  }
+
   inline bool is_object() const noexcept {
     return type == value_type::object;
   }
@@ -312,6 +355,8 @@ public:
 using array = value::array;
 using object = value::object;
 
+static_assert(sizeof(void*) != 8 || sizeof(value) == 16, "a value should fit in 16 bytes");
+
 ZEN_NAMESPACE_END
 
 #endif // of #ifndef ZEN_VALUE_HPP
@@ -0,0 +1,122 @@
+
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ZEN_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define ZEN_HAVE_MMAP 0
+#endif
+
+#include "zen/fs/io.hpp"
+
+ZEN_NAMESPACE_START
+
+namespace fs {
+
+static std::error_code last_error() {
+  return std::error_code(errno, std::generic_category());
+}
+
+void mapped_file::release() noexcept {
+  if (ptr == nullptr) {
+    return;
+  }
+  if (owned) {
+    free(const_cast<char*>(ptr));
+  } else {
+#if ZEN_HAVE_MMAP
+    munmap(const_cast<char*>(ptr), sz);
+#endif
+  }
+  ptr = nullptr;
+  sz = 0;
+}
+
+#if ZEN_HAVE_MMAP
+
+either<std::error_code, mapped_file> map_file(const path& filename) {
+
+  auto fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return left(last_error());
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) < 0) {
+    auto error = last_error();
+    close(fd);
+    return left(error);
+  }
+
+  if (!S_ISREG(info.st_mode)) {
+    close(fd);
+    return left(std::make_error_code(std::errc::invalid_argument));
+  }
+
+  auto size = static_cast<std::size_t>(info.st_size);
+
+  // mmap() refuses to create an empty mapping
+  if (size == 0) {
+    close(fd);
+    return right(mapped_file());
+  }
+
+  auto addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  auto error = last_error();
+
+  // The mapping keeps its own reference to the file
+  close(fd);
+
+  if (addr == MAP_FAILED) {
+    return left(error);
+  }
+
+  // Only a hint, so failure is not an error
+  madvise(addr, size, MADV_SEQUENTIAL);
+
+  return right(mapped_file(static_cast<const char*>(addr), size, false));
+}
+
+#else
+
+either<std::error_code, mapped_file> map_file(const path& filename) {
+  std::ifstream in(filename, std::ios::binary | std::ios::ate);
+  if (!in) {
+    return left(std::make_error_code(std::errc::no_such_file_or_directory));
+  }
+  auto size = static_cast<std::size_t>(in.tellg());
+  if (size == 0) {
+    return right(mapped_file());
+  }
+  auto buffer = static_cast<char*>(malloc(size));
+  if (buffer == nullptr) {
+    return left(std::make_error_code(std::errc::not_enough_memory));
+  }
+  in.seekg(0);
+  if (!in.read(buffer, size)) {
+    free(buffer);
+    return left(std::make_error_code(std::errc::io_error));
+  }
+  return right(mapped_file(buffer, size, true));
+}
+
+#endif
+
+either<std::error_code, bytestring> read_file(const path& filename) {
+  auto mapped = map_file(filename);
+  if (mapped.is_left()) {
+    return left(mapped.left());
+  }
+  auto& file = mapped.right();
+  return right(bytestring(file.data(), file.size()));
+}
+
+}
+
+ZEN_NAMESPACE_END
@@ -1,719 +1,737 @@
 
+#include <algorithm>
+#include <charconv>
 #include <cstdlib>
+#include <cstring>
+#include <iterator>
 #include <memory>
 #include <sstream>
 #include <cmath>
 #include <stack>
+#include <vector>
 #include <variant>
 
 #include "zen/char.hpp"
 #include "zen/config.hpp"
 #include "zen/transformer.hpp"
 #include "zen/json.hpp"
+#include "zen/json_encoder.hpp"
+#include "zen/json_parallel.hpp"
 #include "zen/stream.hpp"
 #include "zen/either.hpp"
+#include "zen/fs/io.hpp"
+#include "zen/integer_format.hpp"
+#include "zen/output_buffer.hpp"
+#include "zen/simd.hpp"
 #include "zen/value.hpp"
 
+#include "json_tokenizer.hpp"
+
 ZEN_NAMESPACE_START
 
-static void print_json_string(const string& str, std::ostream& out) {
-  out << '"';
-  for (auto ch: str) {
-    // FIXME This should be UTF-8-encoded
-    out << ch;
+using namespace json_detail;
+
+// Enough for the shortest representation of any double, such as
+// -2.2250738585072014e-308, and a `.0` suffix
+static constexpr std::size_t max_double_length = 32;
+
+template<typename T>
+static void write_floating(output_buffer& out, T value) {
+  if (!std::isfinite(value)) {
+    out.write("null");
+    return;
   }
-  out << '"';
+  auto ptr = out.prepare(max_double_length);
+  auto result = std::to_chars(ptr, ptr + max_double_length - 2, value);
+  std::size_t n = result.ptr - ptr;
+  if (std::memchr(ptr, '.', n) == nullptr && std::memchr(ptr, 'e', n) == nullptr) {
+    ptr[n++] = '.';
+    ptr[n++] = '0';
+  }
+  out.commit(n);
 }
 
-static void print_impl(const value &v, std::ostream& out, int indent) {
+void json_detail::write_fractional(output_buffer& out, float value) {
+  write_floating(out, value);
+}
 
-  switch (v.get_type()) {
+void json_detail::write_fractional(output_buffer& out, double value) {
+  write_floating(out, value);
+}
 
-    case value_type::array:
+/// Writes the escape sequence of a character that can't appear as-is inside
+/// a JSON string.
+static void write_escape(output_buffer& out, unsigned char ch) {
+  static const char hex_digits[] = "0123456789abcdef";
+  switch (ch) {
+    case '"': out.write("\\\"", 2); break;
+    case '\\': out.write("\\\\", 2); break;
+    case '\b': out.write("\\b", 2); break;
+    case '\f': out.write("\\f", 2); break;
+    case '\n': out.write("\\n", 2); break;
+    case '\r': out.write("\\r", 2); break;
+    case '\t': out.write("\\t", 2); break;
+    default:
     {
-      auto array = v.as_array();
-      if (array.empty()) {
-        out << "[]";
-        break;
-      }
-      out << "[\n";
-      auto curr = array.cbegin();
-      auto end = array.cend();
-      if (curr != end) {
-        auto new_indent = indent + 2;
-        out << std::string(indent + 2, ' ');
-        print_impl(*curr, out, new_indent);
-        curr++;
-        for (; curr != end; curr++) {
-          out << ",\n" << std::string(indent + 2, ' ');
-          print_impl(*curr, out, indent + 2);
-        }
-      }
-      out << "\n" << std::string(indent, ' ') << "]";
-      break;
+      const char escape[] = { '\\', 'u', '0', '0', hex_digits[ch >> 4], hex_digits[ch & 0xF] };
+      out.write(escape, sizeof(escape));
     }
+  }
+}
 
-    case value_type::boolean:
-      out << (v.is_true() ? "true" : "false");
-      break;
+// Strings shorter than this are not worth loading into a vector register
+static constexpr std::ptrdiff_t short_string_size = 16;
 
-    case value_type::string:
-      print_json_string(v.as_string(), out);
-      break;
+void write_json_string(output_buffer& out, std::string_view str) {
 
-    case value_type::null:
-      out << "null";
-      break;
+  static const auto scan = select_escape_scanner();
 
-    case value_type::fractional:
-      out << v.as_fractional();
-      break;
+  out.put('"');
 
-    case value_type::integer:
-      out << v.as_integer();
-      break;
+  auto base = reinterpret_cast<const unsigned char*>(str.data());
+  auto end = base + str.size();
 
-    case value_type::object:
-    {
-      auto object = v.as_object();
-      if (object.empty()) {
-        out << "{}";
-        break;
-      }
-      out << "{\n";
-      auto curr = object.cbegin();
-      auto end = object.cend();
-      if (curr != end) {
-        auto new_indent = indent + 2;
-        out << std::string(new_indent, ' ');
-        print_json_string(curr->first, out);
-        out << ": ";
-        print_impl(curr->second, out, new_indent);
-        curr++;
-        for (; curr != end; curr++) {
-          out << ",\n" << std::string(new_indent, ' ');
-          print_json_string(curr->first, out);
-          out << ": ";
-          print_impl(curr->second, out, new_indent);
-        }
+  if (end - base < short_string_size) {
+    auto start = base;
+    for (auto curr = base; curr != end; ++curr) {
+      if (needs_json_escape(*curr)) {
+        out.write(reinterpret_cast<const char*>(start), curr - start);
+        write_escape(out, *curr);
+        start = curr + 1;
       }
-      out << "\n" << std::string(indent, ' ') << "}";
-      break;
     }
-
+    out.write(reinterpret_cast<const char*>(start), end - start);
+    out.put('"');
+    return;
+  }
+
+  unsigned char tail[simd_block_size];
+
+  while (base < end) {
+    auto size = std::min(static_cast<std::size_t>(end - base), simd_block_size);
+    // Spaces don't need to be escaped, so the padding doesn't show up
+    auto block = size == simd_block_size
+      ? base
+      : load_partial_block(base, size, tail);
+    auto special = scan(block);
+    std::size_t start = 0;
+    while (special) {
+      auto i = count_trailing_zeros(special);
+      special &= special - 1;
+      out.write(reinterpret_cast<const char*>(base + start), i - start);
+      write_escape(out, base[i]);
+      start = i + 1;
+    }
+    out.write(reinterpret_cast<const char*>(base + start), size - start);
+    base += size;
   }
 
+  out.put('"');
 }
 
-void print(const value &v, std::ostream& out) {
-  print_impl(v, out, 0);
+/// Writes a code point that isn't printable ASCII, escaping it if needed.
+static void write_code_point(output_buffer& out, std::uint32_t ch) {
+  if (ch < 0x80) {
+    write_escape(out, ch);
+    return;
+  }
+  auto ptr = out.prepare(6);
+  std::size_t n;
+  if (ch < 0x800) {
+    ptr[0] = static_cast<char>(0xC0 | (ch >> 6));
+    ptr[1] = static_cast<char>(0x80 | (ch & 0x3F));
+    n = 2;
+  } else if (ch >= 0xD800 && ch < 0xE000) {
+    // A lone surrogate can't be encoded in UTF-8, but can be escaped
+    static const char hex_digits[] = "0123456789abcdef";
+    ptr[0] = '\\';
+    ptr[1] = 'u';
+    ptr[2] = hex_digits[ch >> 12];
+    ptr[3] = hex_digits[(ch >> 8) & 0xF];
+    ptr[4] = hex_digits[(ch >> 4) & 0xF];
+    ptr[5] = hex_digits[ch & 0xF];
+    n = 6;
+  } else if (ch < 0x10000) {
+    ptr[0] = static_cast<char>(0xE0 | (ch >> 12));
+    ptr[1] = static_cast<char>(0x80 | ((ch >> 6) & 0x3F));
+    ptr[2] = static_cast<char>(0x80 | (ch & 0x3F));
+    n = 3;
+  } else if (ch < 0x110000) {
+    ptr[0] = static_cast<char>(0xF0 | (ch >> 18));
+    ptr[1] = static_cast<char>(0x80 | ((ch >> 12) & 0x3F));
+    ptr[2] = static_cast<char>(0x80 | ((ch >> 6) & 0x3F));
+    ptr[3] = static_cast<char>(0x80 | (ch & 0x3F));
+    n = 4;
+  } else {
+    // Not a code point, so write U+FFFD REPLACEMENT CHARACTER
+    ptr[0] = static_cast<char>(0xEF);
+    ptr[1] = static_cast<char>(0xBF);
+    ptr[2] = static_cast<char>(0xBD);
+    n = 3;
+  }
+  out.commit(n);
 }
 
-std::string to_string(const value& v) {
-  std::ostringstream ss;
-  print(v, ss);
-  return ss.str();
-}
+// How many code points are narrowed into the output buffer at once
+static constexpr std::size_t max_narrow_size = 4096;
 
-std::string escape_char(char ch) {
-  switch (ch) {
-    case '\"': return "\\\"";
-    case '\\': return "\\\\";
-    // case '/': return "\/";
-    case '\b': return "\\b";
-    case '\f': return "\\f";
-    case '\n': return "\\n";
-    case '\r': return "\\r";
-    case '\t': return "\\t";
-    default: return std::string { ch };
-  }
-}
+void write_json_string(output_buffer& out, code_point_view str) {
 
-class json_encoder : public transformer {
+  static const auto narrow = select_ascii_narrower();
 
-  std::stack<bool> levels;
-  std::string indentation;
+  out.put('"');
 
-  std::ostream& out;
+  auto curr = str.data();
+  auto end = curr + str.size();
 
-  void write_indentation(int count) {
-    for (auto i = 0; i < count; ++i) {
-      out << indentation;
+  while (curr != end) {
+    // Most text is plain ASCII, which is copied in bulk
+    auto size = std::min(static_cast<std::size_t>(end - curr), max_narrow_size);
+    auto dst = reinterpret_cast<unsigned char*>(out.prepare(size));
+    auto n = narrow(curr, size, dst);
+    n += narrow_ascii_scalar(curr + n, size - n, dst + n);
+    out.commit(n);
+    curr += n;
+    if (n < size) {
+      write_code_point(out, *curr);
+      ++curr;
     }
   }
 
-  void write_string(const std::string& str) {
-    out << '"';
-    for (auto ch: str) {
-      out << escape_char(ch);
-    }
-    out << '"';
-  }
-
-public:
-
-  json_encoder(std::ostream& out, std::string indentation):
-    indentation(indentation), out(out) {}
+  out.put('"');
+}
 
-  void transform(bool& v) override {
-    out << (v ? "true" : "false");
-  }
+namespace {
 
-  void transform(char& v) override {
-    out << '"' << escape_char(v) << '"';
-  }
+  /// Writes a value as JSON.
+  ///
+  /// The tree is walked by reference with an explicit stack, so that
+  /// printing neither copies subtrees nor runs out of C++ stack on deeply
+  /// nested documents.
+  class value_printer {
 
-  void transform(short& v) override {
-    out << v;
-  }
+    struct frame {
+      const value* container = nullptr;
+      // Arrays are walked by index and objects by iterator
+      std::size_t index = 0;
+      object::const_iterator curr = {};
+      object::const_iterator end = {};
+      bool first = true;
+    };
 
-  void transform(int& v) override {
-    out << v;
-  }
+    output_buffer& out;
 
-  void transform(long& v) override {
-    out << v;
-  }
+    std::string indentation;
 
-  void transform(long long& v) override {
-    out << v;
-  }
+    // The indentation of the deepest level so far, so that every line is
+    // indented with a single copy
+    std::string indent_cache;
 
-  void transform(unsigned char& v) override {
-    out << v;
-  }
+    std::vector<frame> stack;
 
-  void transform(unsigned short& v) override {
-    out << v;
-  }
+    // How deep the value that is printed is nested in its parent
+    std::size_t base_depth;
 
-  void transform(unsigned int& v) override {
-    out << v;
-  }
+    bool pretty() const noexcept {
+      return !indentation.empty();
+    }
 
-  void transform(unsigned long& v) override {
-    out << v;
-  }
+    void write_indent(std::size_t depth) {
+      auto size = depth * indentation.size();
+      while (indent_cache.size() < size) {
+        indent_cache += indentation;
+      }
+      out.write(indent_cache.data(), size);
+    }
 
-  void transform(unsigned long long& v) override {
-    out << v;
-  }
+    void start_line(frame& top) {
+      if (!top.first) {
+        out.put(',');
+      }
+      top.first = false;
+      if (pretty()) {
+        out.put('\n');
+        write_indent(base_depth + stack.size());
+      }
+    }
 
-  void transform(float& v) override {
-    float integral;
-    if (std::modf(v, &integral) == 0) {
-      out << integral << ".0";
-    } else {
-      out << v << v;
+    void close(char ch) {
+      stack.pop_back();
+      if (pretty()) {
+        out.put('\n');
+        write_indent(base_depth + stack.size());
+      }
+      out.put(ch);
     }
-  }
 
-  void transform(double& v) override {
-    double integral;
-    if (std::modf(v, &integral) == 0) {
-      out << integral << ".0";
-    } else {
-      out << v << v;
+    /// Writes a scalar in full, or the start of a container after which its
+    /// elements are written by run().
+    void write(const value& v) {
+      switch (v.get_type()) {
+        case value_type::array:
+          if (v.as_array().empty()) {
+            out.write("[]");
+          } else {
+            out.put('[');
+            stack.push_back(frame { &v });
+          }
+          break;
+        case value_type::object:
+        {
+          const auto& object = v.as_object();
+          if (object.empty()) {
+            out.write("{}");
+          } else {
+            out.put('{');
+            stack.push_back(frame { &v, 0, object.cbegin(), object.cend() });
+          }
+          break;
+        }
+        case value_type::boolean:
+          out.write(v.is_true() ? "true" : "false");
+          break;
+        case value_type::string:
+          write_json_string(out, v.as_string());
+          break;
+        case value_type::utf8_string:
+          write_json_string(out, std::string_view(v.as_utf8_string()));
+          break;
+        case value_type::null:
+          out.write("null");
+          break;
+        case value_type::fractional:
+          write_floating(out, v.as_fractional());
+          break;
+        case value_type::integer:
+          write_integer(out, v.as_integer());
+          break;
+      }
     }
-  }
 
-  void transform(std::string& v) override {
-    write_string(v);
-  }
+  public:
 
-  void start_transform_object(const std::string& tag_name) override {
-    out << "{";
-    levels.push(true);
-  }
+    value_printer(output_buffer& out, std::string indentation, std::size_t base_depth = 0):
+      out(out), indentation(std::move(indentation)), base_depth(base_depth) {
+        stack.reserve(32);
+      }
 
-  void end_transform_object() override {
-    levels.pop();
-    if (!indentation.empty()) {
-      out << "\n";
-      write_indentation(levels.size());
+    /// Write the elements of an array without its brackets.
+    ///
+    /// `first` tells whether `begin` is the first element of the array,
+    /// which is not preceded by a comma.
+    void run_elements(const value* begin, const value* end, bool first) {
+      for (auto curr = begin; curr != end; ++curr) {
+        if (!first) {
+          out.put(',');
+        }
+        first = false;
+        if (pretty()) {
+          out.put('\n');
+          write_indent(base_depth);
+        }
+        run(*curr);
+      }
     }
-    out << "}";
-  }
 
-  void start_transform_field(const std::string& name) override {
-    if (!levels.top()) {
-      out << ",";
-    } else {
-      levels.top() = false;
-    }
-    if (!indentation.empty()) {
-      out << "\n";
-      write_indentation(levels.size());
-    }
-    write_string(name);
-    out << ":";
-    if (!indentation.empty()) {
-      out << " ";
+    void run(const value& root) {
+      write(root);
+      while (!stack.empty()) {
+        auto& top = stack.back();
+        const value* next;
+        if (top.container->is_object()) {
+          if (top.curr == top.end) {
+            close('}');
+            continue;
+          }
+          start_line(top);
+          const auto& key = top.curr->first;
+          if (key.is_utf8()) {
+            write_json_string(out, key.utf8());
+          } else {
+            write_json_string(out, key.view());
+          }
+          if (pretty()) {
+            out.write(": ");
+          } else {
+            out.put(':');
+          }
+          next = &top.curr->second;
+          ++top.curr;
+        } else {
+          const auto& array = top.container->as_array();
+          if (top.index == array.size()) {
+            close(']');
+            continue;
+          }
+          start_line(top);
+          next = &array[top.index];
+          ++top.index;
+        }
+        // May push a new frame, after which `top` is no longer valid
+        write(*next);
+      }
     }
-  }
 
-  void end_transform_field() override {
+  };
 
-  }
+}
 
-  void start_transform_element() override {
-    if (!levels.top()) {
-      out << ",";
-    } else {
-      levels.top() = false;
-    }
-    if (!indentation.empty()) {
-      out << "\n";
-      write_indentation(levels.size());
-    }
-  }
+void print(const value& v, output_buffer& out, const json_print_opts& opts) {
+  value_printer(out, opts.indentation).run(v);
+}
 
-  void end_transform_element() override {
-    // if (!indentation.empty()) {
-    //   out << "\n";
-    //   write_indentation(levels.size());
-    // }
-  }
+void print(const value &v, std::ostream& out, const json_print_opts& opts) {
+  output_buffer buffer(out);
+  print(v, buffer, opts);
+}
 
-  void start_transform_optional() override {
+std::string to_string(const value& v, const json_print_opts& opts) {
+  output_buffer buffer;
+  print(v, buffer, opts);
+  return buffer.str();
+}
 
-  }
+void json_detail::print_elements(
+  const value* begin,
+  const value* end,
+  output_buffer& out,
+  const json_print_opts& opts,
+  bool first
+) {
+  value_printer(out, opts.indentation, 1).run_elements(begin, end, first);
+}
 
-  void end_transform_optional() override {
+std::unique_ptr<transformer> make_json_encoder(
+  std::ostream& out,
+  json_encode_opts opts
+) {
+  return std::make_unique<json_encoder>(out, opts);
+}
 
-  }
+std::unique_ptr<transformer> make_json_encoder(
+  output_buffer& out,
+  json_encode_opts opts
+) {
+  return std::make_unique<json_encoder>(out, opts);
+}
 
-  void start_transform_sequence() override {
-    levels.push(true);
-    out << "[";
+void json_detail::decode_utf8(std::string_view in, string& out) {
+  auto curr = reinterpret_cast<const unsigned char*>(in.data());
+  auto end = curr + in.size();
+  out.reserve(out.size() + in.size());
+  while (curr != end) {
+    if (*curr < 0x80) {
+      out.push_back(*curr++);
+      continue;
+    }
+    auto ch = next_utf8_char(curr, end);
+    out.push_back(ch == invalid_utf8_char ? replacement_char : ch);
   }
+}
 
-  void end_transform_sequence() override {
-    levels.pop();
-    if (!indentation.empty()) {
-      out << "\n";
-      write_indentation(levels.size());
+std::string_view json_detail::replace_invalid_utf8(std::string_view in, std::string& scratch) {
+  if (is_valid_utf8(in)) {
+    return in;
+  }
+  scratch.clear();
+  auto curr = reinterpret_cast<const unsigned char*>(in.data());
+  auto end = curr + in.size();
+  while (curr != end) {
+    auto start = curr;
+    if (next_utf8_char(curr, end) == invalid_utf8_char) {
+      append_utf8(scratch, replacement_char);
+    } else {
+      scratch.append(reinterpret_cast<const char*>(start), curr - start);
     }
-    out << "]";
   }
+  return scratch;
+}
 
-  void transform_nil() override {
-    out << "null";
-  }
+namespace {
 
-  void transform_size(std::size_t size) override {
+  /// Builds a value out of the events of the tokenizer.
+  class value_builder {
 
-  }
+    // Where the containers and strings of the result are allocated
+    std::pmr::memory_resource* resource;
 
-  ~json_encoder() {
+    struct frame {
+      bool is_object;
+      // Where the members of this container start in `pending` and `keys`
+      std::size_t values_start;
+      std::size_t keys_start;
+    };
 
-  }
+    // Vectors rather than std::stack, because a deque allocates even when it
+    // is empty and most documents are small.
+    std::vector<frame> building;
 
-};
+    // The members of the containers in `building`. They are only moved into
+    // their container once it is complete, so that it can be allocated at
+    // its exact size instead of growing, which would leave the smaller
+    // blocks behind in an arena.
+    std::vector<value> pending;
 
-std::unique_ptr<transformer> make_json_encoder(
-  std::ostream& out,
-  json_encode_opts opts
-) {
-  return std::make_unique<json_encoder>(out, opts.indentation);
-}
+    // Keys of the members of the objects in `building`
+    std::vector<object_key> keys;
 
-static bool is_json_whitespace(char ch) {
-  switch (ch) {
-    case ' ':
-    case '\n':
-    case '\r':
-    case '\t':
-      return true;
-    default:
-      return false;
-  }
-}
+    // Where keys are interned, if they are
+    key_table* interned = nullptr;
+    std::unique_ptr<key_table> own_table;
 
-static bool is_json_digit(char ch) {
-  switch (ch) {
-    case '0':
-    case '1':
-    case '2':
-    case '3':
-    case '4':
-    case '5':
-    case '6':
-    case '7':
-    case '8':
-    case '9':
-      return true;
-    default:
-      return false;
-  }
-}
+    // Keys are decoded or repaired here before they are copied into an
+    // object_key
+    string scratch;
+    std::string utf8_scratch;
 
-json_parse_result parse_json(std::istream& in) {
+    bool utf8;
 
-  value result;
-  std::optional<string> key;
-  std::stack<value> building;
+    value result;
 
-  for (;;) {
+    void add(value v) {
+      if (building.empty()) {
+        result = std::move(v);
+        return;
+      }
+      pending.push_back(std::move(v));
+    }
 
-    int c0;
+    void open(bool is_object) {
+      building.push_back({ is_object, pending.size(), keys.size() });
+    }
 
-#define ZEN_GET_NO_WHITESPACE(ch) \
-    for (;;) { \
-      ch = in.get(); \
-      if (!is_json_whitespace(ch)) { \
-        break; \
-      } \
+    void close() {
+      auto top = building.back();
+      building.pop_back();
+      auto first = pending.begin() + top.values_start;
+      auto count = pending.size() - top.values_start;
+      if (top.is_object) {
+        object o(resource);
+        o.reserve(count);
+        auto key = keys.begin() + top.keys_start;
+        for (auto iter = first; iter != pending.end(); ++iter) {
+          o.emplace(std::move(*key++), std::move(*iter));
+        }
+        keys.resize(top.keys_start);
+        pending.resize(top.values_start);
+        add(std::move(o));
+      } else {
+        array a(resource);
+        a.reserve(count);
+        std::move(first, pending.end(), std::back_inserter(a));
+        pending.resize(top.values_start);
+        add(std::move(a));
+      }
     }
 
-#define ZEN_PEEK_NO_WHITESPACE(ch) \
-    for (;;) { \
-      ch = in.peek(); \
-      if (!is_json_whitespace(ch)) { \
-        break; \
-      } \
-      in.get(); \
+  public:
+
+    value_builder(
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+      const json_parse_opts& opts = {}
+    ): resource(resource), interned(opts.keys), utf8(opts.strings == string_storage::utf8) {
+      if (interned == nullptr && opts.intern_keys) {
+        own_table = std::make_unique<key_table>(resource, opts.strings);
+        interned = own_table.get();
+      }
     }
 
-#define ZEN_SCAN_DIGIT(name) \
-  unsigned char name; \
-  { \
-    auto ch = in.get(); \
-    if (!is_json_digit(ch)) { \
-      return zen::left(json_parse_error::unexpected_character); \
-    } \
-    name = parse_decimal_digit(ch); \
-  }
+    value& get_result() {
+      return result;
+    }
 
-#define ZEN_ASSERT_CHAR(ch, expected) \
-    { \
-      auto temp = ch; \
-      if (temp != expected) { \
-        return left(json_parse_error::unexpected_character); \
-      } \
+    bool on_null() {
+      add(null {});
+      return true;
     }
 
-#define ZEN_EXPECT_CHAR(expected) \
-  ZEN_ASSERT_CHAR(in.get(), expected);
-
-  ZEN_GET_NO_WHITESPACE(c0);
-
-  switch (c0) {
-
-      case '{':
-        building.push(object {});
-        continue;
-
-      case ']':
-      case '}':
-        result = building.top();
-        building.pop();
-        break;
-
-      case '[':
-        building.push(array {});
-        continue;
-
-      case '0':
-      case '1':
-      case '2':
-      case '3':
-      case '4':
-      case '5':
-      case '6':
-      case '7':
-      case '8':
-      case '9':
-      {
-        bigint x = parse_decimal_digit(c0);
-
-        for (;;) {
-
-          c0 = in.peek();
-
-          switch (c0) {
-
-            case '0':
-            case '1':
-            case '2':
-            case '3':
-            case '4':
-            case '5':
-            case '6':
-            case '7':
-            case '8':
-            case '9':
-              in.get();
-              x = x * 10 + parse_decimal_digit(c0);
-              continue;
-
-            case '.':
-            {
-              in.get();
-              fractional e = 1.0;
-              fractional y = 0.0;
-              fractional k = 1.0;
-
-              for (;;) {
-
-                auto c1 = in.peek();
-
-                switch (c1) {
-
-                  case '0':
-                  case '1':
-                  case '2':
-                  case '3':
-                  case '4':
-                  case '5':
-                  case '6':
-                  case '7':
-                  case '8':
-                  case '9':
-                    in.get();
-                    k /= 10.0;
-                    y += k * parse_decimal_digit(c1);
-                    continue;
-
-                  case 'e':
-                  case 'E':
-                  {
-                    in.get();
-                    e = 0.0;
-                    for (;;) {
-                      auto c2 = in.peek();
-                      switch (c2) {
-                        case '+':
-                          in.get();
-                          break;
-                        case '-':
-                          in.get();
-                          e *= -1;
-                          break;
-                        case '0':
-                        case '1':
-                        case '2':
-                        case '3':
-                        case '4':
-                        case '5':
-                        case '6':
-                        case '7':
-                        case '8':
-                        case '9':
-                          in.get();
-                          e = e * 10.0 + parse_decimal_digit(c2);
-                          break;
-                        case EOF:
-                        case ']':
-                        case '}':
-                        case ',':
-                        case ' ':
-                        case '\t':
-                        case '\r':
-                        case '\n':
-                          goto finish_fractional;
-                        default:
-                          return left(json_parse_error::unexpected_character);
-                      }
-                    }
-                  }
-
-                  case EOF:
-                  case ']':
-                  case '}':
-                  case ',':
-                  case ' ':
-                  case '\t':
-                  case '\r':
-                  case '\n':
-                    goto finish_fractional;
-
-                  default:
-                    return left(json_parse_error::unexpected_character);
-
-                }
-
-              }
-
-finish_fractional:
-              result = value(std::pow(x + y, e));
-              goto process_result;
-
-            }
-
-            case ']':
-            case '}':
-            case ',':
-            case ' ':
-            case '\t':
-            case '\r':
-            case '\n':
-            case EOF:
-              goto finish_integer;
-
-            default:
-              return left(json_parse_error::unexpected_character);
+    bool on_boolean(bool v) {
+      add(v);
+      return true;
+    }
 
-          }
+    bool on_integer(bigint v) {
+      add(v);
+      return true;
+    }
 
-        }
+    bool on_fractional(fractional v) {
+      add(v);
+      return true;
+    }
 
-finish_integer:
-        result = value(x);
-        break;
+    bool on_string(std::string_view v) {
+      if (utf8) {
+        add(utf8_string(replace_invalid_utf8(v, utf8_scratch), resource));
+        return true;
       }
+      string s(resource);
+      decode_utf8(v, s);
+      add(std::move(s));
+      return true;
+    }
 
-      case '"':
-      {
-        string chars;
-        for (;;) {
-          auto c1 = in.get();
-          switch (c1) {
-            case '"':
-              goto finish_string;
-            case '\n':
-              return left(json_parse_error::unexpected_character);
-            case '\\':
-            {
-              auto c2 = in.get();
-              switch (c2) {
-                case '"':
-                  chars.push_back('"');
-                  break;
-                case '\\':
-                  chars.push_back('\\');
-                  break;
-                case '/':
-                  chars.push_back('/');
-                  break;
-                case 'b':
-                  chars.push_back('\b');
-                  break;
-                case 'f':
-                  chars.push_back('\f');
-                  break;
-                case 'n':
-                  chars.push_back('\n');
-                  break;
-                case 'r':
-                  chars.push_back('\r');
-                  break;
-                case 't':
-                  chars.push_back('\t');
-                  break;
-                case 'u':
-                  ZEN_SCAN_DIGIT(d0);
-                  ZEN_SCAN_DIGIT(d1);
-                  ZEN_SCAN_DIGIT(d2);
-                  ZEN_SCAN_DIGIT(d3);
-                  chars.push_back(d0 * 1000 + d1 * 100 + d2 * 10 + d3);
-                  break;
-                default:
-                  return left(json_parse_error::unrecognised_escape_sequence);
-              }
-              break;
-            }
-            default:
-              chars.push_back(c1);
-              break;
-          }
-        }
-finish_string:
-        if (!building.empty() && building.top().is_object() && !key.has_value()) {
-          key = chars;
-          ZEN_GET_NO_WHITESPACE(c0)
-          ZEN_ASSERT_CHAR(c0, ':');
-          continue;
-        }
-        result = value(chars);
-        break;
+    bool on_key(std::string_view v) {
+      if (interned) {
+        keys.push_back(interned->intern(v));
+        return true;
+      }
+      if (utf8) {
+        keys.emplace_back(replace_invalid_utf8(v, utf8_scratch), resource);
+        return true;
       }
+      scratch.clear();
+      decode_utf8(v, scratch);
+      keys.emplace_back(scratch, resource);
+      return true;
+    }
 
-      case 'n':
-        ZEN_EXPECT_CHAR('u');
-        ZEN_EXPECT_CHAR('l');
-        ZEN_EXPECT_CHAR('l');
-        result = value(null {});
-        break;
-
-      case 't':
-        ZEN_EXPECT_CHAR('r');
-        ZEN_EXPECT_CHAR('u');
-        ZEN_EXPECT_CHAR('e');
-        result = value(true);
-        break;
-
-      case 'f':
-        ZEN_EXPECT_CHAR('a');
-        ZEN_EXPECT_CHAR('l');
-        ZEN_EXPECT_CHAR('s');
-        ZEN_EXPECT_CHAR('e');
-        result = value(false);
-        break;
-
-      default:
-        return left(json_parse_error::unexpected_character);
+    bool on_object_start() {
+      open(true);
+      return true;
+    }
 
+    bool on_object_end() {
+      close();
+      return true;
     }
 
-process_result:
+    bool on_array_start() {
+      open(false);
+      return true;
+    }
 
-    if (building.empty()) {
-      break;
+    bool on_array_end() {
+      close();
+      return true;
     }
 
-    auto& top = building.top();
+  };
 
-    switch (top.get_type()) {
+}
 
-      case value_type::object:
-        top.as_object().emplace(*key, result);
-        key = {};
-        break;
+json_events_result parse_json_events(
+  const char* data,
+  std::size_t size,
+  json_handler& handler,
+  json_parse_opts opts
+) {
+  return run_tokenizer(data, size, handler, opts);
+}
 
-      case value_type::array:
-        top.as_array().push_back(result);
-        break;
+json_events_result parse_json_events(
+  std::string_view in,
+  json_handler& handler,
+  json_parse_opts opts
+) {
+  return run_tokenizer(in.data(), in.size(), handler, opts);
+}
 
-      default:
-        ZEN_UNREACHABLE
+json_parse_result parse_json(const char* data, std::size_t size, json_parse_opts opts) {
+  value_builder builder(std::pmr::get_default_resource(), opts);
+  auto result = run_tokenizer(data, size, builder, opts);
+  if (result.is_left()) {
+    return left(result.left());
+  }
+  return right(std::move(builder.get_result()));
+}
 
-    }
+json_parse_result parse_json(
+  const char* data,
+  std::size_t size,
+  std::pmr::memory_resource& resource,
+  json_parse_opts opts
+) {
+  value_builder builder(&resource, opts);
+  auto result = run_tokenizer(data, size, builder, opts);
+  if (result.is_left()) {
+    return left(result.left());
+  }
+  return right(std::move(builder.get_result()));
+}
 
-    ZEN_PEEK_NO_WHITESPACE(c0)
-    switch (c0) {
-      case '}':
-      case ']':
-        result = building.top();
-        building.pop();
-        goto process_result;
-      case ',':
-        in.get();
-        continue;
-      default:
-        return zen::left(json_parse_error::unexpected_character);
-    }
+json_parse_result parse_json(
+  std::string_view in,
+  std::pmr::memory_resource& resource,
+  json_parse_opts opts
+) {
+  return parse_json(in.data(), in.size(), resource, opts);
+}
+
+json_parse_result parse_json(const char* in, json_parse_opts opts) {
+  return parse_json(in, std::strlen(in), opts);
+}
 
-    // We should never be able to get here, as the previous switch-statement
-    // should have modified the control-flow in all cases.
+json_parse_result parse_json(std::string_view in, json_parse_opts opts) {
+  return parse_json(in.data(), in.size(), opts);
+}
 
-  }
+json_parse_result parse_json(const std::string& in, json_parse_opts opts) {
+  return parse_json(in.data(), in.size(), opts);
+}
 
-  return right(result);
+json_parse_result parse_json(bytestring_view in, json_parse_opts opts) {
+  return parse_json(in.ptr, in.sz, opts);
+}
 
+json_parse_result parse_json(std::istream& in, json_parse_opts opts) {
+  // The scanner works on contiguous memory, so all we have to do here is
+  // drain the stream into a buffer in large chunks.
+  std::string buffer;
+  char chunk[64 * 1024];
+  while (in.read(chunk, sizeof(chunk)) || in.gcount() > 0) {
+    buffer.append(chunk, in.gcount());
+  }
+  return parse_json(buffer.data(), buffer.size(), opts);
 }
 
-json_parse_result parse_json(const std::string& in) {
-  std::istringstream iss(in);
-  return parse_json(iss);
+json_file_result parse_json_file(const fs::path& filename, json_parse_opts opts) {
+  auto mapped = fs::map_file(filename);
+  if (mapped.is_left()) {
+    return left(json_file_error(mapped.left()));
+  }
+  auto& file = mapped.right();
+  auto result = parse_json(file.data(), file.size(), opts);
+  if (result.is_left()) {
+    return left(json_file_error(result.left()));
+  }
+  return right(std::move(result.right()));
 }
 
-// std::unique_ptr<transformer> make_json_decoder(
-//   std::istream& in,
-//   json_decode_opts opts
-// ) {
-//   return std::make_unique<json_decoder>(in);
-// }
+class json_push_parser::impl {
+public:
+
+  value_builder builder;
+
+  push_tokenizer<value_builder> tokenizer;
+
+  impl(std::pmr::memory_resource* resource, const json_parse_opts& opts):
+    builder(resource, opts), tokenizer(builder) {}
+
+};
+
+json_push_parser::json_push_parser(std::pmr::memory_resource& resource, json_parse_opts opts):
+  state(std::make_unique<impl>(&resource, opts)), resource(&resource), opts(opts) {}
+
+json_push_parser::json_push_parser(json_push_parser&& other) noexcept = default;
+
+json_push_parser& json_push_parser::operator=(json_push_parser&& other) noexcept = default;
+
+json_push_parser::~json_push_parser() = default;
+
+json_events_result json_push_parser::feed(const char* data, std::size_t size) {
+  return state->tokenizer.feed(data, size);
+}
+
+json_parse_result json_push_parser::finish() {
+  auto result = state->tokenizer.finish();
+  auto v = std::move(state->builder.get_result());
+  state = std::make_unique<impl>(resource, opts);
+  if (result.is_left()) {
+    return left(result.left());
+  }
+  return right(std::move(v));
+}
 
 ZEN_NAMESPACE_END
 
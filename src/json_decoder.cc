@@ -0,0 +1,513 @@
+#include <cmath>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "zen/config.hpp"
+#include "zen/json.hpp"
+#include "zen/json_decoder.hpp"
+
+#include "json_tokenizer.hpp"
+
+ZEN_NAMESPACE_START
+
+using namespace json_detail;
+
+namespace {
+
+  const unsigned char* to_bytes(const char* ptr) {
+    return reinterpret_cast<const unsigned char*>(ptr);
+  }
+
+  const char* to_chars(const unsigned char* ptr) {
+    return reinterpret_cast<const char*>(ptr);
+  }
+
+  bool starts_value(char ch) {
+    switch (ch) {
+      case '{':
+      case '[':
+      case '"':
+      case '-':
+      case 't':
+      case 'f':
+      case 'n':
+        return true;
+      default:
+        return is_json_digit(ch);
+    }
+  }
+
+  /// Get the error for when something else than the expected value starts
+  /// at `curr`.
+  json_parse_error mismatch_at(const char* curr, const char* end) {
+    return curr != end && starts_value(*curr)
+      ? json_parse_error::type_mismatch
+      : json_parse_error::unexpected_character;
+  }
+
+  /// Convert a run of decimal digits, failing if it doesn't fit.
+  bool parse_digits(const char* begin, const char* end, std::uint64_t& out) {
+    std::uint64_t value = 0;
+    for (auto curr = begin; curr != end; ++curr) {
+      if (!is_json_digit(*curr)) {
+        return false;
+      }
+      if (__builtin_mul_overflow(value, 10, &value)
+          || __builtin_add_overflow(value, static_cast<std::uint64_t>(*curr - '0'), &value)) {
+        return false;
+      }
+    }
+    out = value;
+    return true;
+  }
+
+}
+
+json_decoder::json_decoder(std::string_view input, const json_decode_opts&):
+  curr(input.data()), end(input.data() + input.size()) {}
+
+json_decoder::json_decoder(std::istream& input, const json_decode_opts&) {
+  char chunk[64 * 1024];
+  while (input.read(chunk, sizeof(chunk)) || input.gcount() > 0) {
+    own_input.append(chunk, input.gcount());
+  }
+  curr = own_input.data();
+  end = curr + own_input.size();
+}
+
+void json_decoder::fail(json_parse_error e) {
+  if (!error) {
+    error = e;
+  }
+  curr = end;
+}
+
+bool json_decoder::enter(char open) {
+  skip_whitespace();
+  if (curr == end || *curr != open) {
+    fail(mismatch_at(curr, end));
+    return false;
+  }
+  ++curr;
+  if (++depth > json_validate_max_depth) {
+    fail(json_parse_error::max_depth_exceeded);
+    return false;
+  }
+  return true;
+}
+
+bool json_decoder::next_member(char close, bool& first) {
+  skip_whitespace();
+  if (curr == end) {
+    fail(json_parse_error::unexpected_character);
+    return false;
+  }
+  if (*curr == close) {
+    ++curr;
+    --depth;
+    return false;
+  }
+  if (!first) {
+    if (*curr != ',') {
+      fail(json_parse_error::unexpected_character);
+      return false;
+    }
+    ++curr;
+    skip_whitespace();
+  }
+  first = false;
+  return true;
+}
+
+bool json_decoder::read_key(std::string_view& key) {
+  skip_whitespace();
+  if (curr == end || *curr != '"') {
+    fail(json_parse_error::unexpected_character);
+    return false;
+  }
+  auto p = to_bytes(curr + 1);
+  json_parse_error e;
+  if (!scan_string(p, to_bytes(end), scratch, key, e)) {
+    fail(e);
+    return false;
+  }
+  curr = to_chars(p);
+  skip_whitespace();
+  if (curr == end || *curr != ':') {
+    fail(json_parse_error::unexpected_character);
+    return false;
+  }
+  ++curr;
+  return true;
+}
+
+void json_decoder::skip() {
+  skip_whitespace();
+  auto p = skip_value(to_bytes(curr), to_bytes(end));
+  if (p == nullptr) {
+    fail(json_parse_error::unexpected_character);
+    return;
+  }
+  curr = to_chars(p);
+}
+
+void json_decoder::read_null() {
+  skip_whitespace();
+  auto p = to_bytes(curr);
+  if (p == to_bytes(end) || *p != 'n' || !scan_keyword(++p, to_bytes(end), "ull")) {
+    fail(mismatch_at(curr, end));
+    return;
+  }
+  curr = to_chars(p);
+}
+
+bool json_decoder::read_signed(std::int64_t& value) {
+  skip_whitespace();
+  if (curr == end || (*curr != '-' && !is_json_digit(*curr))) {
+    fail(mismatch_at(curr, end));
+    return false;
+  }
+  auto p = to_bytes(curr + 1);
+  bigint integer;
+  fractional fraction;
+  switch (scan_number(*curr, p, to_bytes(end), integer, fraction)) {
+    case number_kind::invalid:
+      fail(json_parse_error::unexpected_character);
+      return false;
+    case number_kind::integer:
+      value = integer;
+      break;
+    case number_kind::fractional:
+      // Only integers that are written with a fraction or an exponent, such
+      // as 2.0 or 1e3, are accepted
+      if (std::trunc(fraction) != fraction) {
+        fail(json_parse_error::type_mismatch);
+        return false;
+      }
+      if (fraction < -9223372036854775808.0 || fraction >= 9223372036854775808.0) {
+        fail(json_parse_error::number_out_of_range);
+        return false;
+      }
+      value = static_cast<std::int64_t>(fraction);
+      break;
+  }
+  curr = to_chars(p);
+  return true;
+}
+
+bool json_decoder::read_unsigned(std::uint64_t& value) {
+  skip_whitespace();
+  auto start = curr;
+  if (start != end && is_json_digit(*start)) {
+    // Integers above the range of std::int64_t can only be read exactly by
+    // hand
+    auto p = start;
+    while (p != end && is_json_digit(*p)) {
+      ++p;
+    }
+    if (p - start >= 19 && (p == end || is_json_terminator(*p))) {
+      if (*start == '0' || !parse_digits(start, p, value)) {
+        fail(*start == '0' ? json_parse_error::unexpected_character : json_parse_error::number_out_of_range);
+        return false;
+      }
+      curr = p;
+      return true;
+    }
+  }
+  if (start == end || (*start != '-' && !is_json_digit(*start))) {
+    fail(mismatch_at(start, end));
+    return false;
+  }
+  auto p = to_bytes(start + 1);
+  bigint integer;
+  fractional fraction;
+  switch (scan_number(*start, p, to_bytes(end), integer, fraction)) {
+    case number_kind::invalid:
+      fail(json_parse_error::unexpected_character);
+      return false;
+    case number_kind::integer:
+      if (integer < 0) {
+        fail(json_parse_error::number_out_of_range);
+        return false;
+      }
+      value = static_cast<std::uint64_t>(integer);
+      break;
+    case number_kind::fractional:
+      // Checked against the range of std::uint64_t rather than going through
+      // read_signed(), so that 1e19 can be read
+      if (std::trunc(fraction) != fraction) {
+        fail(json_parse_error::type_mismatch);
+        return false;
+      }
+      if (fraction < 0 || fraction >= 18446744073709551616.0) {
+        fail(json_parse_error::number_out_of_range);
+        return false;
+      }
+      value = static_cast<std::uint64_t>(fraction);
+      break;
+  }
+  curr = to_chars(p);
+  return true;
+}
+
+void json_decoder::read_fractional(double& value) {
+  skip_whitespace();
+  if (curr == end || (*curr != '-' && !is_json_digit(*curr))) {
+    fail(mismatch_at(curr, end));
+    return;
+  }
+  auto p = to_bytes(curr + 1);
+  bigint integer;
+  fractional fraction;
+  switch (scan_number(*curr, p, to_bytes(end), integer, fraction)) {
+    case number_kind::invalid:
+      fail(json_parse_error::unexpected_character);
+      return;
+    case number_kind::integer:
+      value = static_cast<double>(integer);
+      break;
+    case number_kind::fractional:
+      value = fraction;
+      break;
+  }
+  curr = to_chars(p);
+}
+
+bool json_decoder::read_string(std::string_view& value) {
+  skip_whitespace();
+  if (curr == end || *curr != '"') {
+    fail(mismatch_at(curr, end));
+    return false;
+  }
+  auto p = to_bytes(curr + 1);
+  json_parse_error e;
+  if (!scan_string(p, to_bytes(end), scratch, value, e)) {
+    fail(e);
+    return false;
+  }
+  curr = to_chars(p);
+  return true;
+}
+
+json_decode_result json_decoder::finish() {
+  if (!error) {
+    skip_whitespace();
+    if (curr != end) {
+      fail(json_parse_error::unexpected_character);
+    }
+  }
+  if (error) {
+    return left(*error);
+  }
+  return right();
+}
+
+void json_decoder::transform(bool& v) {
+  if (missing > 0) {
+    return;
+  }
+  skip_whitespace();
+  auto p = to_bytes(curr);
+  if (p != to_bytes(end) && *p == 't' && scan_keyword(++p, to_bytes(end), "rue")) {
+    v = true;
+  } else if (p != to_bytes(end) && *p == 'f' && scan_keyword(++p, to_bytes(end), "alse")) {
+    v = false;
+  } else {
+    fail(mismatch_at(curr, end));
+    return;
+  }
+  curr = to_chars(p);
+}
+
+void json_decoder::transform(char& v) {
+  std::string_view str;
+  if (missing > 0 || !read_string(str)) {
+    return;
+  }
+  if (str.size() != 1) {
+    fail(json_parse_error::type_mismatch);
+    return;
+  }
+  v = str[0];
+}
+
+void json_decoder::transform_nil() {
+  if (missing > 0) {
+    return;
+  }
+  if (at_null()) {
+    read_null();
+  } else {
+    skip();
+  }
+}
+
+void json_decoder::start_transform_object(const std::string&) {
+  if (missing > 0 || error || !enter('{')) {
+    return;
+  }
+  if (objects.size() == object_depth) {
+    objects.emplace_back();
+  }
+  auto& frame = objects[object_depth++];
+  frame.body = curr;
+  frame.first = true;
+  frame.indexed = false;
+  frame.index.clear();
+  frame.end = nullptr;
+}
+
+void json_decoder::start_transform_field(const std::string& name) {
+  if (missing > 0) {
+    ++missing;
+    return;
+  }
+  if (error || object_depth == 0) {
+    return;
+  }
+  find_field(name);
+}
+
+void json_decoder::find_field(const std::string& name) {
+
+  auto& frame = objects[object_depth - 1];
+
+  if (!frame.indexed) {
+    // Fields are usually requested in the order of the input, so try the
+    // next key before looking at the whole object
+    auto start = curr;
+    skip_whitespace();
+    if (curr != end && *curr == '}') {
+      // Every key so far was requested, so this one can't be anywhere else
+      curr = start;
+      missing = 1;
+      return;
+    }
+    if (!frame.first) {
+      if (curr == end || *curr != ',') {
+        fail(json_parse_error::unexpected_character);
+        return;
+      }
+      ++curr;
+    }
+    std::string_view key;
+    if (!read_key(key)) {
+      return;
+    }
+    if (key == name) {
+      frame.first = false;
+      return;
+    }
+    index_object(frame);
+    if (error) {
+      return;
+    }
+  }
+
+  for (const auto& [key, value]: frame.index) {
+    if (key == name) {
+      curr = value;
+      return;
+    }
+  }
+  missing = 1;
+}
+
+void json_decoder::index_object(object_frame& frame) {
+  curr = frame.body;
+  bool first = true;
+  std::string_view key;
+  for (;;) {
+    skip_whitespace();
+    if (curr == end) {
+      fail(json_parse_error::unexpected_character);
+      return;
+    }
+    if (*curr == '}') {
+      ++curr;
+      break;
+    }
+    if (!first) {
+      if (*curr != ',') {
+        fail(json_parse_error::unexpected_character);
+        return;
+      }
+      ++curr;
+    }
+    first = false;
+    if (!read_key(key)) {
+      return;
+    }
+    skip_whitespace();
+    frame.index.emplace_back(key, curr);
+    skip();
+  }
+  frame.indexed = true;
+  frame.end = curr;
+}
+
+void json_decoder::end_transform_object() {
+  if (missing > 0 || error || object_depth == 0) {
+    return;
+  }
+  auto& frame = objects[--object_depth];
+  if (frame.indexed) {
+    curr = frame.end;
+    --depth;
+    return;
+  }
+  // Skip the keys that were not asked for
+  bool first = frame.first;
+  std::string_view key;
+  while (next_member('}', first)) {
+    if (!read_key(key)) {
+      return;
+    }
+    skip();
+  }
+}
+
+void json_decoder::start_transform_sequence() {
+  if (missing > 0 || error || !enter('[')) {
+    return;
+  }
+  sequences.push_back(true);
+}
+
+void json_decoder::start_transform_element() {
+  if (missing > 0 || error || sequences.empty()) {
+    return;
+  }
+  skip_whitespace();
+  if (!sequences.back()) {
+    if (curr == end || *curr != ',') {
+      fail(curr != end && *curr == ']' ? json_parse_error::type_mismatch : json_parse_error::unexpected_character);
+      return;
+    }
+    ++curr;
+  }
+  sequences.back() = false;
+}
+
+void json_decoder::end_transform_sequence() {
+  if (missing > 0 || error || sequences.empty()) {
+    return;
+  }
+  bool first = sequences.back();
+  sequences.pop_back();
+  while (next_member(']', first)) {
+    skip();
+  }
+}
+
+std::unique_ptr<json_decoder> make_json_decoder(
+  std::istream& in,
+  json_decode_opts opts
+) {
+  return std::make_unique<json_decoder>(in, opts);
+}
+
+ZEN_NAMESPACE_END
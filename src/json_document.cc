@@ -0,0 +1,205 @@
+
+#include <cstring>
+
+#include "zen/json_document.hpp"
+
+#include "json_tokenizer.hpp"
+
+ZEN_NAMESPACE_START
+
+using namespace json_detail;
+
+/// Sizes are stored next to the index of the closing word, in the bits that
+/// remain of the payload. Larger containers have to be counted.
+static constexpr const std::uint64_t max_stored_size = (std::uint64_t(1) << 24) - 1;
+
+/// Borrowed strings use the same layout, so longer strings are copied.
+static constexpr const std::uint64_t max_borrowed_size = max_stored_size;
+
+/// Containers store the index of the word after their end in 32 bits, and
+/// copied strings are prefixed by a 32-bit length.
+static constexpr const std::uint64_t max_index = UINT32_MAX;
+static constexpr const std::uint64_t max_copied_size = UINT32_MAX;
+
+/// Writes the events of the tokenizer to the tape of a json_document.
+class json_tape_builder {
+
+  std::vector<std::uint64_t>& tape;
+  std::string& strings;
+
+  // The part of the input that strings may point into, or empty if strings
+  // must be copied
+  std::string_view input;
+
+  // The tape index of each container that is still open, together with the
+  // amount of elements that it has so far
+  std::vector<std::pair<std::size_t, std::uint64_t>> open;
+
+  void append(char tag, std::uint64_t payload = 0) {
+    tape.push_back((static_cast<std::uint64_t>(tag) << 56) | payload);
+  }
+
+  void count() {
+    if (!open.empty()) {
+      ++open.back().second;
+    }
+  }
+
+  bool append_string(std::string_view v) {
+    // The tokenizer only hands out a pointer into the input when the string
+    // had nothing to decode.
+    if (!input.empty() && v.data() >= input.data() && v.data() <= input.data() + input.size()
+        && v.size() <= max_borrowed_size) {
+      std::uint64_t offset = v.data() - input.data();
+      append('\'', (static_cast<std::uint64_t>(v.size()) << 32) | offset);
+      return true;
+    }
+    if (v.size() > max_copied_size) {
+      too_large = true;
+      return false;
+    }
+    append('"', strings.size());
+    std::uint32_t size = v.size();
+    strings.append(reinterpret_cast<const char*>(&size), sizeof(size));
+    strings.append(v);
+    strings.push_back('\0');
+    return true;
+  }
+
+  void start(char tag) {
+    count();
+    open.emplace_back(tape.size(), 0);
+    append(tag);
+  }
+
+  bool finish(char start_tag, char end_tag) {
+    auto [start_index, size] = open.back();
+    open.pop_back();
+    append(end_tag, start_index);
+    if (tape.size() > max_index) {
+      too_large = true;
+      return false;
+    }
+    if (size > max_stored_size) {
+      size = max_stored_size;
+    }
+    tape[start_index] = (static_cast<std::uint64_t>(start_tag) << 56)
+                      | (size << 32)
+                      | tape.size();
+    return true;
+  }
+
+public:
+
+  // Whether the document has outgrown the fields of the tape, in which case
+  // building stops
+  bool too_large = false;
+
+  json_tape_builder(json_document& doc, std::string_view input):
+    tape(doc.tape), strings(doc.strings), input(input) {
+      doc.input = input.data();
+    }
+
+  bool on_null() {
+    count();
+    append('n');
+    return true;
+  }
+
+  bool on_boolean(bool v) {
+    count();
+    append(v ? 't' : 'f');
+    return true;
+  }
+
+  bool on_integer(bigint v) {
+    count();
+    append('l');
+    tape.push_back(static_cast<std::uint64_t>(v));
+    return true;
+  }
+
+  bool on_fractional(fractional v) {
+    count();
+    append('d');
+    std::uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    tape.push_back(bits);
+    return true;
+  }
+
+  bool on_string(std::string_view v) {
+    count();
+    return append_string(v);
+  }
+
+  bool on_key(std::string_view v) {
+    return append_string(v);
+  }
+
+  bool on_object_start() {
+    start('{');
+    return true;
+  }
+
+  bool on_object_end() {
+    return finish('{', '}');
+  }
+
+  bool on_array_start() {
+    start('[');
+    return true;
+  }
+
+  bool on_array_end() {
+    return finish('[', ']');
+  }
+
+};
+
+json_document_result parse_json_document(
+  const char* data,
+  std::size_t size,
+  json_parse_opts opts
+) {
+  json_document doc;
+  std::string_view input;
+  // Offsets into the input are stored in 32 bits
+  if (opts.borrow_strings && size <= UINT32_MAX) {
+    input = std::string_view(data, size);
+  }
+  json_tape_builder builder(doc, input);
+  auto result = run_tokenizer(data, size, builder, opts);
+  if (builder.too_large) {
+    return left(json_parse_error::document_too_large);
+  }
+  if (result.is_left()) {
+    return left(result.left());
+  }
+  return right(std::move(doc));
+}
+
+json_document_result parse_json_document(
+  std::string_view in,
+  json_parse_opts opts
+) {
+  return parse_json_document(in.data(), in.size(), opts);
+}
+
+std::size_t json_array::size() const {
+  auto stored = (element.payload() >> 32) & max_stored_size;
+  if (stored < max_stored_size) {
+    return stored;
+  }
+  return std::distance(begin(), end());
+}
+
+std::size_t json_object::size() const {
+  auto stored = (element.payload() >> 32) & max_stored_size;
+  if (stored < max_stored_size) {
+    return stored;
+  }
+  return std::distance(begin(), end());
+}
+
+ZEN_NAMESPACE_END
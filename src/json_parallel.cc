@@ -0,0 +1,384 @@
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ZEN_HAVE_WRITEV 1
+#include <sys/uio.h>
+#include <unistd.h>
+#else
+#define ZEN_HAVE_WRITEV 0
+#endif
+
+#include "zen/json_parallel.hpp"
+
+ZEN_NAMESPACE_START
+
+namespace {
+
+#if ZEN_HAVE_WRITEV
+
+#ifdef IOV_MAX
+  constexpr std::size_t max_iovecs = IOV_MAX;
+#else
+  constexpr std::size_t max_iovecs = 1024;
+#endif
+
+  std::error_code write_all(int fd, const std::vector<std::string_view>& pieces) {
+    std::vector<iovec> iovecs;
+    iovecs.reserve(pieces.size());
+    for (auto piece: pieces) {
+      if (!piece.empty()) {
+        iovecs.push_back(iovec { const_cast<char*>(piece.data()), piece.size() });
+      }
+    }
+    std::size_t i = 0;
+    while (i < iovecs.size()) {
+      auto count = std::min(iovecs.size() - i, max_iovecs);
+      auto n = ::writev(fd, iovecs.data() + i, static_cast<int>(count));
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return std::error_code(errno, std::generic_category());
+      }
+      // Skip what was written, which may end in the middle of a buffer
+      auto written = static_cast<std::size_t>(n);
+      while (written > 0) {
+        if (written >= iovecs[i].iov_len) {
+          written -= iovecs[i].iov_len;
+          ++i;
+        } else {
+          iovecs[i].iov_base = static_cast<char*>(iovecs[i].iov_base) + written;
+          iovecs[i].iov_len -= written;
+          written = 0;
+        }
+      }
+    }
+    return {};
+  }
+
+#else
+
+  std::error_code write_all(int fd, const std::vector<std::string_view>& pieces) {
+    output_buffer buffer(fd);
+    for (auto piece: pieces) {
+      buffer.write(piece);
+    }
+    buffer.flush();
+    return buffer.error();
+  }
+
+#endif
+
+  /// Where the output of write_array_parallel() goes.
+  class array_sink {
+
+    output_buffer* out;
+    int fd;
+
+    std::error_code error;
+
+  public:
+
+    array_sink(output_buffer* out, int fd):
+      out(out), fd(fd) {}
+
+    bool failed() const noexcept {
+      return bool(error);
+    }
+
+    void write(const std::vector<std::string_view>& pieces) {
+      if (error) {
+        return;
+      }
+      if (out != nullptr) {
+        for (auto piece: pieces) {
+          out->write(piece);
+        }
+      } else {
+        error = write_all(fd, pieces);
+      }
+    }
+
+    json_write_result result() const {
+      if (error) {
+        return left(error);
+      }
+      return right();
+    }
+
+  };
+
+  struct chunk_slot {
+    output_buffer buffer;
+    bool done = false;
+  };
+
+  /// The workers of write_array_parallel(), which are stopped and joined
+  /// when the writer is done or throws.
+  class worker_threads {
+
+    std::mutex& mutex;
+    bool& stopped;
+    std::condition_variable& chunk_done;
+    std::condition_variable& slot_free;
+
+    std::vector<std::thread> threads;
+
+  public:
+
+    worker_threads(
+      std::mutex& mutex,
+      bool& stopped,
+      std::condition_variable& chunk_done,
+      std::condition_variable& slot_free
+    ): mutex(mutex), stopped(stopped), chunk_done(chunk_done), slot_free(slot_free) {}
+
+    worker_threads(const worker_threads& other) = delete;
+    worker_threads& operator=(const worker_threads& other) = delete;
+
+    ~worker_threads() {
+      join();
+    }
+
+    template<typename F>
+    void start(std::size_t count, F run) {
+      threads.reserve(count);
+      for (std::size_t i = 0; i < count; ++i) {
+        threads.emplace_back(run);
+      }
+    }
+
+    /// Tell the workers to stop and wait until they have.
+    void join() {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+      }
+      chunk_done.notify_all();
+      slot_free.notify_all();
+      for (auto& thread: threads) {
+        thread.join();
+      }
+      threads.clear();
+    }
+
+  };
+
+}
+
+json_write_result json_detail::write_array_parallel(
+  std::size_t size,
+  bool pretty,
+  std::string_view empty_array,
+  const encode_chunk_fn& encode_chunk,
+  const json_parallel_opts& opts,
+  output_buffer* out,
+  int fd
+) {
+
+  array_sink sink(out, fd);
+
+  if (size == 0) {
+    sink.write({ empty_array });
+    return sink.result();
+  }
+
+  const std::string_view open = "[";
+  const std::string_view close = pretty ? "\n]" : "]";
+
+  std::size_t thread_count = opts.threads;
+  if (thread_count == 0) {
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  const auto chunk_size = std::max<std::size_t>(opts.chunk_size, 1);
+  const auto chunk_count = (size + chunk_size - 1) / chunk_size;
+
+  if (thread_count == 1 || chunk_count == 1) {
+    if (out != nullptr) {
+      out->write(open);
+      encode_chunk(0, size, *out);
+      out->write(close);
+      return right();
+    }
+    output_buffer buffer(fd);
+    buffer.write(open);
+    encode_chunk(0, size, buffer);
+    buffer.write(close);
+    buffer.flush();
+    if (buffer.error()) {
+      return left(buffer.error());
+    }
+    return right();
+  }
+
+  // Chunk `i` is encoded into slot `i % window`. Workers run at most this
+  // many chunks ahead of the writer, which bounds the memory that is used.
+  const std::size_t window = thread_count * 4;
+  std::vector<chunk_slot> slots(window);
+
+  std::mutex mutex;
+  std::condition_variable chunk_done;
+  std::condition_variable slot_free;
+  std::size_t next_chunk = 0;
+  std::size_t next_write = 0;
+  bool stopped = false;
+  std::exception_ptr failure;
+
+  auto run = [&] {
+    for (;;) {
+      std::size_t index;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        slot_free.wait(lock, [&] {
+          return stopped || next_chunk == chunk_count || next_chunk < next_write + window;
+        });
+        if (stopped || next_chunk == chunk_count) {
+          return;
+        }
+        index = next_chunk++;
+      }
+      // No other thread touches the slot until it is marked as done
+      auto& slot = slots[index % window];
+      auto begin = index * chunk_size;
+      try {
+        encode_chunk(begin, std::min(begin + chunk_size, size), slot.buffer);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!failure) {
+          failure = std::current_exception();
+        }
+        stopped = true;
+        chunk_done.notify_all();
+        slot_free.notify_all();
+        return;
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        slot.done = true;
+      }
+      chunk_done.notify_all();
+    }
+  };
+
+  // Also stops the workers if writing throws, so that no thread is left
+  // joinable
+  worker_threads workers(mutex, stopped, chunk_done, slot_free);
+  workers.start(thread_count, run);
+
+  std::vector<std::string_view> pieces;
+
+  while (next_write < chunk_count) {
+
+    std::size_t first = next_write;
+    std::size_t last = first;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      chunk_done.wait(lock, [&] { return stopped || slots[first % window].done; });
+      if (stopped) {
+        break;
+      }
+      // Everything that is ready goes out in a single call
+      while (last < chunk_count && last < first + window && slots[last % window].done) {
+        ++last;
+      }
+    }
+
+    pieces.clear();
+    if (first == 0) {
+      pieces.push_back(open);
+    }
+    for (auto i = first; i < last; ++i) {
+      pieces.push_back(slots[i % window].buffer.view());
+    }
+    if (last == chunk_count) {
+      pieces.push_back(close);
+    }
+    sink.write(pieces);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (auto i = first; i < last; ++i) {
+        auto& slot = slots[i % window];
+        slot.buffer.clear();
+        slot.done = false;
+      }
+      next_write = last;
+      if (sink.failed()) {
+        stopped = true;
+      }
+    }
+    slot_free.notify_all();
+
+  }
+
+  // Every chunk was written or the workers stopped, so this only waits
+  workers.join();
+
+  if (failure) {
+    std::rethrow_exception(failure);
+  }
+
+  return sink.result();
+}
+
+static json_write_result print_array_parallel(
+  const array& elements,
+  const json_print_opts& print_opts,
+  const json_parallel_opts& opts,
+  output_buffer* out,
+  int fd
+) {
+  return json_detail::write_array_parallel(
+    elements.size(),
+    !print_opts.indentation.empty(),
+    "[]",
+    [&](std::size_t begin, std::size_t end, output_buffer& chunk) {
+      json_detail::print_elements(elements.data() + begin, elements.data() + end, chunk, print_opts, begin == 0);
+    },
+    opts,
+    out,
+    fd
+  );
+}
+
+void print_parallel(
+  const value& v,
+  output_buffer& out,
+  const json_print_opts& print_opts,
+  const json_parallel_opts& opts
+) {
+  if (!v.is_array()) {
+    print(v, out, print_opts);
+    return;
+  }
+  print_array_parallel(v.as_array(), print_opts, opts, &out, -1);
+}
+
+json_write_result print_parallel(
+  const value& v,
+  int fd,
+  const json_print_opts& print_opts,
+  const json_parallel_opts& opts
+) {
+  if (!v.is_array()) {
+    output_buffer buffer(fd);
+    print(v, buffer, print_opts);
+    buffer.flush();
+    if (buffer.error()) {
+      return left(buffer.error());
+    }
+    return right();
+  }
+  return print_array_parallel(v.as_array(), print_opts, opts, nullptr, fd);
+}
+
+ZEN_NAMESPACE_END
@@ -0,0 +1,755 @@
+
+#include <algorithm>
+#include <functional>
+
+#include "zen/hash.hpp"
+#include "zen/json_path.hpp"
+
+#include "json_tokenizer.hpp"
+
+ZEN_NAMESPACE_START
+
+static json_path_step make_member_step(std::string_view key) {
+  json_path_step step;
+  step.kind = json_path_step_kind::member;
+  json_detail::decode_utf8(key, step.key);
+  step.hash = string_hash{}(step.key);
+  return step;
+}
+
+static json_path_step make_index_step(std::ptrdiff_t index) {
+  json_path_step step;
+  step.kind = json_path_step_kind::index;
+  step.index = index;
+  return step;
+}
+
+static json_path_step make_wildcard_step() {
+  json_path_step step;
+  step.kind = json_path_step_kind::wildcard;
+  return step;
+}
+
+/// Parse a sequence of decimal digits without a leading zero into `out`.
+static bool parse_index(std::string_view digits, std::ptrdiff_t& out) {
+  if (digits.empty() || (digits[0] == '0' && digits.size() > 1)) {
+    return false;
+  }
+  std::ptrdiff_t n = 0;
+  for (auto ch: digits) {
+    if (!json_detail::is_json_digit(ch)) {
+      return false;
+    }
+    if (n > (PTRDIFF_MAX - 9) / 10) {
+      return false;
+    }
+    n = n * 10 + (ch - '0');
+  }
+  out = n;
+  return true;
+}
+
+/// Resolve a possibly negative index against an array of size `size`.
+static const value* get_element(const value::array& array, std::ptrdiff_t index) {
+  auto size = static_cast<std::ptrdiff_t>(array.size());
+  if (index < 0) {
+    index += size;
+  }
+  if (index < 0 || index >= size) {
+    return nullptr;
+  }
+  return &array[index];
+}
+
+/// Get the value that a member or index step leads to.
+static const value* apply_step(const json_path_step& step, const value& v) {
+  switch (step.kind) {
+    case json_path_step_kind::member:
+      if (v.is_object()) {
+        auto& object = v.as_object();
+        auto match = object.find(step.key, step.hash);
+        return match == object.end() ? nullptr : &match->second;
+      }
+      if (v.is_array() && step.has_index) {
+        return get_element(v.as_array(), step.index);
+      }
+      return nullptr;
+    case json_path_step_kind::index:
+      if (v.is_array()) {
+        return get_element(v.as_array(), step.index);
+      }
+      return nullptr;
+    default:
+      ZEN_UNREACHABLE
+  }
+}
+
+/// Call `callback` with every value selected by `steps[i..]` starting from
+/// `v`. Stops as soon as `callback` returns false.
+static bool walk(
+  const std::vector<json_path_step>& steps,
+  std::size_t i,
+  const value& v,
+  const std::function<bool(const value&)>& callback
+) {
+  const value* curr = &v;
+  for (; i < steps.size(); ++i) {
+    auto& step = steps[i];
+    if (step.kind == json_path_step_kind::wildcard) {
+      if (curr->is_object()) {
+        for (auto& [key, member]: curr->as_object()) {
+          if (!walk(steps, i + 1, member, callback)) {
+            return false;
+          }
+        }
+      } else if (curr->is_array()) {
+        for (auto& element: curr->as_array()) {
+          if (!walk(steps, i + 1, element, callback)) {
+            return false;
+          }
+        }
+      }
+      return true;
+    }
+    curr = apply_step(step, *curr);
+    if (curr == nullptr) {
+      return true;
+    }
+  }
+  return callback(*curr);
+}
+
+bool json_path::is_singular() const noexcept {
+  for (auto& step: steps) {
+    if (step.kind == json_path_step_kind::wildcard) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const value* json_path::find(const value& root) const {
+  const value* out = nullptr;
+  walk(steps, 0, root, [&](const value& v) {
+    out = &v;
+    return false;
+  });
+  return out;
+}
+
+void json_path::evaluate(const value& root, std::vector<const value*>& out) const {
+  walk(steps, 0, root, [&](const value& v) {
+    out.push_back(&v);
+    return true;
+  });
+}
+
+json_path_result compile_json_pointer(std::string_view pointer) {
+  std::vector<json_path_step> steps;
+  if (pointer.empty()) {
+    return right(json_path(std::move(steps)));
+  }
+  if (pointer[0] != '/') {
+    return left(json_path_error::unexpected_character);
+  }
+  std::size_t start = 1;
+  for (;;) {
+    auto end = pointer.find('/', start);
+    if (end == std::string_view::npos) {
+      end = pointer.size();
+    }
+    auto token = pointer.substr(start, end - start);
+    std::string key;
+    key.reserve(token.size());
+    for (std::size_t i = 0; i < token.size(); ++i) {
+      if (token[i] != '~') {
+        key.push_back(token[i]);
+        continue;
+      }
+      if (i + 1 == token.size()) {
+        return left(json_path_error::invalid_escape_sequence);
+      }
+      switch (token[++i]) {
+        case '0':
+          key.push_back('~');
+          break;
+        case '1':
+          key.push_back('/');
+          break;
+        default:
+          return left(json_path_error::invalid_escape_sequence);
+      }
+    }
+    auto step = make_member_step(key);
+    step.has_index = parse_index(key, step.index);
+    steps.push_back(std::move(step));
+    if (end == pointer.size()) {
+      break;
+    }
+    start = end + 1;
+  }
+  return right(json_path(std::move(steps)));
+}
+
+json_path_result compile_json_path(std::string_view path) {
+
+  std::vector<json_path_step> steps;
+
+  if (path.empty() || path[0] != '$') {
+    return left(json_path_error::unexpected_character);
+  }
+
+  std::size_t i = 1;
+
+  auto skip_spaces = [&] {
+    while (i < path.size() && path[i] == ' ') {
+      ++i;
+    }
+  };
+
+  while (i < path.size()) {
+
+    if (path[i] == '.') {
+      ++i;
+      if (i < path.size() && path[i] == '*') {
+        ++i;
+        steps.push_back(make_wildcard_step());
+        continue;
+      }
+      auto start = i;
+      while (i < path.size() && path[i] != '.' && path[i] != '[') {
+        ++i;
+      }
+      // Also rejects recursive descent, which is not supported
+      if (i == start) {
+        return left(json_path_error::unexpected_character);
+      }
+      steps.push_back(make_member_step(path.substr(start, i - start)));
+      continue;
+    }
+
+    if (path[i] != '[') {
+      return left(json_path_error::unexpected_character);
+    }
+
+    ++i;
+    skip_spaces();
+
+    if (i == path.size()) {
+      return left(json_path_error::unexpected_character);
+    }
+
+    auto ch = path[i];
+
+    if (ch == '*') {
+      ++i;
+      steps.push_back(make_wildcard_step());
+    } else if (ch == '\'' || ch == '"') {
+      auto quote = ch;
+      ++i;
+      std::string key;
+      for (;;) {
+        if (i == path.size()) {
+          return left(json_path_error::unterminated_string);
+        }
+        auto c1 = path[i++];
+        if (c1 == quote) {
+          break;
+        }
+        if (c1 != '\\') {
+          key.push_back(c1);
+          continue;
+        }
+        if (i == path.size()) {
+          return left(json_path_error::unterminated_string);
+        }
+        switch (auto c2 = path[i++]) {
+          case '\\':
+          case '/':
+          case '\'':
+          case '"':
+            key.push_back(c2);
+            break;
+          case 'b':
+            key.push_back('\b');
+            break;
+          case 'f':
+            key.push_back('\f');
+            break;
+          case 'n':
+            key.push_back('\n');
+            break;
+          case 'r':
+            key.push_back('\r');
+            break;
+          case 't':
+            key.push_back('\t');
+            break;
+          default:
+            return left(json_path_error::invalid_escape_sequence);
+        }
+      }
+      steps.push_back(make_member_step(key));
+    } else if (ch == '-' || json_detail::is_json_digit(ch)) {
+      bool negative = ch == '-';
+      if (negative) {
+        ++i;
+      }
+      auto start = i;
+      while (i < path.size() && json_detail::is_json_digit(path[i])) {
+        ++i;
+      }
+      std::ptrdiff_t index;
+      if (!parse_index(path.substr(start, i - start), index)) {
+        return left(json_path_error::invalid_index);
+      }
+      steps.push_back(make_index_step(negative ? -index : index));
+    } else {
+      return left(json_path_error::unexpected_character);
+    }
+
+    skip_spaces();
+
+    if (i == path.size() || path[i] != ']') {
+      return left(json_path_error::unexpected_character);
+    }
+    ++i;
+  }
+
+  return right(json_path(std::move(steps)));
+}
+
+std::size_t json_query_set::find_step(const node& n, const json_path_step& step) {
+  auto [begin, end] = n.member_lookup.equal_range(step.hash);
+  for (auto iter = begin; iter != end; ++iter) {
+    auto& [other, child] = n.members[iter->second];
+    if (other.key == step.key
+        && other.has_index == step.has_index
+        && (!step.has_index || other.index == step.index)) {
+      return child;
+    }
+  }
+  return 0;
+}
+
+json_query_set::json_query_set() {
+  // The root node
+  nodes.emplace_back();
+}
+
+std::size_t json_query_set::add(const json_path& path) {
+  std::size_t curr = 0;
+  for (auto& step: path.steps) {
+    std::size_t next = 0;
+    switch (step.kind) {
+      case json_path_step_kind::member:
+      {
+        next = find_step(nodes[curr], step);
+        if (next == 0) {
+          next = nodes.size();
+          nodes[curr].member_lookup.emplace(step.hash, nodes[curr].members.size());
+          nodes[curr].members.emplace_back(step, next);
+          nodes.emplace_back();
+        }
+        break;
+      }
+      case json_path_step_kind::index:
+      {
+        for (auto& [index, child]: nodes[curr].indices) {
+          if (index == step.index) {
+            next = child;
+            break;
+          }
+        }
+        if (next == 0) {
+          next = nodes.size();
+          nodes[curr].indices.emplace_back(step.index, next);
+          nodes.emplace_back();
+        }
+        break;
+      }
+      case json_path_step_kind::wildcard:
+        next = nodes[curr].wildcard;
+        if (next == 0) {
+          next = nodes.size();
+          nodes[curr].wildcard = next;
+          nodes.emplace_back();
+        }
+        break;
+    }
+    curr = next;
+  }
+  nodes[curr].terminals.push_back(path_count);
+  return path_count++;
+}
+
+void json_query_set::evaluate_node(
+  std::size_t node_index,
+  const value& v,
+  std::vector<std::vector<const value*>>& results
+) const {
+
+  for (auto path: nodes[node_index].terminals) {
+    results[path].push_back(&v);
+  }
+
+  evaluate_children(node_index, v, results);
+}
+
+void json_query_set::evaluate_children(
+  std::size_t node_index,
+  const value& v,
+  std::vector<std::vector<const value*>>& results
+) const {
+
+  auto& n = nodes[node_index];
+
+  if (v.is_object()) {
+    auto& object = v.as_object();
+    if (!n.members.empty()) {
+      // Look up whichever side is smaller in the other one
+      if (n.members.size() <= object.size()) {
+        for (auto& [step, child]: n.members) {
+          auto match = object.find(step.key, step.hash);
+          if (match != object.end()) {
+            evaluate_node(child, match->second, results);
+          }
+        }
+      } else {
+        for (auto iter = object.begin(); iter != object.end(); ++iter) {
+          auto& [key, member] = *iter;
+          for_each_member(n, key, key.hash(), [&](std::size_t, std::size_t child) {
+            // Like a lookup, only the first member with a key is selected
+            if (object.find(key, key.hash()) == iter) {
+              evaluate_node(child, member, results);
+            }
+          });
+        }
+      }
+    }
+    if (n.wildcard) {
+      for (auto& [key, member]: object) {
+        evaluate_node(n.wildcard, member, results);
+      }
+    }
+    return;
+  }
+
+  if (v.is_array()) {
+    auto& array = v.as_array();
+    for (auto& [step, child]: n.members) {
+      if (step.has_index) {
+        if (auto element = get_element(array, step.index)) {
+          evaluate_node(child, *element, results);
+        }
+      }
+    }
+    for (auto& [index, child]: n.indices) {
+      if (auto element = get_element(array, index)) {
+        evaluate_node(child, *element, results);
+      }
+    }
+    if (n.wildcard) {
+      for (auto& element: array) {
+        evaluate_node(n.wildcard, element, results);
+      }
+    }
+  }
+
+}
+
+void json_query_set::evaluate(
+  const value& root,
+  std::vector<std::vector<const value*>>& results
+) const {
+  results.resize(path_count);
+  for (auto& matches: results) {
+    matches.clear();
+  }
+  evaluate_node(0, root, results);
+}
+
+/// Walks the raw input along the tree of a json_query_set.
+class json_path_extractor {
+
+  using node = json_query_set::node;
+
+  const json_query_set& paths;
+  json_parse_opts opts;
+  const unsigned char* end;
+
+  std::vector<std::vector<value>>& results;
+
+  // Buffers that are reused between calls
+  std::string scratch;
+  string key;
+  std::vector<std::vector<const value*>> matches;
+  std::vector<const unsigned char*> elements;
+
+  // The nodes that the member steps for the key of the current member of
+  // each object that is being walked lead to
+  std::vector<std::size_t> members;
+
+  // The member steps that have already selected a member of each object
+  // that is being walked, so that later members with the same key are
+  // skipped like a lookup would
+  std::vector<std::size_t> matched;
+
+public:
+
+  json_parse_error error = json_parse_error::unexpected_character;
+
+  json_path_extractor(
+    const json_query_set& paths,
+    json_parse_opts opts,
+    const unsigned char* end,
+    std::vector<std::vector<value>>& results
+  ): paths(paths), opts(opts), end(end), results(results) {}
+
+  const unsigned char* skip_whitespace(const unsigned char* curr) {
+    while (curr != end && json_detail::is_json_whitespace(*curr)) {
+      ++curr;
+    }
+    return curr;
+  }
+
+  /// Build the value at `curr` and hand it to every path that reaches it.
+  const unsigned char* materialize(const node& n, std::size_t node_index, const unsigned char* curr) {
+
+    auto value_end = json_detail::skip_value(curr, end);
+    if (value_end == nullptr) {
+      return nullptr;
+    }
+
+    auto parsed = parse_json(reinterpret_cast<const char*>(curr), value_end - curr, opts);
+    if (parsed.is_left()) {
+      error = parsed.left();
+      return nullptr;
+    }
+    auto v = std::move(parsed).unwrap();
+
+    // Paths that continue below this node are evaluated on the value that
+    // was just built.
+    if (!n.members.empty() || !n.indices.empty() || n.wildcard) {
+      matches.resize(paths.path_count);
+      paths.evaluate_children(node_index, v, matches);
+      for (std::size_t i = 0; i < matches.size(); ++i) {
+        for (auto match: matches[i]) {
+          results[i].push_back(*match);
+        }
+        matches[i].clear();
+      }
+    }
+
+    auto last = n.terminals.size() - 1;
+    for (std::size_t i = 0; i < last; ++i) {
+      results[n.terminals[i]].push_back(v);
+    }
+    results[n.terminals[last]].push_back(std::move(v));
+
+    return value_end;
+  }
+
+  const unsigned char* walk_object(const node& n, const unsigned char* curr) {
+
+    curr = skip_whitespace(curr + 1);
+    if (curr != end && *curr == '}') {
+      return curr + 1;
+    }
+
+    auto matched_start = matched.size();
+
+    for (;;) {
+
+      if (curr == end || *curr != '"') {
+        return nullptr;
+      }
+      ++curr;
+
+      auto members_start = members.size();
+      if (n.member_lookup.empty()) {
+        curr = json_detail::skip_string(curr, end);
+        if (curr == nullptr) {
+          return nullptr;
+        }
+      } else {
+        std::string_view raw;
+        if (!json_detail::scan_string(curr, end, scratch, raw, error)) {
+          return nullptr;
+        }
+        key.clear();
+        json_detail::decode_utf8(raw, key);
+        json_query_set::for_each_member(n, key, string_hash{}(key), [&](std::size_t step, std::size_t child) {
+          if (std::find(matched.begin() + matched_start, matched.end(), step) == matched.end()) {
+            matched.push_back(step);
+            members.push_back(child);
+          }
+        });
+      }
+
+      curr = skip_whitespace(curr);
+      if (curr == end || *curr != ':') {
+        return nullptr;
+      }
+      curr = skip_whitespace(curr + 1);
+
+      const unsigned char* value_end;
+      if (members.size() == members_start && n.wildcard == 0) {
+        value_end = json_detail::skip_value(curr, end);
+      } else {
+        value_end = curr;
+        for (auto i = members_start; i < members.size() && value_end != nullptr; ++i) {
+          value_end = walk(members[i], curr);
+        }
+        if (value_end != nullptr && n.wildcard != 0) {
+          value_end = walk(n.wildcard, curr);
+        }
+      }
+      members.resize(members_start);
+      if (value_end == nullptr) {
+        return nullptr;
+      }
+
+      curr = skip_whitespace(value_end);
+      if (curr == end) {
+        return nullptr;
+      }
+      if (*curr == '}') {
+        matched.resize(matched_start);
+        return curr + 1;
+      }
+      if (*curr != ',') {
+        return nullptr;
+      }
+      curr = skip_whitespace(curr + 1);
+    }
+  }
+
+  const unsigned char* walk_array(const node& n, const unsigned char* curr) {
+
+    // Elements that are counted from the end can only be found once the
+    // size of the array is known, so remember where every element starts.
+    bool has_negative = false;
+    for (auto& [index, child]: n.indices) {
+      has_negative |= index < 0;
+    }
+    auto elements_start = elements.size();
+
+    curr = skip_whitespace(curr + 1);
+
+    std::ptrdiff_t i = 0;
+
+    if (curr != end && *curr == ']') {
+      ++curr;
+    } else {
+      for (;; ++i) {
+
+        if (has_negative) {
+          elements.push_back(curr);
+        }
+
+        const unsigned char* value_end = curr;
+        bool visited = false;
+        for (auto& [step, child]: n.members) {
+          if (step.has_index && step.index == i && value_end != nullptr) {
+            value_end = walk(child, curr);
+            visited = true;
+          }
+        }
+        for (auto& [index, child]: n.indices) {
+          if (index == i && value_end != nullptr) {
+            value_end = walk(child, curr);
+            visited = true;
+          }
+        }
+        if (n.wildcard && value_end != nullptr) {
+          value_end = walk(n.wildcard, curr);
+          visited = true;
+        }
+        if (!visited) {
+          value_end = json_detail::skip_value(curr, end);
+        }
+        if (value_end == nullptr) {
+          return nullptr;
+        }
+
+        curr = skip_whitespace(value_end);
+        if (curr == end) {
+          return nullptr;
+        }
+        if (*curr == ']') {
+          ++curr;
+          ++i;
+          break;
+        }
+        if (*curr != ',') {
+          return nullptr;
+        }
+        curr = skip_whitespace(curr + 1);
+      }
+    }
+
+    if (has_negative) {
+      for (auto& [index, child]: n.indices) {
+        if (index < 0 && index + i >= 0) {
+          if (walk(child, elements[elements_start + index + i]) == nullptr) {
+            return nullptr;
+          }
+        }
+      }
+      elements.resize(elements_start);
+    }
+
+    return curr;
+  }
+
+  /// Visit the value at `curr` with the given node of the query tree,
+  /// returning a pointer past the end of the value or `nullptr` on failure.
+  const unsigned char* walk(std::size_t node_index, const unsigned char* curr) {
+    auto& n = paths.nodes[node_index];
+    if (!n.terminals.empty()) {
+      return materialize(n, node_index, curr);
+    }
+    if (curr != end) {
+      if (*curr == '{' && (!n.members.empty() || n.wildcard)) {
+        return walk_object(n, curr);
+      }
+      if (*curr == '[' && (!n.members.empty() || !n.indices.empty() || n.wildcard)) {
+        return walk_array(n, curr);
+      }
+    }
+    return json_detail::skip_value(curr, end);
+  }
+
+};
+
+json_extract_result parse_json_paths(
+  const char* data,
+  std::size_t size,
+  const json_query_set& paths,
+  json_parse_opts opts
+) {
+  std::vector<std::vector<value>> results(paths.size());
+  auto curr = reinterpret_cast<const unsigned char*>(data);
+  auto end = curr + size;
+  json_path_extractor extractor(paths, opts, end, results);
+  curr = extractor.skip_whitespace(curr);
+  curr = extractor.walk(0, curr);
+  if (curr == nullptr) {
+    return left(extractor.error);
+  }
+  if (extractor.skip_whitespace(curr) != end) {
+    return left(json_parse_error::unexpected_character);
+  }
+  return right(std::move(results));
+}
+
+json_extract_result parse_json_paths(
+  std::string_view in,
+  const json_query_set& paths,
+  json_parse_opts opts
+) {
+  return parse_json_paths(in.data(), in.size(), paths, opts);
+}
+
+ZEN_NAMESPACE_END
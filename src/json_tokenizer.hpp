@@ -0,0 +1,1277 @@
+#ifndef ZEN_JSON_TOKENIZER_HPP
+#define ZEN_JSON_TOKENIZER_HPP
+
+// This header is private to the library. It contains the tokenizer that is
+// shared by all functions that read JSON, so that they can instantiate it
+// with their own handler.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "zen/char.hpp"
+#include "zen/config.hpp"
+#include "zen/json.hpp"
+#include "zen/simd.hpp"
+
+ZEN_NAMESPACE_START
+
+namespace json_detail {
+
+inline bool is_json_whitespace(int ch) {
+  switch (ch) {
+    case ' ':
+    case '\n':
+    case '\r':
+    case '\t':
+      return true;
+    default:
+      return false;
+  }
+}
+
+inline bool is_json_digit(int ch) {
+  return ch >= '0' && ch <= '9';
+}
+
+/// Returns true if `ch` may directly follow a number or a keyword.
+inline bool is_json_terminator(int ch) {
+  switch (ch) {
+    case EOF:
+    case ']':
+    case '}':
+    case ',':
+    case ' ':
+    case '\t':
+    case '\r':
+    case '\n':
+      return true;
+    default:
+      return false;
+  }
+}
+
+/// Hands out the tokens of a contiguous buffer one character at a time,
+/// skipping any whitespace in between.
+class buffer_cursor {
+
+  const unsigned char* curr;
+  const unsigned char* end;
+
+public:
+
+  buffer_cursor(const unsigned char* begin, const unsigned char* end):
+    curr(begin), end(end) {}
+
+  /// Get the next character that is not whitespace and move past it.
+  int next() {
+    for (;;) {
+      if (curr == end) {
+        return EOF;
+      }
+      int ch = *curr++;
+      if (!is_json_whitespace(ch)) {
+        return ch;
+      }
+    }
+  }
+
+  /// Get the next character that is not whitespace without moving past it.
+  int peek() {
+    for (;;) {
+      if (curr == end) {
+        return EOF;
+      }
+      int ch = *curr;
+      if (!is_json_whitespace(ch)) {
+        return ch;
+      }
+      ++curr;
+    }
+  }
+
+  /// The position right after the character that was last returned by
+  /// next(). Tokens that span multiple characters are scanned by advancing
+  /// this pointer directly.
+  const unsigned char*& position() {
+    return curr;
+  }
+
+  const unsigned char* limit() const {
+    return end;
+  }
+
+  /// Must be called after position() has been advanced.
+  void sync() {}
+
+};
+
+/// Hands out the tokens of a contiguous buffer by walking over a
+/// precomputed index of structural characters.
+class index_cursor {
+
+  const unsigned char* data;
+  const unsigned char* curr;
+  const unsigned char* end;
+  const std::uint32_t* index;
+  const std::uint32_t* index_end;
+
+public:
+
+  index_cursor(
+    const unsigned char* data,
+    std::size_t size,
+    const std::vector<std::uint32_t>& offsets
+  ): data(data),
+     curr(data),
+     end(data + size),
+     index(offsets.data()),
+     index_end(offsets.data() + offsets.size()) {}
+
+  int next() {
+    if (index == index_end) {
+      curr = end;
+      return EOF;
+    }
+    curr = data + *index++;
+    return *curr++;
+  }
+
+  int peek() {
+    return index == index_end ? EOF : data[*index];
+  }
+
+  const unsigned char*& position() {
+    return curr;
+  }
+
+  const unsigned char* limit() const {
+    return end;
+  }
+
+  void sync() {
+    // Drop every entry that was covered by the token that was just scanned,
+    // such as the closing quote of a string.
+    while (index != index_end && data + *index < curr) {
+      ++index;
+    }
+  }
+
+};
+
+enum class number_kind {
+  invalid,
+  integer,
+  fractional,
+};
+
+/// Convert `w * 10^q` to the nearest double. Returns false in the rare case
+/// that the result cannot be determined from the 64-bit mantissa alone.
+bool decimal_to_double(std::uint64_t w, std::int64_t q, bool negative, fractional& out);
+
+/// Convert the number in the given range using exact arithmetic, returning
+/// `estimate` if the number cannot be represented.
+fractional parse_fractional_exact(const char* begin, const char* end, fractional estimate);
+
+/// Only this many significant digits are kept in the mantissa of a number.
+static constexpr const int max_mantissa_digits = 19;
+
+/// Scan the remainder of a number of which the first character `c0` has
+/// already been consumed.
+///
+/// Numbers without a fraction or exponent become integers, unless they don't
+/// fit in a bigint. Everything else is converted to the nearest fractional.
+inline number_kind scan_number(
+  int c0,
+  const unsigned char*& curr,
+  const unsigned char* end,
+  bigint& integer,
+  fractional& fraction
+) {
+
+  auto start = curr - 1;
+
+  bool negative = c0 == '-';
+  if (negative) {
+    if (curr == end || !is_json_digit(*curr)) {
+      return number_kind::invalid;
+    }
+    c0 = *curr++;
+  }
+
+  // The value of the number is mantissa * 10^exponent, where the mantissa
+  // holds at most max_mantissa_digits significant digits.
+  std::uint64_t mantissa = 0;
+  std::int64_t exponent = 0;
+  int digits = 0;
+  bool truncated = false;
+  bool is_integer = true;
+
+  auto add_digit = [&](int d, bool after_point) {
+    if (digits == 0 && d == 0) {
+      if (after_point) {
+        --exponent;
+      }
+      return;
+    }
+    if (digits < max_mantissa_digits) {
+      mantissa = mantissa * 10 + d;
+      ++digits;
+      if (after_point) {
+        --exponent;
+      }
+    } else {
+      truncated |= d != 0;
+      if (!after_point) {
+        ++exponent;
+      }
+    }
+  };
+
+  add_digit(c0 - '0', false);
+
+  if (c0 == '0') {
+    // Leading zeros are not allowed
+    if (curr != end && is_json_digit(*curr)) {
+      return number_kind::invalid;
+    }
+  } else {
+    while (curr != end && is_json_digit(*curr)) {
+      add_digit(*curr - '0', false);
+      ++curr;
+    }
+  }
+
+  if (curr != end && *curr == '.') {
+    ++curr;
+    is_integer = false;
+    if (curr == end || !is_json_digit(*curr)) {
+      return number_kind::invalid;
+    }
+    do {
+      add_digit(*curr - '0', true);
+      ++curr;
+    } while (curr != end && is_json_digit(*curr));
+  }
+
+  if (curr != end && (*curr == 'e' || *curr == 'E')) {
+    ++curr;
+    is_integer = false;
+    bool negative_exponent = false;
+    if (curr != end && (*curr == '+' || *curr == '-')) {
+      negative_exponent = *curr == '-';
+      ++curr;
+    }
+    if (curr == end || !is_json_digit(*curr)) {
+      return number_kind::invalid;
+    }
+    std::int64_t e = 0;
+    do {
+      // Anything this large is out of range anyway
+      if (e < 1000000000) {
+        e = e * 10 + (*curr - '0');
+      }
+      ++curr;
+    } while (curr != end && is_json_digit(*curr));
+    exponent += negative_exponent ? -e : e;
+  }
+
+  if (curr != end && !is_json_terminator(*curr)) {
+    return number_kind::invalid;
+  }
+
+  if (is_integer && exponent == 0) {
+    constexpr const auto max = static_cast<std::uint64_t>(std::numeric_limits<bigint>::max());
+    if (mantissa <= max) {
+      integer = negative ? -static_cast<bigint>(mantissa) : static_cast<bigint>(mantissa);
+      return number_kind::integer;
+    }
+    if (negative && mantissa == max + 1) {
+      integer = std::numeric_limits<bigint>::min();
+      return number_kind::integer;
+    }
+  }
+
+  // When digits were dropped, the exact value lies between the truncated
+  // mantissa and the next one. If both round to the same double, that is the
+  // answer.
+  fractional lower = 0;
+  if (decimal_to_double(mantissa, exponent, negative, lower)) {
+    fractional upper;
+    if (!truncated || (decimal_to_double(mantissa + 1, exponent, negative, upper) && upper == lower)) {
+      fraction = lower;
+      return number_kind::fractional;
+    }
+  }
+
+  fraction = parse_fractional_exact(
+    reinterpret_cast<const char*>(start),
+    reinterpret_cast<const char*>(curr),
+    lower
+  );
+  return number_kind::fractional;
+}
+
+/// Convert UTF-8 to the code points that make up a zen::string.
+///
+/// Bytes that do not form a valid sequence become U+FFFD, like they do in
+/// zen::utf8_code_points.
+void decode_utf8(std::string_view in, string& out);
+
+/// Get UTF-8 in which the bytes of `in` that do not form a valid sequence
+/// are replaced the same way as by decode_utf8(), so that UTF-8 strings and
+/// keys agree with their decoded counterparts.
+///
+/// Returns `in` itself if it is valid, and otherwise the text in `scratch`.
+std::string_view replace_invalid_utf8(std::string_view in, std::string& scratch);
+
+inline void append_utf8(std::string& out, std::uint32_t code) {
+  if (code < 0x80) {
+    out.push_back(static_cast<char>(code));
+  } else if (code < 0x800) {
+    out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+    out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+  } else if (code < 0x10000) {
+    out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+    out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+  } else {
+    out.push_back(static_cast<char>(0xF0 | (code >> 18)));
+    out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+  }
+}
+
+inline int parse_hex_digit(int ch) {
+  if (ch >= '0' && ch <= '9') {
+    return ch - '0';
+  }
+  if (ch >= 'a' && ch <= 'f') {
+    return ch - 'a' + 10;
+  }
+  if (ch >= 'A' && ch <= 'F') {
+    return ch - 'A' + 10;
+  }
+  return -1;
+}
+
+/// Read the four hexadecimal digits of a `\u` escape.
+inline bool scan_hex4(const unsigned char*& curr, const unsigned char* end, std::uint32_t& out) {
+  if (end - curr < 4) {
+    return false;
+  }
+  std::uint32_t code = 0;
+  for (std::size_t i = 0; i < 4; ++i) {
+    auto digit = parse_hex_digit(curr[i]);
+    if (digit < 0) {
+      return false;
+    }
+    code = (code << 4) | digit;
+  }
+  curr += 4;
+  out = code;
+  return true;
+}
+
+/// Read the code point of a `\u` escape of which the `\u` has already been
+/// consumed.
+///
+/// Characters outside of the Basic Multilingual Plane are written as a
+/// surrogate pair of two escapes, which is combined into one code point. A
+/// surrogate that is not part of a pair is rejected.
+inline bool scan_unicode_escape(const unsigned char*& curr, const unsigned char* end, std::uint32_t& out) {
+  std::uint32_t high;
+  if (!scan_hex4(curr, end, high)) {
+    return false;
+  }
+  if (high < 0xD800 || high > 0xDFFF) {
+    out = high;
+    return true;
+  }
+  if (high > 0xDBFF || end - curr < 2 || curr[0] != '\\' || curr[1] != 'u') {
+    return false;
+  }
+  curr += 2;
+  std::uint32_t low;
+  if (!scan_hex4(curr, end, low) || low < 0xDC00 || low > 0xDFFF) {
+    return false;
+  }
+  out = 0x10000 + ((high - 0xD800) << 10) + (low - 0xDC00);
+  return true;
+}
+
+/// Scan the remainder of a string of which the opening quote has already been
+/// consumed, including the closing quote.
+///
+/// If the string does not contain any escape sequences, `out` will point
+/// directly into the input. Otherwise, the decoded string is written to
+/// `scratch` and `out` points to that buffer.
+inline bool scan_string(
+  const unsigned char*& curr,
+  const unsigned char* end,
+  std::string& scratch,
+  std::string_view& out,
+  json_parse_error& error
+) {
+
+  const auto start = curr;
+  bool has_escapes = false;
+
+  for (;;) {
+
+    // Skip over the run of characters that need no special treatment in one
+    // go instead of inspecting them one at a time.
+    auto run_start = curr;
+    while (curr != end && *curr != '"' && *curr != '\\' && *curr != '\n') {
+      ++curr;
+    }
+    if (has_escapes) {
+      scratch.append(run_start, curr);
+    }
+
+    if (curr == end || *curr == '\n') {
+      error = json_parse_error::unexpected_character;
+      return false;
+    }
+
+    if (*curr == '"') {
+      if (has_escapes) {
+        out = scratch;
+      } else {
+        out = std::string_view(reinterpret_cast<const char*>(start), curr - start);
+      }
+      ++curr;
+      return true;
+    }
+
+    if (!has_escapes) {
+      has_escapes = true;
+      scratch.assign(start, curr);
+    }
+
+    ++curr;
+
+    if (curr == end) {
+      error = json_parse_error::unrecognised_escape_sequence;
+      return false;
+    }
+
+    switch (*curr++) {
+      case '"':
+        scratch.push_back('"');
+        break;
+      case '\\':
+        scratch.push_back('\\');
+        break;
+      case '/':
+        scratch.push_back('/');
+        break;
+      case 'b':
+        scratch.push_back('\b');
+        break;
+      case 'f':
+        scratch.push_back('\f');
+        break;
+      case 'n':
+        scratch.push_back('\n');
+        break;
+      case 'r':
+        scratch.push_back('\r');
+        break;
+      case 't':
+        scratch.push_back('\t');
+        break;
+      case 'u':
+      {
+        std::uint32_t code;
+        if (!scan_unicode_escape(curr, end, code)) {
+          error = json_parse_error::unrecognised_escape_sequence;
+          return false;
+        }
+        append_utf8(scratch, code);
+        break;
+      }
+      default:
+        error = json_parse_error::unrecognised_escape_sequence;
+        return false;
+    }
+
+  }
+
+}
+
+/// Match the remaining characters of `true`, `false` or `null`.
+inline bool scan_keyword(
+  const unsigned char*& curr,
+  const unsigned char* end,
+  const char* rest
+) {
+  for (; *rest; ++rest, ++curr) {
+    if (curr == end || *curr != *rest) {
+      return false;
+    }
+  }
+  return curr == end || is_json_terminator(*curr);
+}
+
+/// The tokenizer that is shared by all JSON parsing functions.
+///
+/// Reports everything it encounters to `handler` and never builds any values
+/// itself. The only state that is kept is one bit per open container, so
+/// memory use only depends on how deeply the document is nested. Parsing
+/// stops early without an error when a callback returns false.
+template<typename CursorT, typename HandlerT>
+json_events_result parse_events_impl(CursorT& cursor, HandlerT& handler) {
+
+  // One element per open container, which is true for objects
+  std::vector<bool> nesting;
+
+  std::string scratch;
+  std::string_view chars;
+  json_parse_error error;
+  bigint integer;
+  fractional fraction;
+  int c0;
+
+#define ZEN_EMIT(call) \
+  if (!handler.call) { \
+    return right(); \
+  }
+
+#define ZEN_SCAN_STRING() \
+  if (!scan_string(cursor.position(), cursor.limit(), scratch, chars, error)) { \
+    return left(error); \
+  } \
+  cursor.sync();
+
+next_value:
+
+  c0 = cursor.next();
+
+  switch (c0) {
+
+    case '{':
+      ZEN_EMIT(on_object_start());
+      c0 = cursor.next();
+      if (c0 == '}') {
+        ZEN_EMIT(on_object_end());
+        goto value_done;
+      }
+      nesting.push_back(true);
+      goto next_key;
+
+    case '[':
+      ZEN_EMIT(on_array_start());
+      if (cursor.peek() == ']') {
+        cursor.next();
+        ZEN_EMIT(on_array_end());
+        goto value_done;
+      }
+      nesting.push_back(false);
+      goto next_value;
+
+    case '-':
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+      switch (scan_number(c0, cursor.position(), cursor.limit(), integer, fraction)) {
+        case number_kind::integer:
+          cursor.sync();
+          ZEN_EMIT(on_integer(integer));
+          break;
+        case number_kind::fractional:
+          cursor.sync();
+          ZEN_EMIT(on_fractional(fraction));
+          break;
+        case number_kind::invalid:
+          return left(json_parse_error::unexpected_character);
+      }
+      goto value_done;
+
+    case '"':
+      ZEN_SCAN_STRING();
+      ZEN_EMIT(on_string(chars));
+      goto value_done;
+
+    case 'n':
+      if (!scan_keyword(cursor.position(), cursor.limit(), "ull")) {
+        return left(json_parse_error::unexpected_character);
+      }
+      cursor.sync();
+      ZEN_EMIT(on_null());
+      goto value_done;
+
+    case 't':
+      if (!scan_keyword(cursor.position(), cursor.limit(), "rue")) {
+        return left(json_parse_error::unexpected_character);
+      }
+      cursor.sync();
+      ZEN_EMIT(on_boolean(true));
+      goto value_done;
+
+    case 'f':
+      if (!scan_keyword(cursor.position(), cursor.limit(), "alse")) {
+        return left(json_parse_error::unexpected_character);
+      }
+      cursor.sync();
+      ZEN_EMIT(on_boolean(false));
+      goto value_done;
+
+    default:
+      return left(json_parse_error::unexpected_character);
+
+  }
+
+value_done:
+
+  // Close every container that ends right after the value we just got, until
+  // we find one that has more elements.
+  for (;;) {
+
+    if (nesting.empty()) {
+      // The whole buffer is the document, so only whitespace may follow
+      if (cursor.next() != EOF) {
+        return left(json_parse_error::unexpected_character);
+      }
+      return right();
+    }
+
+    c0 = cursor.next();
+
+    if (c0 == ',') {
+      if (nesting.back()) {
+        c0 = cursor.next();
+        goto next_key;
+      }
+      goto next_value;
+    }
+
+    if (c0 != (nesting.back() ? '}' : ']')) {
+      return left(json_parse_error::unexpected_character);
+    }
+
+    if (nesting.back()) {
+      ZEN_EMIT(on_object_end());
+    } else {
+      ZEN_EMIT(on_array_end());
+    }
+    nesting.pop_back();
+
+  }
+
+next_key:
+
+  if (c0 != '"') {
+    return left(json_parse_error::unexpected_character);
+  }
+  ZEN_SCAN_STRING();
+  ZEN_EMIT(on_key(chars));
+  if (cursor.next() != ':') {
+    return left(json_parse_error::unexpected_character);
+  }
+  goto next_value;
+
+#undef ZEN_EMIT
+#undef ZEN_SCAN_STRING
+
+}
+
+/// Stage one of the two-stage parser: record the offset of every structural
+/// character outside of a string, of every quote that delimits a string and
+/// of the first character of every other token.
+inline void build_structural_index(
+  const unsigned char* data,
+  std::size_t size,
+  std::vector<std::uint32_t>& out
+) {
+
+  auto classify = select_classifier();
+
+  std::uint64_t escape_carry = 0;
+  std::uint64_t string_carry = 0;
+  std::uint64_t token_carry = 0;
+
+  unsigned char tail[simd_block_size];
+
+  out.clear();
+  out.reserve(size / 4);
+
+  for (std::size_t offset = 0; offset < size; offset += simd_block_size) {
+
+    auto remaining = size - offset;
+    auto block = remaining >= simd_block_size
+      ? data + offset
+      : load_partial_block(data + offset, remaining, tail);
+
+    block_masks masks;
+    classify(block, masks);
+
+    auto quotes = masks.quote & ~escaped_mask(masks.backslash, escape_carry);
+
+    // Bytes from an opening quote up to but excluding the closing quote
+    auto in_string = prefix_xor(quotes) ^ string_carry;
+    string_carry = static_cast<std::uint64_t>(static_cast<std::int64_t>(in_string) >> 63);
+
+    // Scalars are runs of bytes that are neither whitespace nor operators nor
+    // part of a string. We only need to know where they start.
+    auto scalar = ~(masks.op | masks.whitespace | in_string | quotes);
+    auto scalar_starts = scalar & ~((scalar << 1) | token_carry);
+    token_carry = scalar >> 63;
+
+    auto structurals = (masks.op & ~in_string) | quotes | scalar_starts;
+
+    if (remaining < simd_block_size) {
+      structurals &= (std::uint64_t(1) << remaining) - 1;
+    }
+
+    auto n = out.size();
+    out.resize(n + count_ones(structurals));
+    auto dest = out.data() + n;
+    while (structurals) {
+      *dest++ = static_cast<std::uint32_t>(offset + count_trailing_zeros(structurals));
+      structurals &= structurals - 1;
+    }
+
+  }
+
+}
+
+/// Find the end of a string of which the opening quote has already been
+/// consumed, without decoding it. Returns a pointer past the closing quote,
+/// or `nullptr` if the string is not terminated.
+inline const unsigned char* skip_string(const unsigned char* curr, const unsigned char* end) {
+  for (;;) {
+    auto quote = static_cast<const unsigned char*>(std::memchr(curr, '"', end - curr));
+    if (quote == nullptr) {
+      return nullptr;
+    }
+    // The quote is escaped if it is preceded by an odd amount of backslashes
+    auto p = quote;
+    while (p != curr && p[-1] == '\\') {
+      --p;
+    }
+    if ((quote - p) % 2 == 0) {
+      return quote + 1;
+    }
+    curr = quote + 1;
+  }
+}
+
+/// Find the end of the object or array that starts at `curr` by counting
+/// brackets outside of strings, 64 bytes at a time.
+///
+/// The contents are not validated. Returns a pointer past the closing
+/// bracket, or `nullptr` if the brackets are not balanced.
+inline const unsigned char* skip_container(const unsigned char* curr, const unsigned char* end) {
+
+  static const auto classify = select_classifier();
+
+  std::uint64_t escape_carry = 0;
+  std::uint64_t string_carry = 0;
+  std::size_t depth = 0;
+
+  unsigned char tail[simd_block_size];
+
+  for (; curr < end; curr += simd_block_size) {
+
+    auto remaining = static_cast<std::size_t>(end - curr);
+    auto block = remaining >= simd_block_size
+      ? curr
+      : load_partial_block(curr, remaining, tail);
+
+    block_masks masks;
+    classify(block, masks);
+
+    auto quotes = masks.quote & ~escaped_mask(masks.backslash, escape_carry);
+    auto in_string = prefix_xor(quotes) ^ string_carry;
+    string_carry = static_cast<std::uint64_t>(static_cast<std::int64_t>(in_string) >> 63);
+
+    auto opens = masks.open & ~in_string;
+    auto closes = masks.close & ~in_string;
+
+    // Most blocks cannot close the container, so there is no need to look at
+    // the order of the brackets inside them.
+    auto close_count = count_ones(closes);
+    if (depth > close_count) {
+      depth += count_ones(opens);
+      depth -= close_count;
+      continue;
+    }
+
+    auto brackets = opens | closes;
+    while (brackets) {
+      auto i = count_trailing_zeros(brackets);
+      if (opens & (std::uint64_t(1) << i)) {
+        ++depth;
+      } else if (--depth == 0) {
+        return curr + i + 1;
+      }
+      brackets &= brackets - 1;
+    }
+
+  }
+
+  return nullptr;
+}
+
+/// Find the end of the value that starts at `curr` without building it.
+inline const unsigned char* skip_value(const unsigned char* curr, const unsigned char* end) {
+  if (curr == end) {
+    return nullptr;
+  }
+  switch (*curr) {
+    case '{':
+    case '[':
+      return skip_container(curr, end);
+    case '"':
+      return skip_string(curr + 1, end);
+    case ']':
+    case '}':
+    case ',':
+    case ':':
+      return nullptr;
+    default:
+    {
+      auto start = curr;
+      while (curr != end && !is_json_terminator(*curr) && *curr != ':') {
+        ++curr;
+      }
+      return curr == start ? nullptr : curr;
+    }
+  }
+}
+
+template<typename HandlerT>
+json_events_result run_tokenizer(
+  const char* data,
+  std::size_t size,
+  HandlerT& handler,
+  json_parse_opts opts
+) {
+  auto begin = reinterpret_cast<const unsigned char*>(data);
+  if (opts.structural_index && size <= UINT32_MAX) {
+    std::vector<std::uint32_t> offsets;
+    build_structural_index(begin, size, offsets);
+    index_cursor cursor(begin, size, offsets);
+    return parse_events_impl(cursor, handler);
+  }
+  buffer_cursor cursor(begin, begin + size);
+  return parse_events_impl(cursor, handler);
+}
+
+/// A tokenizer that receives its input in chunks of arbitrary size.
+///
+/// It produces the same events as parse_events_impl(), but instead of a
+/// program counter it keeps an explicit state, so that it can stop at the end
+/// of a chunk and pick up where it left off when the next one arrives. A token
+/// that is cut in two by a chunk boundary is copied to `pending` until it is
+/// complete. All other tokens are scanned directly in the chunk.
+template<typename HandlerT>
+class push_tokenizer {
+
+  enum class expect {
+    /// Any value
+    value,
+    /// Any value or the end of an array, right after `[`
+    value_or_close,
+    /// A key or the end of an object, right after `{`
+    key_or_close,
+    /// A key, after a comma inside an object
+    key,
+    /// The colon between a key and its value
+    colon,
+    /// A comma or the end of the innermost container
+    comma_or_close,
+    /// Nothing but whitespace, after the top-level value
+    end,
+  };
+
+  HandlerT& handler;
+
+  expect state = expect::value;
+
+  // One element per open container, which is true for objects
+  std::vector<bool> nesting;
+
+  // A token that started in an earlier chunk, including its first character
+  std::string pending;
+
+  // Whether `pending` is a string that ends in the middle of an escape
+  bool pending_escape = false;
+
+  std::string scratch;
+
+  json_parse_error error = json_parse_error::unexpected_character;
+
+  bool failed = false;
+
+  // Set when a callback asked to stop. The remaining input is ignored.
+  bool stopped = false;
+
+  bool fail(json_parse_error e = json_parse_error::unexpected_character) {
+    error = e;
+    failed = true;
+    return false;
+  }
+
+  bool stop() {
+    stopped = true;
+    return false;
+  }
+
+  bool value_done() {
+    state = nesting.empty() ? expect::end : expect::comma_or_close;
+    return true;
+  }
+
+  bool close_container(bool is_object) {
+    if (is_object) {
+      if (!handler.on_object_end()) {
+        return stop();
+      }
+    } else {
+      if (!handler.on_array_end()) {
+        return stop();
+      }
+    }
+    nesting.pop_back();
+    return value_done();
+  }
+
+  /// Find the end of the string that continues at `curr`, updating
+  /// `pending_escape` along the way.
+  const unsigned char* find_string_end(const unsigned char* curr, const unsigned char* end) {
+    for (;;) {
+      if (pending_escape) {
+        if (curr == end) {
+          return nullptr;
+        }
+        pending_escape = false;
+        ++curr;
+      }
+      while (curr != end && *curr != '"' && *curr != '\\') {
+        ++curr;
+      }
+      if (curr == end) {
+        return nullptr;
+      }
+      if (*curr++ == '"') {
+        return curr;
+      }
+      pending_escape = true;
+    }
+  }
+
+  /// Find the end of a number or keyword that continues at `curr`.
+  static const unsigned char* find_literal_end(const unsigned char* curr, const unsigned char* end) {
+    while (curr != end && !is_json_terminator(*curr)) {
+      ++curr;
+    }
+    return curr == end ? nullptr : curr;
+  }
+
+  /// Report a token that is known to be complete and to end at `end`.
+  bool emit_token(const unsigned char* curr, const unsigned char* end) {
+
+    int c0 = *curr++;
+
+    switch (c0) {
+
+      case '"':
+      {
+        std::string_view chars;
+        if (!scan_string(curr, end, scratch, chars, error) || curr != end) {
+          return fail(error);
+        }
+        if (state == expect::key || state == expect::key_or_close) {
+          if (!handler.on_key(chars)) {
+            return stop();
+          }
+          state = expect::colon;
+          return true;
+        }
+        if (!handler.on_string(chars)) {
+          return stop();
+        }
+        return value_done();
+      }
+
+      case 'n':
+        if (!scan_keyword(curr, end, "ull") || curr != end) {
+          return fail();
+        }
+        if (!handler.on_null()) {
+          return stop();
+        }
+        return value_done();
+
+      case 't':
+        if (!scan_keyword(curr, end, "rue") || curr != end) {
+          return fail();
+        }
+        if (!handler.on_boolean(true)) {
+          return stop();
+        }
+        return value_done();
+
+      case 'f':
+        if (!scan_keyword(curr, end, "alse") || curr != end) {
+          return fail();
+        }
+        if (!handler.on_boolean(false)) {
+          return stop();
+        }
+        return value_done();
+
+      default:
+      {
+        bigint integer;
+        fractional fraction;
+        auto kind = scan_number(c0, curr, end, integer, fraction);
+        if (curr != end) {
+          return fail();
+        }
+        switch (kind) {
+          case number_kind::integer:
+            if (!handler.on_integer(integer)) {
+              return stop();
+            }
+            break;
+          case number_kind::fractional:
+            if (!handler.on_fractional(fraction)) {
+              return stop();
+            }
+            break;
+          case number_kind::invalid:
+            return fail();
+        }
+        return value_done();
+      }
+
+    }
+  }
+
+  /// Scan the token that starts at `curr`, or move it to `pending` if the
+  /// chunk ends before the token does.
+  bool scan_token(const unsigned char*& curr, const unsigned char* end) {
+    auto start = curr;
+    const unsigned char* token_end;
+    if (*start == '"') {
+      pending_escape = false;
+      token_end = find_string_end(start + 1, end);
+    } else {
+      token_end = find_literal_end(start + 1, end);
+    }
+    if (token_end == nullptr) {
+      pending.assign(start, end);
+      curr = end;
+      return true;
+    }
+    curr = token_end;
+    return emit_token(start, token_end);
+  }
+
+  /// Complete the token in `pending` with the start of a new chunk.
+  bool resume_token(const unsigned char*& curr, const unsigned char* end) {
+    auto token_end = pending[0] == '"'
+      ? find_string_end(curr, end)
+      : find_literal_end(curr, end);
+    if (token_end == nullptr) {
+      pending.append(curr, end);
+      curr = end;
+      return true;
+    }
+    pending.append(curr, token_end);
+    curr = token_end;
+    auto token = reinterpret_cast<const unsigned char*>(pending.data());
+    auto result = emit_token(token, token + pending.size());
+    pending.clear();
+    return result;
+  }
+
+  bool run(const unsigned char* curr, const unsigned char* end) {
+
+    if (!pending.empty() && !resume_token(curr, end)) {
+      return false;
+    }
+
+    while (curr != end) {
+
+      int ch = *curr;
+
+      if (is_json_whitespace(ch)) {
+        ++curr;
+        continue;
+      }
+
+      switch (state) {
+
+        case expect::end:
+          return fail();
+
+        case expect::colon:
+          if (ch != ':') {
+            return fail();
+          }
+          ++curr;
+          state = expect::value;
+          continue;
+
+        case expect::comma_or_close:
+          ++curr;
+          if (ch == ',') {
+            state = nesting.back() ? expect::key : expect::value;
+            continue;
+          }
+          if (ch != (nesting.back() ? '}' : ']')) {
+            return fail();
+          }
+          if (!close_container(nesting.back())) {
+            return false;
+          }
+          continue;
+
+        case expect::key_or_close:
+          if (ch == '}') {
+            ++curr;
+            if (!close_container(true)) {
+              return false;
+            }
+            continue;
+          }
+          // fallthrough
+        case expect::key:
+          if (ch != '"') {
+            return fail();
+          }
+          if (!scan_token(curr, end)) {
+            return false;
+          }
+          continue;
+
+        case expect::value_or_close:
+          if (ch == ']') {
+            ++curr;
+            if (!close_container(false)) {
+              return false;
+            }
+            continue;
+          }
+          // fallthrough
+        case expect::value:
+          switch (ch) {
+            case '{':
+              ++curr;
+              if (!handler.on_object_start()) {
+                return stop();
+              }
+              nesting.push_back(true);
+              state = expect::key_or_close;
+              continue;
+            case '[':
+              ++curr;
+              if (!handler.on_array_start()) {
+                return stop();
+              }
+              nesting.push_back(false);
+              state = expect::value_or_close;
+              continue;
+            case '"':
+            case '-':
+            case '0':
+            case '1':
+            case '2':
+            case '3':
+            case '4':
+            case '5':
+            case '6':
+            case '7':
+            case '8':
+            case '9':
+            case 't':
+            case 'f':
+            case 'n':
+              if (!scan_token(curr, end)) {
+                return false;
+              }
+              continue;
+            default:
+              return fail();
+          }
+
+      }
+
+    }
+
+    return true;
+  }
+
+public:
+
+  push_tokenizer(HandlerT& handler):
+    handler(handler) {}
+
+  /// Process the next chunk of the input.
+  json_events_result feed(const char* data, std::size_t size) {
+    if (failed) {
+      return left(error);
+    }
+    if (stopped) {
+      return right();
+    }
+    auto curr = reinterpret_cast<const unsigned char*>(data);
+    if (!run(curr, curr + size) && failed) {
+      return left(error);
+    }
+    return right();
+  }
+
+  /// Signal the end of the input, which must complete the top-level value.
+  json_events_result finish() {
+    if (failed) {
+      return left(error);
+    }
+    if (stopped) {
+      return right();
+    }
+    if (!pending.empty()) {
+      // A string would have been completed by its closing quote
+      if (pending[0] == '"') {
+        return left(json_parse_error::unexpected_character);
+      }
+      auto token = reinterpret_cast<const unsigned char*>(pending.data());
+      auto done = emit_token(token, token + pending.size());
+      pending.clear();
+      if (failed) {
+        return left(error);
+      }
+      if (!done) {
+        return right();
+      }
+    }
+    if (state != expect::end) {
+      return left(json_parse_error::unexpected_character);
+    }
+    return right();
+  }
+
+};
+
+} // of namespace json_detail
+
+ZEN_NAMESPACE_END
+
+#endif // of #ifndef ZEN_JSON_TOKENIZER_HPP
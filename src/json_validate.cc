@@ -0,0 +1,395 @@
+
+#include "zen/json.hpp"
+#include "zen/simd.hpp"
+
+#include "json_tokenizer.hpp"
+
+ZEN_NAMESPACE_START
+
+using namespace json_detail;
+
+namespace {
+
+  /// One bit per open container, which is set for objects.
+  class nesting_stack {
+
+    std::uint64_t words[json_validate_max_depth / 64];
+
+    std::size_t depth = 0;
+
+  public:
+
+    bool empty() const noexcept {
+      return depth == 0;
+    }
+
+    bool push(bool is_object) noexcept {
+      if (depth == json_validate_max_depth) {
+        return false;
+      }
+      auto bit = std::uint64_t(1) << (depth % 64);
+      auto& word = words[depth / 64];
+      word = is_object ? word | bit : word & ~bit;
+      ++depth;
+      return true;
+    }
+
+    bool top() const noexcept {
+      auto i = depth - 1;
+      return (words[i / 64] >> (i % 64)) & 1;
+    }
+
+    void pop() noexcept {
+      --depth;
+    }
+
+  };
+
+  inline bool in_range(const unsigned char* curr, const unsigned char* end, unsigned char min, unsigned char max) {
+    return curr != end && *curr >= min && *curr <= max;
+  }
+
+  /// Check the multi-byte UTF-8 sequence that starts at `curr`, rejecting
+  /// overlong encodings, surrogates and code points beyond U+10FFFF.
+  const unsigned char* validate_utf8_sequence(const unsigned char* curr, const unsigned char* end) {
+    auto ch = *curr++;
+    unsigned char min = 0x80;
+    unsigned char max = 0xBF;
+    std::size_t trailing;
+    if (ch >= 0xC2 && ch <= 0xDF) {
+      trailing = 1;
+    } else if (ch >= 0xE0 && ch <= 0xEF) {
+      trailing = 2;
+      if (ch == 0xE0) {
+        min = 0xA0;
+      } else if (ch == 0xED) {
+        max = 0x9F;
+      }
+    } else if (ch >= 0xF0 && ch <= 0xF4) {
+      trailing = 3;
+      if (ch == 0xF0) {
+        min = 0x90;
+      } else if (ch == 0xF4) {
+        max = 0x8F;
+      }
+    } else {
+      return nullptr;
+    }
+    // Only the first continuation byte has a restricted range
+    if (!in_range(curr, end, min, max)) {
+      return nullptr;
+    }
+    ++curr;
+    for (std::size_t i = 1; i < trailing; ++i) {
+      if (!in_range(curr, end, 0x80, 0xBF)) {
+        return nullptr;
+      }
+      ++curr;
+    }
+    return curr;
+  }
+
+  /// Check the escape sequence of which the backslash has already been
+  /// consumed.
+  const unsigned char* validate_escape(const unsigned char* curr, const unsigned char* end) {
+    if (curr == end) {
+      return nullptr;
+    }
+    switch (*curr++) {
+      case '"':
+      case '\\':
+      case '/':
+      case 'b':
+      case 'f':
+      case 'n':
+      case 'r':
+      case 't':
+        return curr;
+      case 'u':
+      {
+        std::uint32_t code;
+        if (!scan_unicode_escape(curr, end, code)) {
+          return nullptr;
+        }
+        return curr;
+      }
+      default:
+        return nullptr;
+    }
+  }
+
+  static constexpr const std::ptrdiff_t short_string_size = 16;
+
+  /// Check the remainder of a string of which the opening quote has already
+  /// been consumed.
+  ///
+  /// Every block of 64 bytes is classified once. Only the bytes that need a
+  /// closer look, which are quotes, backslashes, control characters and the
+  /// start of multi-byte sequences, are visited one by one.
+  const unsigned char* validate_string(
+    const unsigned char* curr,
+    const unsigned char* end,
+    json_parse_error& error
+  ) {
+
+    static const auto classify = select_classifier();
+
+    // Most strings are short keys and words, for which classifying a whole
+    // block costs more than looking at their bytes one by one.
+    auto prefix_end = end - curr > short_string_size ? curr + short_string_size : end;
+    for (; curr != prefix_end; ++curr) {
+      auto ch = *curr;
+      if (ch == '"') {
+        return curr + 1;
+      }
+      if (ch == '\\' || ch < 0x20 || ch >= 0x80) {
+        break;
+      }
+    }
+
+    unsigned char tail[simd_block_size];
+
+    auto base = curr;
+
+    while (base < end) {
+
+      auto remaining = static_cast<std::size_t>(end - base);
+      auto block = remaining >= simd_block_size
+        ? base
+        : load_partial_block(base, remaining, tail);
+
+      block_masks masks;
+      classify(block, masks);
+
+      auto special = masks.quote | masks.backslash | masks.control | masks.non_ascii;
+
+      while (special) {
+        auto p = base + count_trailing_zeros(special);
+        special &= special - 1;
+        // Part of an escape or a multi-byte sequence that was already checked
+        if (p < curr) {
+          continue;
+        }
+        auto ch = *p;
+        if (ch == '"') {
+          return p + 1;
+        }
+        if (ch == '\\') {
+          curr = validate_escape(p + 1, end);
+          if (curr == nullptr) {
+            error = json_parse_error::unrecognised_escape_sequence;
+            return nullptr;
+          }
+        } else if (ch < 0x20) {
+          error = json_parse_error::unexpected_character;
+          return nullptr;
+        } else {
+          curr = validate_utf8_sequence(p, end);
+          if (curr == nullptr) {
+            error = json_parse_error::invalid_utf8;
+            return nullptr;
+          }
+        }
+      }
+
+      base += simd_block_size;
+      if (curr > base) {
+        base = curr;
+      }
+
+    }
+
+    error = json_parse_error::unexpected_character;
+    return nullptr;
+  }
+
+  /// Check the grammar of the number that starts at `curr` without
+  /// converting it.
+  const unsigned char* validate_number(const unsigned char* curr, const unsigned char* end) {
+    if (curr != end && *curr == '-') {
+      ++curr;
+    }
+    if (curr == end || !is_json_digit(*curr)) {
+      return nullptr;
+    }
+    if (*curr++ != '0') {
+      while (curr != end && is_json_digit(*curr)) {
+        ++curr;
+      }
+    }
+    if (curr != end && *curr == '.') {
+      ++curr;
+      if (curr == end || !is_json_digit(*curr)) {
+        return nullptr;
+      }
+      while (curr != end && is_json_digit(*curr)) {
+        ++curr;
+      }
+    }
+    if (curr != end && (*curr == 'e' || *curr == 'E')) {
+      ++curr;
+      if (curr != end && (*curr == '+' || *curr == '-')) {
+        ++curr;
+      }
+      if (curr == end || !is_json_digit(*curr)) {
+        return nullptr;
+      }
+      while (curr != end && is_json_digit(*curr)) {
+        ++curr;
+      }
+    }
+    if (curr != end && !is_json_terminator(*curr)) {
+      return nullptr;
+    }
+    return curr;
+  }
+
+}
+
+json_validate_result validate_json(const char* data, std::size_t size) {
+
+  auto curr = reinterpret_cast<const unsigned char*>(data);
+  auto end = curr + size;
+
+  nesting_stack nesting;
+  json_parse_error error;
+  int c0;
+
+  auto peek = [&] {
+    while (curr != end && is_json_whitespace(*curr)) {
+      ++curr;
+    }
+    return curr == end ? EOF : static_cast<int>(*curr);
+  };
+
+  auto next = [&] {
+    auto ch = peek();
+    if (ch != EOF) {
+      ++curr;
+    }
+    return ch;
+  };
+
+next_value:
+
+  c0 = next();
+
+  switch (c0) {
+
+    case '{':
+      c0 = next();
+      if (c0 == '}') {
+        goto value_done;
+      }
+      if (!nesting.push(true)) {
+        return left(json_parse_error::max_depth_exceeded);
+      }
+      goto next_key;
+
+    case '[':
+      if (peek() == ']') {
+        ++curr;
+        goto value_done;
+      }
+      if (!nesting.push(false)) {
+        return left(json_parse_error::max_depth_exceeded);
+      }
+      goto next_value;
+
+    case '-':
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+      curr = validate_number(curr - 1, end);
+      if (curr == nullptr) {
+        return left(json_parse_error::unexpected_character);
+      }
+      goto value_done;
+
+    case '"':
+      curr = validate_string(curr, end, error);
+      if (curr == nullptr) {
+        return left(error);
+      }
+      goto value_done;
+
+    case 'n':
+      if (!scan_keyword(curr, end, "ull")) {
+        return left(json_parse_error::unexpected_character);
+      }
+      goto value_done;
+
+    case 't':
+      if (!scan_keyword(curr, end, "rue")) {
+        return left(json_parse_error::unexpected_character);
+      }
+      goto value_done;
+
+    case 'f':
+      if (!scan_keyword(curr, end, "alse")) {
+        return left(json_parse_error::unexpected_character);
+      }
+      goto value_done;
+
+    default:
+      return left(json_parse_error::unexpected_character);
+
+  }
+
+value_done:
+
+  for (;;) {
+
+    if (nesting.empty()) {
+      if (peek() != EOF) {
+        return left(json_parse_error::unexpected_character);
+      }
+      return right();
+    }
+
+    c0 = next();
+
+    if (c0 == ',') {
+      if (nesting.top()) {
+        c0 = next();
+        goto next_key;
+      }
+      goto next_value;
+    }
+
+    if (c0 != (nesting.top() ? '}' : ']')) {
+      return left(json_parse_error::unexpected_character);
+    }
+
+    nesting.pop();
+
+  }
+
+next_key:
+
+  if (c0 != '"') {
+    return left(json_parse_error::unexpected_character);
+  }
+  curr = validate_string(curr, end, error);
+  if (curr == nullptr) {
+    return left(error);
+  }
+  if (next() != ':') {
+    return left(json_parse_error::unexpected_character);
+  }
+  goto next_value;
+
+}
+
+json_validate_result validate_json(std::string_view in) {
+  return validate_json(in.data(), in.size());
+}
+
+ZEN_NAMESPACE_END
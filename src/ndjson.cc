@@ -0,0 +1,338 @@
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "zen/ndjson.hpp"
+
+ZEN_NAMESPACE_START
+
+namespace {
+
+  /// A run of whole lines that is parsed by a single worker.
+  struct ndjson_batch {
+    std::size_t seq;
+    std::size_t first_line;
+    std::string storage;
+    std::string_view text;
+    std::vector<ndjson_record> records;
+  };
+
+  class batch_source {
+  public:
+
+    /// Fill in the text and the first line of `batch`. Returns false when
+    /// there is no more input.
+    virtual bool next(ndjson_batch& batch) = 0;
+
+    virtual ~batch_source() {}
+
+  };
+
+  /// Cuts batches out of input that is already in memory without copying it.
+  class view_source : public batch_source {
+
+    std::string_view input;
+    std::size_t batch_size;
+    std::size_t offset = 0;
+    std::size_t line = 0;
+
+  public:
+
+    view_source(std::string_view input, std::size_t batch_size):
+      input(input), batch_size(std::max<std::size_t>(batch_size, 1)) {}
+
+    bool next(ndjson_batch& batch) override {
+      if (offset >= input.size()) {
+        return false;
+      }
+      auto end = input.size();
+      if (input.size() - offset > batch_size) {
+        auto newline = input.find('\n', offset + batch_size - 1);
+        if (newline != std::string_view::npos) {
+          end = newline + 1;
+        }
+      }
+      batch.text = input.substr(offset, end - offset);
+      batch.first_line = line;
+      line += std::count(batch.text.begin(), batch.text.end(), '\n');
+      offset = end;
+      return true;
+    }
+
+  };
+
+  /// Reads batches from a stream, keeping the incomplete line at the end of
+  /// each read for the next batch.
+  class stream_source : public batch_source {
+
+    std::istream& input;
+    std::size_t batch_size;
+    std::string carry;
+    std::size_t line = 0;
+    bool at_end = false;
+
+  public:
+
+    stream_source(std::istream& input, std::size_t batch_size):
+      input(input), batch_size(std::max<std::size_t>(batch_size, 1)) {}
+
+    bool next(ndjson_batch& batch) override {
+      std::string storage = std::move(carry);
+      carry.clear();
+      std::size_t searched = 0;
+      for (;;) {
+        if (storage.size() >= batch_size) {
+          auto newline = std::string_view(storage).substr(searched).rfind('\n');
+          if (newline != std::string_view::npos) {
+            auto end = searched + newline + 1;
+            carry.assign(storage, end);
+            storage.resize(end);
+            break;
+          }
+          searched = storage.size();
+        }
+        if (at_end) {
+          break;
+        }
+        auto old_size = storage.size();
+        storage.resize(old_size + batch_size);
+        input.read(&storage[old_size], batch_size);
+        storage.resize(old_size + input.gcount());
+        if (!input) {
+          at_end = true;
+        }
+      }
+      if (storage.empty()) {
+        return false;
+      }
+      batch.storage = std::move(storage);
+      batch.text = batch.storage;
+      batch.first_line = line;
+      line += std::count(batch.text.begin(), batch.text.end(), '\n');
+      return true;
+    }
+
+  };
+
+  /// Call `fn` with the line number and the contents of every non-empty line
+  /// in `batch`.
+  template<typename F>
+  void for_each_line(const ndjson_batch& batch, F fn) {
+    auto text = batch.text;
+    auto line = batch.first_line;
+    std::size_t start = 0;
+    while (start < text.size()) {
+      auto end = text.find('\n', start);
+      if (end == std::string_view::npos) {
+        end = text.size();
+      }
+      auto size = end - start;
+      if (size > 0 && text[end - 1] == '\r') {
+        --size;
+      }
+      if (size > 0) {
+        fn(line, text.data() + start, size);
+      }
+      ++line;
+      start = end + 1;
+    }
+  }
+
+  void parse_batch(ndjson_batch& batch, const json_parse_opts& opts) {
+    // Reserving up front avoids moving records around, which is not cheap
+    // because json_parse_result cannot be moved without throwing.
+    batch.records.reserve(std::count(batch.text.begin(), batch.text.end(), '\n') + 1);
+    for_each_line(batch, [&](std::size_t line, const char* data, std::size_t size) {
+      batch.records.push_back(ndjson_record { line, parse_json(data, size, opts) });
+    });
+  }
+
+  void deliver(ndjson_batch& batch, const ndjson_callback& callback) {
+    for (auto& record: batch.records) {
+      callback(record);
+    }
+  }
+
+  /// Worker threads that take batches from `pending` and put them in
+  /// `finished` once they have been parsed.
+  class worker_pool {
+
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable work_done;
+    std::deque<std::unique_ptr<ndjson_batch>> pending;
+    std::deque<std::unique_ptr<ndjson_batch>> finished;
+    bool closed = false;
+
+    std::vector<std::thread> threads;
+
+    void run(json_parse_opts opts) {
+      // A shared key table cannot be used by several threads at once
+      std::unique_ptr<key_table> keys;
+      if (opts.keys != nullptr) {
+        keys = std::make_unique<key_table>(std::pmr::get_default_resource(), opts.keys->get_storage());
+        opts.keys = keys.get();
+      }
+      for (;;) {
+        std::unique_ptr<ndjson_batch> batch;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          work_ready.wait(lock, [&] { return closed || !pending.empty(); });
+          if (pending.empty()) {
+            return;
+          }
+          batch = std::move(pending.front());
+          pending.pop_front();
+        }
+        parse_batch(*batch, opts);
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          finished.push_back(std::move(batch));
+        }
+        work_done.notify_one();
+      }
+    }
+
+  public:
+
+    worker_pool(std::size_t count, json_parse_opts opts) {
+      for (std::size_t i = 0; i < count; ++i) {
+        threads.emplace_back([this, opts] { run(opts); });
+      }
+    }
+
+    void submit(std::unique_ptr<ndjson_batch> batch) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back(std::move(batch));
+      }
+      work_ready.notify_one();
+    }
+
+    /// Block until a batch has been parsed and take it.
+    std::unique_ptr<ndjson_batch> take() {
+      std::unique_lock<std::mutex> lock(mutex);
+      work_done.wait(lock, [&] { return !finished.empty(); });
+      auto batch = std::move(finished.front());
+      finished.pop_front();
+      return batch;
+    }
+
+    ~worker_pool() {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        pending.clear();
+      }
+      work_ready.notify_all();
+      for (auto& thread: threads) {
+        thread.join();
+      }
+    }
+
+  };
+
+  void run_ndjson(batch_source& source, const ndjson_callback& callback, const ndjson_opts& opts) {
+
+    std::size_t thread_count = opts.threads;
+    if (thread_count == 0) {
+      thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Without any parallelism, records are handed over as soon as they are
+    // parsed so that they are still in the cache.
+    if (thread_count == 1) {
+      ndjson_batch batch;
+      while (source.next(batch)) {
+        for_each_line(batch, [&](std::size_t line, const char* data, std::size_t size) {
+          ndjson_record record { line, parse_json(data, size, opts.parse_opts) };
+          callback(record);
+        });
+      }
+      return;
+    }
+
+    worker_pool pool(thread_count, opts.parse_opts);
+
+    // Bounds the amount of input that is held in memory at once
+    const std::size_t max_in_flight = thread_count * 4;
+
+    std::size_t in_flight = 0;
+    std::size_t next_seq = 0;
+    std::size_t next_delivery = 0;
+    bool exhausted = false;
+
+    // Batches that were finished before some batch that comes earlier in the
+    // input
+    std::map<std::size_t, std::unique_ptr<ndjson_batch>> reorder;
+
+    for (;;) {
+
+      while (!exhausted && in_flight < max_in_flight) {
+        auto batch = std::make_unique<ndjson_batch>();
+        if (!source.next(*batch)) {
+          exhausted = true;
+          break;
+        }
+        batch->seq = next_seq++;
+        pool.submit(std::move(batch));
+        ++in_flight;
+      }
+
+      if (in_flight == 0) {
+        break;
+      }
+
+      auto batch = pool.take();
+
+      if (!opts.ordered) {
+        deliver(*batch, callback);
+        --in_flight;
+        continue;
+      }
+
+      auto seq = batch->seq;
+      reorder.emplace(seq, std::move(batch));
+      for (;;) {
+        auto match = reorder.find(next_delivery);
+        if (match == reorder.end()) {
+          break;
+        }
+        deliver(*match->second, callback);
+        reorder.erase(match);
+        ++next_delivery;
+        --in_flight;
+      }
+
+    }
+
+  }
+
+}
+
+void parse_ndjson(
+  std::string_view input,
+  const ndjson_callback& callback,
+  ndjson_opts opts
+) {
+  view_source source(input, opts.batch_size);
+  run_ndjson(source, callback, opts);
+}
+
+void parse_ndjson(
+  std::istream& input,
+  const ndjson_callback& callback,
+  ndjson_opts opts
+) {
+  stream_source source(input, opts.batch_size);
+  run_ndjson(source, callback, opts);
+}
+
+ZEN_NAMESPACE_END
@@ -0,0 +1,29 @@
+
+#include "zen/object_key.hpp"
+
+#include "json_tokenizer.hpp"
+
+ZEN_NAMESPACE_START
+
+object_key key_table::intern(std::string_view text) {
+  auto match = entries.find(text);
+  if (match != entries.end()) {
+    return match->second.share();
+  }
+  object_key key;
+  if (storage == string_storage::utf8) {
+    key = object_key(json_detail::replace_invalid_utf8(text, utf8_scratch), resource);
+  } else {
+    scratch.clear();
+    json_detail::decode_utf8(text, scratch);
+    key = object_key(scratch, resource);
+  }
+  // The map needs a spelling that outlives the view that was passed in
+  auto spelling = static_cast<char*>(spellings.allocate(text.size(), 1));
+  std::memcpy(spelling, text.data(), text.size());
+  auto out = key.share();
+  entries.emplace(std::string_view(spelling, text.size()), std::move(key));
+  return out;
+}
+
+ZEN_NAMESPACE_END
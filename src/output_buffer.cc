@@ -0,0 +1,159 @@
+#include <cerrno>
+#include <ostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <io.h>
+#endif
+
+#include "zen/output_buffer.hpp"
+
+ZEN_NAMESPACE_START
+
+output_buffer::output_buffer():
+  chunk_size(default_chunk_size) {}
+
+output_buffer::output_buffer(std::ostream& out, std::size_t chunk_size):
+  chunk_size(chunk_size), sink(&out) {}
+
+output_buffer::output_buffer(int fd, std::size_t chunk_size):
+  chunk_size(chunk_size), sink(fd) {}
+
+output_buffer::output_buffer(callback fn, std::size_t chunk_size):
+  chunk_size(chunk_size), sink(std::move(fn)) {}
+
+output_buffer::output_buffer(output_buffer&& other):
+  buf(std::move(other.buf)),
+  len(other.len),
+  cap(other.cap),
+  chunk_size(other.chunk_size),
+  sink(std::move(other.sink)),
+  last_error(other.last_error) {
+    other.len = 0;
+    other.cap = 0;
+    other.sink = std::monostate {};
+  }
+
+output_buffer& output_buffer::operator=(output_buffer&& other) {
+  if (this != &other) {
+    flush();
+    buf = std::move(other.buf);
+    len = other.len;
+    cap = other.cap;
+    chunk_size = other.chunk_size;
+    sink = std::move(other.sink);
+    last_error = other.last_error;
+    other.len = 0;
+    other.cap = 0;
+    other.sink = std::monostate {};
+  }
+  return *this;
+}
+
+output_buffer::~output_buffer() {
+  try {
+    flush();
+  } catch (...) {
+    // Destructors must not throw; call flush() to see what went wrong
+  }
+}
+
+static std::error_code write_fd(int fd, const char* data, std::size_t size) {
+#if defined(__unix__) || defined(__APPLE__) || defined(_WIN32)
+  while (size > 0) {
+#ifdef _WIN32
+    auto n = _write(fd, data, static_cast<unsigned>(std::min<std::size_t>(size, 1 << 30)));
+#else
+    auto n = ::write(fd, data, size);
+#endif
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return std::error_code(errno, std::generic_category());
+    }
+    data += n;
+    size -= n;
+  }
+  return {};
+#else
+  return std::make_error_code(std::errc::function_not_supported);
+#endif
+}
+
+void output_buffer::write_to_sink(const char* data, std::size_t size) {
+  switch (sink.index()) {
+    case 1:
+      std::get<std::ostream*>(sink)->write(data, size);
+      break;
+    case 2:
+      // Keep the first error, but don't write anything after it so that the
+      // output doesn't contain any holes
+      if (!last_error) {
+        last_error = write_fd(std::get<int>(sink), data, size);
+      }
+      break;
+    case 3:
+      std::get<callback>(sink)(data, size);
+      break;
+  }
+}
+
+// Buffers without a sink are often used for small documents, so they start
+// out small
+static constexpr std::size_t min_memory_capacity = 256;
+
+void output_buffer::grow(std::size_t min_capacity) {
+  auto new_cap = std::max({ min_capacity, cap * 2, has_sink() ? chunk_size : min_memory_capacity });
+  auto new_buf = std::make_unique<char[]>(new_cap);
+  if (len > 0) {
+    std::memcpy(new_buf.get(), buf.get(), len);
+  }
+  buf = std::move(new_buf);
+  cap = new_cap;
+}
+
+void output_buffer::make_room(std::size_t size) {
+  if (has_sink()) {
+    flush();
+    if (cap < chunk_size) {
+      grow(chunk_size);
+    }
+    return;
+  }
+  grow(len + size);
+}
+
+void output_buffer::write_slow(const char* data, std::size_t size) {
+  if (!has_sink()) {
+    grow(len + size);
+  } else {
+    // Top up the buffer so that the sink always gets full chunks
+    auto n = cap - len;
+    if (n > 0) {
+      std::memcpy(buf.get() + len, data, n);
+      len += n;
+      data += n;
+      size -= n;
+    }
+    make_room(size);
+    if (size >= cap) {
+      // Too large to be worth copying into the buffer
+      write_to_sink(data, size);
+      return;
+    }
+  }
+  std::memcpy(buf.get() + len, data, size);
+  len += size;
+}
+
+void output_buffer::flush() {
+  if (!has_sink() || len == 0) {
+    return;
+  }
+  write_to_sink(buf.get(), len);
+  len = 0;
+}
+
+ZEN_NAMESPACE_END
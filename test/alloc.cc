@@ -1,4 +1,7 @@
 
+#include <cstdint>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 #include "zen/alloc.hpp"
@@ -6,7 +9,7 @@
 TEST(AllocTest, CanAllocSingleBytes) {
   zen::pool_alloc a;
   for (size_t i = 0; i < 256 * 1024; i++) {
-    char* byte = static_cast<char*>(a.allocate(8));
+    char* byte = static_cast<char*>(a.try_allocate(8));
     ASSERT_TRUE(byte);
     *byte = 42;
     ASSERT_EQ(*byte, 42);
@@ -15,6 +18,34 @@ TEST(AllocTest, CanAllocSingleBytes) {
 
 TEST(AllocTest, FailsToAllocTooLarge) {
   zen::pool_alloc a(1024);
-  ASSERT_FALSE(a.allocate(2048));
+  ASSERT_FALSE(a.try_allocate(2048));
+}
+
+
+TEST(AllocTest, RespectsAlignment) {
+  zen::pool_alloc a;
+  a.try_allocate(1);
+  auto ptr = a.try_allocate(8, 8);
+  ASSERT_EQ(reinterpret_cast<std::uintptr_t>(ptr) % 8, 0);
 }
 
+TEST(AllocTest, CanBackStandardContainers) {
+  zen::pool_alloc a(1024);
+  std::pmr::vector<int> v(&a);
+  for (int i = 0; i < 10000; ++i) {
+    v.push_back(i);
+  }
+  ASSERT_EQ(v[9999], 9999);
+  a.release();
+  ASSERT_TRUE(a.try_allocate(16));
+}
+
+TEST(AllocTest, ServesLargeRequestsThroughMemoryResource) {
+  zen::pool_alloc a(1024);
+  std::pmr::memory_resource& resource = a;
+  auto ptr = static_cast<char*>(resource.allocate(2048, 16));
+  ASSERT_TRUE(ptr);
+  ASSERT_EQ(reinterpret_cast<std::uintptr_t>(ptr) % 16, 0);
+  ptr[2047] = 42;
+  ASSERT_EQ(ptr[2047], 42);
+}
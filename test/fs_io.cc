@@ -0,0 +1,67 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "zen/fs/io.hpp"
+#include "zen/json.hpp"
+
+static zen::fs::path write_temp_file(const std::string& name, const std::string& contents) {
+  auto filename = std::filesystem::temp_directory_path() / name;
+  std::ofstream out(filename, std::ios::binary);
+  out << contents;
+  return filename;
+}
+
+TEST(FsIo, CanMapAFile) {
+  auto filename = write_temp_file("zen-fs-io-map.txt", "hello, world");
+  auto mapped = zen::fs::map_file(filename);
+  ASSERT_TRUE(mapped.is_right());
+  auto file = std::move(mapped.right());
+  ASSERT_EQ(file.view(), "hello, world");
+  zen::fs::mapped_file other = std::move(file);
+  ASSERT_EQ(file.data(), nullptr);
+  ASSERT_EQ(other.size(), 12);
+  std::filesystem::remove(filename);
+}
+
+TEST(FsIo, CanMapAnEmptyFile) {
+  auto filename = write_temp_file("zen-fs-io-empty.txt", "");
+  auto mapped = zen::fs::map_file(filename);
+  ASSERT_TRUE(mapped.is_right());
+  ASSERT_EQ(mapped.right().size(), 0);
+  std::filesystem::remove(filename);
+}
+
+TEST(FsIo, ReportsMissingFiles) {
+  auto filename = std::filesystem::temp_directory_path() / "zen-fs-io-missing.txt";
+  auto mapped = zen::fs::map_file(filename);
+  ASSERT_TRUE(mapped.is_left());
+  ASSERT_EQ(mapped.left(), std::errc::no_such_file_or_directory);
+  ASSERT_TRUE(zen::fs::read_file(filename).is_left());
+}
+
+TEST(FsIo, CanReadAFile) {
+  auto filename = write_temp_file("zen-fs-io-read.txt", "some bytes");
+  auto contents = zen::fs::read_file(filename);
+  ASSERT_TRUE(contents.is_right());
+  ASSERT_TRUE(contents.right() == "some bytes");
+  std::filesystem::remove(filename);
+}
+
+TEST(FsIo, CanParseAJsonFile) {
+  auto filename = write_temp_file("zen-fs-io.json", "{\"a\": [1, 2, \"three\"]}");
+  auto result = zen::parse_json_file(filename);
+  ASSERT_TRUE(result.is_right());
+  ASSERT_EQ(result.right().as_object().size(), 1);
+  std::filesystem::remove(filename);
+  auto missing = zen::parse_json_file(filename);
+  ASSERT_TRUE(missing.is_left());
+  ASSERT_TRUE(std::holds_alternative<std::error_code>(missing.left()));
+  auto invalid_filename = write_temp_file("zen-fs-io-invalid.json", "{\"a\": ");
+  auto invalid = zen::parse_json_file(invalid_filename);
+  ASSERT_TRUE(invalid.is_left());
+  ASSERT_TRUE(std::holds_alternative<zen::json_parse_error>(invalid.left()));
+  std::filesystem::remove(invalid_filename);
+}
@@ -0,0 +1,69 @@
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "zen/integer_format.hpp"
+
+template<typename T>
+static std::string format(T value) {
+  char buffer[zen::max_integer_length];
+  auto end = zen::format_integer(value, buffer);
+  return std::string(buffer, end - buffer);
+}
+
+template<typename T>
+static void expect_same_as_std(T value) {
+  ASSERT_EQ(format(value), std::to_string(value));
+}
+
+template<typename T>
+static void check_limits() {
+  expect_same_as_std(std::numeric_limits<T>::min());
+  expect_same_as_std(std::numeric_limits<T>::max());
+  expect_same_as_std(T(0));
+  expect_same_as_std(T(1));
+  expect_same_as_std(T(9));
+  expect_same_as_std(T(10));
+  expect_same_as_std(T(99));
+  expect_same_as_std(T(100));
+  if constexpr (std::is_signed_v<T>) {
+    expect_same_as_std(T(-1));
+    expect_same_as_std(T(-10));
+  }
+}
+
+TEST(IntegerFormat, HandlesTheLimitsOfEveryType) {
+  check_limits<std::int8_t>();
+  check_limits<std::uint8_t>();
+  check_limits<std::int16_t>();
+  check_limits<std::uint16_t>();
+  check_limits<std::int32_t>();
+  check_limits<std::uint32_t>();
+  check_limits<std::int64_t>();
+  check_limits<std::uint64_t>();
+}
+
+TEST(IntegerFormat, HandlesEveryNumberOfDigits) {
+  std::uint64_t n = 1;
+  for (int digits = 1; digits < 20; ++digits) {
+    expect_same_as_std(n - 1);
+    expect_same_as_std(n);
+    expect_same_as_std(n + 1);
+    expect_same_as_std(-static_cast<std::int64_t>(n));
+    n *= 10;
+  }
+}
+
+TEST(IntegerFormat, AgreesWithStdOnRandomNumbers) {
+  std::mt19937_64 rng(42);
+  for (std::size_t i = 0; i < 10000; ++i) {
+    auto bits = rng();
+    // Spread the numbers over all magnitudes
+    auto shift = rng() % 64;
+    expect_same_as_std(bits >> shift);
+    expect_same_as_std(static_cast<std::int64_t>(bits) >> shift);
+  }
+}
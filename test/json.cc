@@ -1,8 +1,17 @@
 
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <sstream>
 #include <string>
+#include <vector>
 
 #include "gtest/gtest.h"
 
+#include "zen/alloc.hpp"
 #include "zen/json.hpp"
 
 // TODO Simplify these tests by using Unicode-style string literals.
@@ -102,6 +111,158 @@ TEST(JsonParse, CanParseSimpleObject) {
   // ASSERT_EQ(o1["bar"], 2);
 }
 
+static zen::string make_key(std::string_view text) {
+  return zen::string(text.begin(), text.end());
+}
+
+TEST(JsonParse, CanLookUpMembersOfLargeObjects) {
+  std::string text = "{";
+  for (int i = 0; i < 100; ++i) {
+    text += (i > 0 ? ",\"k" : "\"k") + std::to_string(i) + "\":" + std::to_string(i);
+  }
+  text += "}";
+  auto r1 = zen::parse_json(text).unwrap();
+  auto copy = r1;
+  for (auto* v: { &r1, &copy }) {
+    auto& o1 = v->as_object();
+    ASSERT_EQ(o1.size(), 100);
+    ASSERT_EQ(o1[make_key("k0")].as_integer(), 0);
+    ASSERT_EQ(o1[make_key("k42")].as_integer(), 42);
+    ASSERT_EQ(o1.find(make_key("missing")), o1.end());
+  }
+}
+
+TEST(JsonParse, CanAllocateFromAnArena) {
+  zen::pool_alloc arena(4096);
+  std::string text = "{\"name\":\"arena\",\"items\":[1,[2,3],{\"deep\":\"string that is long enough\"}]}";
+  auto r1 = zen::parse_json(text, arena).unwrap();
+  auto& o1 = r1.as_object();
+  ASSERT_EQ(o1[make_key("name")].as_string(), make_key("arena"));
+  auto& items = o1[make_key("items")].as_array();
+  ASSERT_EQ(items.get_allocator().resource(), &arena);
+  ASSERT_EQ(items.size(), 3);
+  ASSERT_EQ(items[1].as_array()[1].as_integer(), 3);
+  auto& deep = items[2].as_object()[make_key("deep")].as_string();
+  ASSERT_EQ(deep.get_allocator().resource(), &arena);
+  // A copy does not depend on the arena anymore
+  zen::value copy = r1;
+  ASSERT_EQ(zen::to_string(copy), zen::to_string(r1));
+  ASSERT_NE(copy.as_object()[make_key("items")].as_array().get_allocator().resource(), &arena);
+}
+
+TEST(JsonParse, AllocatesArraysAtTheirExactSize) {
+  auto r1 = zen::parse_json("[1,2,3,[4,5,6,7,8],{\"a\":[9]}]").unwrap();
+  auto& a1 = r1.as_array();
+  ASSERT_EQ(a1.capacity(), 5);
+  ASSERT_EQ(a1[3].as_array().capacity(), 5);
+  ASSERT_EQ(a1[4].as_object()[make_key("a")].as_array().capacity(), 1);
+}
+
+TEST(JsonParse, CanKeepStringsInUTF8) {
+  std::string text = "{\"caf\\u00e9\":\"na\xc3\xafve \\\"quoted\\\"\",\"list\":[\"\xe2\x82\xac\"]}";
+  zen::json_parse_opts opts;
+  opts.strings = zen::string_storage::utf8;
+  for (bool intern: { false, true }) {
+    opts.intern_keys = intern;
+    auto r1 = zen::parse_json(text, opts).unwrap();
+    auto& o1 = r1.as_object();
+    ASSERT_TRUE(o1.begin()->first.is_utf8());
+    ASSERT_EQ(o1.begin()->first.utf8(), "caf\xc3\xa9");
+    auto& s1 = o1[zen::string({ 'c', 'a', 'f', 0xE9 })];
+    ASSERT_TRUE(s1.is_utf8_string());
+    ASSERT_FALSE(s1.is_string());
+    ASSERT_EQ(s1.as_utf8_string(), "na\xc3\xafve \"quoted\"");
+    ASSERT_EQ(o1[make_key("list")].as_array()[0].as_utf8_string(), "\xe2\x82\xac");
+    // The output is the same as for strings of code points
+    auto decoded = zen::parse_json(text).unwrap();
+    ASSERT_EQ(zen::to_string(r1), zen::to_string(decoded));
+    zen::value copy = r1;
+    ASSERT_EQ(zen::to_string(copy), zen::to_string(r1));
+  }
+}
+
+TEST(JsonParse, CanLookUpMembersByUTF8Text) {
+  std::string text = "{\"caf\xc3\xa9\":-1";
+  for (int i = 0; i < 40; ++i) {
+    text += ",\"k" + std::to_string(i) + "\":" + std::to_string(i);
+  }
+  text += "}";
+  for (auto storage: { zen::string_storage::code_points, zen::string_storage::utf8 }) {
+    zen::json_parse_opts opts;
+    opts.strings = storage;
+    auto r1 = zen::parse_json(text, opts).unwrap();
+    auto& o1 = r1.as_object();
+    ASSERT_EQ(o1[std::string_view("k39")].as_integer(), 39);
+    ASSERT_EQ(o1[std::string_view("caf\xc3\xa9")].as_integer(), -1);
+    ASSERT_EQ(o1.find(std::string_view("cafe")), o1.end());
+  }
+}
+
+TEST(JsonParse, ReplacesInvalidUTF8TheSameWayInBothStorages) {
+  // A stray byte, a surrogate, an overlong encoding and a cut-off sequence
+  std::string text = "{\"a\xff\":\"b\xed\xa0\x80\xc0\xaf\xe2\x82\"";
+  for (int i = 0; i < 40; ++i) {
+    text += ",\"k" + std::to_string(i) + "\":" + std::to_string(i);
+  }
+  text += "}";
+  zen::string key { 'a', 0xFFFD };
+  zen::json_print_opts print_opts;
+  print_opts.indentation = "";
+  std::string expected;
+  zen::value values[4];
+  int i = 0;
+  for (auto storage: { zen::string_storage::code_points, zen::string_storage::utf8 }) {
+    for (auto intern: { false, true }) {
+      zen::json_parse_opts opts;
+      opts.strings = storage;
+      opts.intern_keys = intern;
+      auto v = zen::parse_json(text, opts).unwrap();
+      auto& o = v.as_object();
+      ASSERT_NE(o.find(key), o.end());
+      ASSERT_NE(o.find(std::string_view("a\xef\xbf\xbd")), o.end());
+      if (expected.empty()) {
+        expected = zen::to_string(v, print_opts);
+      }
+      ASSERT_EQ(zen::to_string(v, print_opts), expected);
+      values[i++] = std::move(v);
+    }
+  }
+  std::string replaced;
+  for (int j = 0; j < 6; ++j) {
+    replaced += "\xef\xbf\xbd";
+  }
+  auto prefix = "{\"a\xef\xbf\xbd\":\"b" + replaced + "\",";
+  ASSERT_EQ(expected.substr(0, prefix.size()), prefix);
+  for (auto& v: values) {
+    ASSERT_EQ(v.as_object().begin()->first, values[0].as_object().begin()->first);
+  }
+}
+
+TEST(Value, MovesAndCopiesKeepTheContents) {
+  zen::object o1;
+  for (int i = 0; i < 40; ++i) {
+    auto key = make_key("k" + std::to_string(i));
+    o1.emplace(zen::object_key(key), zen::value(zen::bigint(i)));
+    ASSERT_EQ(o1[key].as_integer(), i);
+  }
+  zen::value v1(std::move(o1));
+  zen::value v2;
+  v2 = v1;
+  zen::value v3(std::move(v1));
+  ASSERT_TRUE(v1.is_null());
+  for (auto* v: { &v2, &v3 }) {
+    auto& o = v->as_object();
+    ASSERT_EQ(o.size(), 40);
+    ASSERT_EQ(o[make_key("k0")].as_integer(), 0);
+    ASSERT_EQ(o[make_key("k39")].as_integer(), 39);
+    ASSERT_EQ(o.begin()->first, make_key("k0"));
+  }
+  v2 = zen::value(make_key("short"));
+  ASSERT_EQ(v2.as_string(), make_key("short"));
+  v3 = v2;
+  ASSERT_EQ(v3.as_string(), make_key("short"));
+}
+
 TEST(JsonParse, DoesNotCrashWhenGivenInvalidChars) {
   auto r1 = zen::parse_json("@");
   ASSERT_TRUE(r1.is_left());
@@ -122,3 +283,529 @@ TEST(JsonParse, CanParseFractional) {
   ASSERT_TRUE(r1.is_fractional());
   ASSERT_EQ(r1.as_fractional(), 2.3);
 }
+
+static double parse_fractional(const char* text) {
+  auto result = zen::parse_json(text).unwrap();
+  EXPECT_TRUE(result.is_fractional()) << text;
+  return result.as_fractional();
+}
+
+TEST(JsonParse, CanParseNegativeNumbers) {
+  ASSERT_EQ(zen::parse_json("-42").unwrap().as_integer(), -42);
+  ASSERT_EQ(parse_fractional("-0.5"), -0.5);
+  ASSERT_TRUE(std::signbit(parse_fractional("-0.0")));
+  ASSERT_EQ(zen::parse_json("[-1,-2]").unwrap().as_array()[1].as_integer(), -2);
+}
+
+TEST(JsonParse, AppliesExponentsToTheMantissa) {
+  ASSERT_EQ(parse_fractional("1.5e3"), 1500.0);
+  ASSERT_EQ(parse_fractional("25E-2"), 0.25);
+  ASSERT_EQ(parse_fractional("1e+2"), 100.0);
+  ASSERT_EQ(parse_fractional("1e400"), std::numeric_limits<double>::infinity());
+  ASSERT_EQ(parse_fractional("1e-400"), 0.0);
+}
+
+TEST(JsonParse, IntegersThatDoNotFitBecomeFractional) {
+  ASSERT_EQ(zen::parse_json("9223372036854775807").unwrap().as_integer(), std::numeric_limits<zen::bigint>::max());
+  ASSERT_EQ(zen::parse_json("-9223372036854775808").unwrap().as_integer(), std::numeric_limits<zen::bigint>::min());
+  ASSERT_EQ(parse_fractional("9223372036854775808"), 9223372036854775808.0);
+  ASSERT_EQ(parse_fractional("123456789012345678901234567890"), 123456789012345678901234567890.0);
+}
+
+TEST(JsonParse, RejectsMalformedNumbers) {
+  for (auto text: { "-", "01", "1.", ".5", "1e", "1e+", "--1", "1.2.3", "-a" }) {
+    ASSERT_TRUE(zen::parse_json(text).is_left()) << text;
+  }
+}
+
+TEST(JsonParse, FractionalsAreCorrectlyRounded) {
+  const char* samples[] = {
+    "0.1", "0.3", "2.2250738585072014e-308", "2.2250738585072011e-308",
+    "4.9406564584124654e-324", "2.4703282292062328e-324", "1.7976931348623157e308",
+    "1.7976931348623158e308", "9007199254740993.0", "0.1000000000000000055511151231257827",
+    "7.4109846876186982e-323", "3.14159265358979323846264338327950288",
+    "1.00000000000000011102230246251565404236316680908203125",
+    "1.00000000000000011102230246251565404236316680908203124",
+  };
+  for (auto text: samples) {
+    ASSERT_EQ(parse_fractional(text), std::strtod(text, nullptr)) << text;
+  }
+  std::mt19937_64 rng(42);
+  char buffer[64];
+  for (int i = 0; i < 100000; ++i) {
+    std::uint64_t bits = rng();
+    double expected;
+    std::memcpy(&expected, &bits, sizeof(expected));
+    if (!std::isfinite(expected)) {
+      continue;
+    }
+    std::snprintf(buffer, sizeof(buffer), "%.*e", static_cast<int>(rng() % 20), expected);
+    ASSERT_EQ(parse_fractional(buffer), std::strtod(buffer, nullptr)) << buffer;
+  }
+}
+
+TEST(JsonParse, AllInputOverloadsAgree) {
+  std::string text = "{\"foo\":[1,2,{\"bar\":\"baz\"}],\"qux\":null}";
+  auto r1 = zen::parse_json(text).unwrap();
+  auto r2 = zen::parse_json(std::string_view(text)).unwrap();
+  auto r3 = zen::parse_json(text.data(), text.size()).unwrap();
+  zen::bytestring bs(text);
+  auto r4 = zen::parse_json(bs.as_view()).unwrap();
+  std::istringstream iss(text);
+  auto r5 = zen::parse_json(iss).unwrap();
+  auto expected = zen::to_string(r1);
+  ASSERT_EQ(zen::to_string(r2), expected);
+  ASSERT_EQ(zen::to_string(r3), expected);
+  ASSERT_EQ(zen::to_string(r4), expected);
+  ASSERT_EQ(zen::to_string(r5), expected);
+}
+
+TEST(JsonParse, OnlyReadsTheGivenBytes) {
+  const char* text = "[1,2]garbage";
+  auto r1 = zen::parse_json(text, 5).unwrap();
+  ASSERT_TRUE(r1.is_array());
+  ASSERT_EQ(r1.as_array().size(), 2);
+  auto r2 = zen::parse_json(text, 4);
+  ASSERT_TRUE(r2.is_left());
+}
+
+TEST(JsonParse, FailsOnUnterminatedInput) {
+  ASSERT_TRUE(zen::parse_json("\"abc").is_left());
+  ASSERT_TRUE(zen::parse_json("]").is_left());
+  ASSERT_TRUE(zen::parse_json("").is_left());
+}
+
+TEST(JsonParse, RejectsTrailingCharacters) {
+  zen::json_parse_opts indexed;
+  indexed.structural_index = true;
+  for (auto opts: { zen::json_parse_opts {}, indexed }) {
+    for (auto text: { "1 2", "[1,2]x", "{\"a\":1}}", "\"a\" \"b\"", "null,", "true false" }) {
+      ASSERT_TRUE(zen::parse_json(text, opts).is_left()) << text;
+      zen::json_handler handler;
+      ASSERT_TRUE(zen::parse_json_events(text, handler, opts).is_left()) << text;
+    }
+    ASSERT_TRUE(zen::parse_json(" [1,2] \n", opts).is_right());
+  }
+}
+
+TEST(JsonParse, CanParseNestedContainers) {
+  auto r1 = zen::parse_json("{\"a\":{\"b\":[1,{\"c\":{}}]},\"d\":[[1],2]}").unwrap();
+  ASSERT_TRUE(r1.is_object());
+  ASSERT_EQ(r1.as_object().size(), 2);
+  auto r2 = zen::parse_json("[[1],2]").unwrap();
+  ASSERT_EQ(r2.as_array().size(), 2);
+  ASSERT_TRUE(r2.as_array()[0].is_array());
+  ASSERT_TRUE(zen::parse_json("[1}").is_left());
+  ASSERT_TRUE(zen::parse_json("{1}").is_left());
+}
+
+TEST(JsonParse, StructuralIndexGivesSameResults) {
+  zen::json_parse_opts opts;
+  opts.structural_index = true;
+  std::string long_string(100, 'x');
+  const char* documents[] = {
+    "1",
+    "  [ 1 , 2.5 , true , false , null ]  ",
+    "{\"foo\":[1,2,{\"bar\":\"baz\"}],\"qux\":null}",
+    "\"escaped \\\" quote and \\\\ backslash\"",
+    "[\"\\\\\\\\\", \"\\\\\\\"\", \"a\\nb\"]",
+  };
+  for (auto document: documents) {
+    auto expected = zen::to_string(zen::parse_json(document).unwrap());
+    ASSERT_EQ(zen::to_string(zen::parse_json(document, opts).unwrap()), expected);
+  }
+  // Strings and escapes that cross the boundary of a 64-byte block
+  for (std::size_t i = 50; i < 70; ++i) {
+    auto document = "[\"" + std::string(i, 'a') + "\\\\\",\"" + long_string + "\\\"\", 12345]";
+    auto expected = zen::to_string(zen::parse_json(document).unwrap());
+    ASSERT_EQ(zen::to_string(zen::parse_json(document, opts).unwrap()), expected);
+  }
+  const char* invalid[] = { "[1 2]", "[1@]", "[nullx]", "\"abc", "[1,]", "{\"a\" 1}", "" };
+  for (auto document: invalid) {
+    ASSERT_TRUE(zen::parse_json(document).is_left());
+    ASSERT_TRUE(zen::parse_json(document, opts).is_left());
+  }
+}
+
+TEST(JsonParse, DecodesUTF8IntoCodePoints) {
+  auto r1 = zen::parse_json("\"caf\xc3\xa9 \xe2\x82\xac\"").unwrap();
+  auto s1 = r1.as_string();
+  ASSERT_EQ(s1.size(), 6);
+  ASSERT_EQ(s1[3], 0xE9);
+  ASSERT_EQ(s1[5], 0x20AC);
+}
+
+struct field_summer : public zen::json_handler {
+
+  std::vector<std::string> events;
+  bool in_price = false;
+  zen::bigint total = 0;
+
+  bool on_object_start() override {
+    events.push_back("{");
+    return true;
+  }
+
+  bool on_object_end() override {
+    events.push_back("}");
+    return true;
+  }
+
+  bool on_array_start() override {
+    events.push_back("[");
+    return true;
+  }
+
+  bool on_array_end() override {
+    events.push_back("]");
+    return true;
+  }
+
+  bool on_key(std::string_view key) override {
+    events.push_back(std::string(key) + ":");
+    in_price = key == "price";
+    return true;
+  }
+
+  bool on_integer(zen::bigint value) override {
+    events.push_back(std::to_string(value));
+    if (in_price) {
+      total += value;
+    }
+    return true;
+  }
+
+  bool on_string(std::string_view value) override {
+    events.push_back("\"" + std::string(value) + "\"");
+    return true;
+  }
+
+};
+
+TEST(JsonEvents, ReportsEventsInDocumentOrder) {
+  field_summer handler;
+  auto result = zen::parse_json_events(
+    "[{\"name\":\"a\\tb\",\"price\":3},{\"price\":4,\"tags\":[]},{}]",
+    handler
+  );
+  ASSERT_TRUE(result.is_right());
+  std::vector<std::string> expected {
+    "[", "{", "name:", "\"a\tb\"", "price:", "3", "}",
+    "{", "price:", "4", "tags:", "[", "]", "}", "{", "}", "]",
+  };
+  ASSERT_EQ(handler.events, expected);
+  ASSERT_EQ(handler.total, 7);
+}
+
+struct stop_at_first_key : public zen::json_handler {
+
+  int keys = 0;
+
+  bool on_key(std::string_view) override {
+    ++keys;
+    return false;
+  }
+
+};
+
+TEST(JsonEvents, StopsWhenHandlerReturnsFalse) {
+  stop_at_first_key handler;
+  // Everything after the first key is never looked at
+  auto result = zen::parse_json_events("{\"a\":1,\"b\":2 @@@", handler);
+  ASSERT_TRUE(result.is_right());
+  ASSERT_EQ(handler.keys, 1);
+}
+
+TEST(JsonEvents, ReportsErrors) {
+  zen::json_handler handler;
+  ASSERT_TRUE(zen::parse_json_events("[1,", handler).is_left());
+  ASSERT_TRUE(zen::parse_json_events("{\"a\"}", handler).is_left());
+}
+
+static zen::json_parse_result push_in_chunks(std::string_view text, std::size_t chunk_size) {
+  zen::json_push_parser parser;
+  for (std::size_t i = 0; i < text.size(); i += chunk_size) {
+    auto result = parser.feed(text.substr(i, chunk_size));
+    if (result.is_left()) {
+      return zen::left(result.left());
+    }
+  }
+  return parser.finish();
+}
+
+TEST(JsonPush, GivesSameResultsForAnyChunkSize) {
+  const char* documents[] = {
+    "1",
+    "-12.5e-3",
+    "  [ 1 , 2.5 , true , false , null ]  ",
+    "{\"foo\":[1,2,{\"bar\":\"baz\"}],\"qux\":null,\"e\":{},\"a\":[]}",
+    "\"escaped \\\" quote and \\\\ backslash\"",
+    "[\"\\\\\\\\\", \"\\\\\\\"\", \"a\\nb\", \"caf\xc3\xa9\"]",
+  };
+  for (auto document: documents) {
+    auto expected = zen::to_string(zen::parse_json(document).unwrap());
+    for (std::size_t n = 1; n <= std::strlen(document); ++n) {
+      auto result = push_in_chunks(document, n);
+      ASSERT_TRUE(result.is_right()) << document << " " << n;
+      ASSERT_EQ(zen::to_string(result.unwrap()), expected) << document << " " << n;
+    }
+  }
+}
+
+TEST(JsonPush, CanParseSeveralValuesInARow) {
+  zen::json_push_parser parser;
+  ASSERT_TRUE(parser.feed("[1, ").is_right());
+  ASSERT_TRUE(parser.feed("2]").is_right());
+  ASSERT_EQ(parser.finish().unwrap().as_array().size(), 2);
+  ASSERT_TRUE(parser.feed("tr").is_right());
+  ASSERT_TRUE(parser.feed("ue").is_right());
+  ASSERT_TRUE(parser.finish().unwrap().is_true());
+}
+
+TEST(JsonPush, CanAllocateFromAnArena) {
+  zen::pool_alloc arena;
+  zen::json_push_parser parser(arena);
+  ASSERT_TRUE(parser.feed("{\"key\": \"a string that is long enough to allocate\"}").is_right());
+  auto result = parser.finish().unwrap();
+  auto& member = result.as_object().begin()->second.as_string();
+  ASSERT_EQ(member.get_allocator().resource(), &arena);
+}
+
+TEST(JsonPush, ReportsErrors) {
+  const char* invalid[] = { "[1 2]", "[1@]", "[nullx]", "\"abc", "[1,]", "{\"a\" 1}", "", "[1", "{\"a\":1}x", "01" };
+  for (auto document: invalid) {
+    for (std::size_t n = 1; n <= std::max<std::size_t>(std::strlen(document), 1); ++n) {
+      ASSERT_TRUE(push_in_chunks(document, n).is_left()) << document << " " << n;
+    }
+  }
+  zen::json_push_parser parser;
+  ASSERT_TRUE(parser.feed("[}").is_left());
+  ASSERT_TRUE(parser.feed("]").is_left());
+}
+
+TEST(JsonValidate, AcceptsWellFormedDocuments) {
+  const char* valid[] = {
+    "1",
+    " -0.5e+10 ",
+    "[1, 2.5, true, false, null, [], {}]",
+    "{\"foo\":[1,2,{\"bar\":\"baz\"}],\"qux\":null}",
+    "\"escaped \\\" quote, \\\\ backslash and \\u00e9 \\uD83D\\uDE00\"",
+    "\"caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80\"",
+  };
+  for (auto document: valid) {
+    ASSERT_TRUE(zen::validate_json(document).is_right()) << document;
+    ASSERT_TRUE(zen::parse_json(document).is_right()) << document;
+  }
+  // Strings and escapes that cross the boundary of a 64-byte block
+  for (std::size_t i = 50; i < 70; ++i) {
+    auto document = "[\"" + std::string(i, 'a') + "\\\\\",\"" + std::string(i, 'b') + "\xc3\xa9\\\"\", 12345]";
+    ASSERT_TRUE(zen::validate_json(document).is_right()) << document;
+  }
+}
+
+TEST(JsonValidate, RejectsMalformedDocuments) {
+  const char* invalid[] = {
+    "", "[1 2]", "[1@]", "[nullx]", "\"abc", "[1,]", "{\"a\" 1}", "{\"a\":1}x", "01", "1.", "-", "1e",
+    "[1}", "{1}", "\"\\x\"", "\"\\u12\"", "\"\\uD83D\"", "\"\\uDE00\"", "\"tab\there\"",
+  };
+  for (auto document: invalid) {
+    ASSERT_TRUE(zen::validate_json(document).is_left()) << document;
+  }
+}
+
+TEST(JsonValidate, RejectsInvalidUTF8) {
+  const char* invalid[] = {
+    "\"\x80\"", "\"\xc3\"", "\"\xc0\xaf\"", "\"\xe0\x80\xaf\"", "\"\xed\xa0\x80\"",
+    "\"\xf4\x90\x80\x80\"", "\"\xf8\x88\x80\x80\x80\"", "\"\xe2\x82\"",
+  };
+  for (auto document: invalid) {
+    auto result = zen::validate_json(document);
+    ASSERT_TRUE(result.is_left()) << document;
+    ASSERT_EQ(result.left(), zen::json_parse_error::invalid_utf8) << document;
+  }
+}
+
+TEST(JsonValidate, LimitsTheNestingDepth) {
+  auto depth = zen::json_validate_max_depth;
+  auto document = std::string(depth, '[') + "1" + std::string(depth, ']');
+  ASSERT_TRUE(zen::validate_json(document).is_right());
+  document = std::string(depth + 1, '[') + "1" + std::string(depth + 1, ']');
+  ASSERT_EQ(zen::validate_json(document).left(), zen::json_parse_error::max_depth_exceeded);
+}
+
+TEST(JsonParse, DecodesUnicodeEscapes) {
+  auto r1 = zen::parse_json("\"\\u00e9\\u20AC\\uD83D\\uDE00\"").unwrap();
+  ASSERT_EQ(r1.as_string(), zen::string({ 0xE9, 0x20AC, 0x1F600 }));
+  ASSERT_TRUE(zen::parse_json("\"\\uD83D\"").is_left());
+  ASSERT_TRUE(zen::parse_json("\"\\u00g0\"").is_left());
+}
+
+TEST(JsonParse, CanInternKeys) {
+  const char* text = "[{\"id\":1,\"name\":\"a\"},{\"id\":2,\"name\":\"b\"}]";
+  auto first_key = [](const zen::value& doc, std::size_t i) {
+    return doc.as_array()[i].as_object().begin()->first.view().data();
+  };
+  auto r1 = zen::parse_json(text).unwrap();
+  ASSERT_NE(first_key(r1, 0), first_key(r1, 1));
+  zen::json_parse_opts opts;
+  opts.intern_keys = true;
+  auto r2 = zen::parse_json(text, opts).unwrap();
+  ASSERT_EQ(first_key(r2, 0), first_key(r2, 1));
+  ASSERT_EQ(zen::to_string(r2), zen::to_string(r1));
+  zen::key_table table;
+  opts.keys = &table;
+  auto r3 = zen::parse_json(text, opts).unwrap();
+  auto r4 = zen::parse_json(text, opts).unwrap();
+  ASSERT_EQ(table.size(), 2);
+  ASSERT_EQ(first_key(r3, 0), first_key(r4, 1));
+}
+
+TEST(JsonParse, InternedKeysCanBeCopiedOutOfTheArena) {
+  zen::value copy;
+  {
+    zen::pool_alloc arena;
+    zen::json_parse_opts opts;
+    opts.intern_keys = true;
+    auto doc = zen::parse_json("{\"a\": {\"a\": 1}}", arena, opts).unwrap();
+    copy = doc;
+  }
+  auto& inner = copy.as_object()[make_key("a")];
+  ASSERT_EQ(inner.as_object()[make_key("a")].as_integer(), 1);
+}
+
+TEST(JsonEncoder, WritesShortestRoundTripDoubles) {
+  std::vector<double> numbers {
+    0.1,
+    1.0,
+    -2.5,
+    1.0 / 3,
+    1e300,
+    5e-324,
+    std::numeric_limits<double>::max(),
+  };
+  std::ostringstream out;
+  zen::make_json_encoder(out)->transform(numbers);
+  ASSERT_EQ(out.str(), "[0.1,1.0,-2.5,0.3333333333333333,1e+300,5e-324,1.7976931348623157e+308]");
+  auto parsed = zen::parse_json(out.str()).unwrap();
+  for (std::size_t i = 0; i < numbers.size(); ++i) {
+    ASSERT_EQ(parsed.as_array()[i].as_fractional(), numbers[i]);
+  }
+}
+
+TEST(JsonEncoder, WritesFloatsWithTheirOwnPrecision) {
+  std::vector<float> numbers { 0.1f, 16777216.0f };
+  std::ostringstream out;
+  zen::make_json_encoder(out)->transform(numbers);
+  ASSERT_EQ(out.str(), "[0.1,16777216.0]");
+}
+
+TEST(JsonEncoder, WritesNonFiniteNumbersAsNull) {
+  std::vector<double> numbers {
+    std::numeric_limits<double>::infinity(),
+    std::numeric_limits<double>::quiet_NaN(),
+  };
+  std::ostringstream out;
+  zen::make_json_encoder(out)->transform(numbers);
+  ASSERT_EQ(out.str(), "[null,null]");
+}
+
+TEST(JsonPrint, FractionalNumbersRoundTrip) {
+  zen::value v = 0.1 + 0.2;
+  auto printed = zen::to_string(v);
+  ASSERT_EQ(printed, "0.30000000000000004");
+  ASSERT_EQ(zen::parse_json(printed).unwrap().as_fractional(), 0.1 + 0.2);
+  ASSERT_EQ(zen::to_string(zen::value(2.0)), "2.0");
+}
+
+/// The straightforward way to escape a string, to compare against.
+static std::string naive_json_string(const std::string& str) {
+  std::string out = "\"";
+  for (unsigned char ch: str) {
+    switch (ch) {
+      case '"': out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\b': out += "\\b"; break;
+      case '\f': out += "\\f"; break;
+      case '\n': out += "\\n"; break;
+      case '\r': out += "\\r"; break;
+      case '\t': out += "\\t"; break;
+      default:
+        if (ch < 0x20) {
+          char escape[7];
+          std::snprintf(escape, sizeof(escape), "\\u%04x", ch);
+          out += escape;
+        } else {
+          out.push_back(ch);
+        }
+    }
+  }
+  out += "\"";
+  return out;
+}
+
+TEST(JsonEncoder, EscapesStringsOfAnyLength) {
+  std::mt19937 rng(42);
+  const char alphabet[] = "abc \"\\\n\t\x01\x1f\xc3\xa9";
+  for (std::size_t size = 0; size < 300; ++size) {
+    std::string str;
+    for (std::size_t i = 0; i < size; ++i) {
+      str.push_back(rng() % 4 == 0 ? alphabet[rng() % (sizeof(alphabet) - 1)] : 'x');
+    }
+    zen::output_buffer out;
+    zen::write_json_string(out, str);
+    ASSERT_EQ(out.view(), naive_json_string(str)) << size;
+  }
+}
+
+TEST(JsonPrint, EncodesStringsAsUTF8) {
+  auto v = zen::parse_json(std::string_view("\"a\\\"b\\\\c\\n\\u0001 caf\xc3\xa9 \xf0\x9f\x98\x80\"")).unwrap();
+  auto printed = zen::to_string(v);
+  ASSERT_EQ(printed, "\"a\\\"b\\\\c\\n\\u0001 caf\xc3\xa9 \xf0\x9f\x98\x80\"");
+  ASSERT_EQ(zen::parse_json(printed).unwrap().as_string(), v.as_string());
+  // A lone surrogate can't be encoded, so it is escaped instead
+  ASSERT_EQ(zen::to_string(zen::value(zen::string { 'a', 0xD800 })), "\"a\\ud800\"");
+}
+
+TEST(JsonPrint, NarrowsLongStrings) {
+  std::string text;
+  for (std::size_t i = 0; i < 10000; ++i) {
+    text.push_back(i % 1000 == 999 ? '\n' : 'a' + i % 26);
+  }
+  auto v = zen::parse_json(naive_json_string(text)).unwrap();
+  ASSERT_EQ(zen::to_string(v), naive_json_string(text));
+}
+
+TEST(JsonPrint, PrettyPrintsByDefault) {
+  auto v = zen::parse_json(std::string_view("{\"a\":[1,{\"b\":null}],\"c\":{},\"d\":[]}")).unwrap();
+  ASSERT_EQ(zen::to_string(v),
+    "{\n"
+    "  \"a\": [\n"
+    "    1,\n"
+    "    {\n"
+    "      \"b\": null\n"
+    "    }\n"
+    "  ],\n"
+    "  \"c\": {},\n"
+    "  \"d\": []\n"
+    "}");
+  zen::json_print_opts opts;
+  opts.indentation = "\t";
+  ASSERT_EQ(zen::to_string(zen::parse_json(std::string_view("[[true]]")).unwrap(), opts), "[\n\t[\n\t\ttrue\n\t]\n]");
+}
+
+TEST(JsonPrint, CanPrintCompactly) {
+  std::string_view document = "{\"a\":[1,{\"b\":null}],\"c\":{},\"d\":[],\"e\":\"x\"}";
+  zen::json_print_opts opts;
+  opts.indentation = "";
+  ASSERT_EQ(zen::to_string(zen::parse_json(document).unwrap(), opts), document);
+}
+
+TEST(JsonPrint, HandlesDeeplyNestedValues) {
+  const std::size_t depth = 10000;
+  std::string document(depth, '[');
+  document += "1";
+  document.append(depth, ']');
+  zen::json_print_opts opts;
+  opts.indentation = "";
+  ASSERT_EQ(zen::to_string(zen::parse_json(document).unwrap(), opts), document);
+}
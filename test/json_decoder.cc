@@ -0,0 +1,262 @@
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "zen/json.hpp"
+#include "zen/json_decoder.hpp"
+#include "zen/json_encoder.hpp"
+
+struct location {
+
+  std::string city;
+  std::optional<int> zip;
+
+  template<typename TransformerT>
+  void transform_fields(TransformerT& t) {
+    t.transform_field("city", city);
+    t.transform_field("zip", zip);
+  }
+
+};
+
+struct account {
+
+  std::string name;
+  unsigned long long id = 0;
+  short level = 0;
+  double balance = 0;
+  float ratio = 0;
+  bool active = false;
+  char grade = ' ';
+  location home;
+  std::vector<location> others;
+  std::unique_ptr<location> work;
+  std::pair<std::string, long> tag;
+  std::vector<std::vector<int>> matrix;
+
+  template<typename TransformerT>
+  void transform_fields(TransformerT& t) {
+    t.transform_field("name", name);
+    t.transform_field("id", id);
+    t.transform_field("level", level);
+    t.transform_field("balance", balance);
+    t.transform_field("ratio", ratio);
+    t.transform_field("active", active);
+    t.transform_field("grade", grade);
+    t.transform_field("home", home);
+    t.transform_field("others", others);
+    t.transform_field("work", work);
+    t.transform_field("tag", tag);
+    t.transform_field("matrix", matrix);
+  }
+
+};
+
+static const char account_json[] = R"({
+  "name": "Ann \"the\" Coder é",
+  "id": 18446744073709551615,
+  "level": -3,
+  "balance": 1.5e3,
+  "ratio": 0.25,
+  "active": true,
+  "grade": "A",
+  "home": { "city": "Ghent", "zip": 9000 },
+  "others": [ { "zip": null, "city": "Paris" }, {} ],
+  "work": { "city": "Brussels" },
+  "tag": [ "x", -7 ],
+  "matrix": [ [1, 2], [], [3] ]
+})";
+
+static void check_account(const account& a) {
+  ASSERT_EQ(a.name, "Ann \"the\" Coder \xc3\xa9");
+  ASSERT_EQ(a.id, std::numeric_limits<unsigned long long>::max());
+  ASSERT_EQ(a.level, -3);
+  ASSERT_EQ(a.balance, 1500);
+  ASSERT_EQ(a.ratio, 0.25f);
+  ASSERT_TRUE(a.active);
+  ASSERT_EQ(a.grade, 'A');
+  ASSERT_EQ(a.home.city, "Ghent");
+  ASSERT_EQ(a.home.zip, 9000);
+  ASSERT_EQ(a.others.size(), 2);
+  ASSERT_EQ(a.others[0].city, "Paris");
+  ASSERT_FALSE(a.others[0].zip.has_value());
+  ASSERT_EQ(a.others[1].city, "");
+  ASSERT_NE(a.work, nullptr);
+  ASSERT_EQ(a.work->city, "Brussels");
+  ASSERT_EQ(a.tag.first, "x");
+  ASSERT_EQ(a.tag.second, -7);
+  ASSERT_EQ(a.matrix, (std::vector<std::vector<int>> { { 1, 2 }, {}, { 3 } }));
+}
+
+TEST(JsonDecoder, DecodesTransformFieldsStatically) {
+  account a;
+  ASSERT_TRUE(zen::decode_json(std::string_view(account_json), a).is_right());
+  check_account(a);
+}
+
+TEST(JsonDecoder, AcceptsKeysInAnyOrderAndSkipsUnknownOnes) {
+  location l;
+  auto result = zen::decode_json(
+    std::string_view(R"({"unknown":{"a":[1,{"b":"}"}]},"zip":1000,"other":"x","city":"Brussels"})"),
+    l
+  );
+  ASSERT_TRUE(result.is_right());
+  ASSERT_EQ(l.city, "Brussels");
+  ASSERT_EQ(l.zip, 1000);
+}
+
+TEST(JsonDecoder, LeavesMissingFieldsAlone) {
+  location l { "Ghent", 9000 };
+  ASSERT_TRUE(zen::decode_json(std::string_view("{\"city\":\"Paris\"}"), l).is_right());
+  ASSERT_EQ(l.city, "Paris");
+  ASSERT_EQ(l.zip, 9000);
+}
+
+TEST(JsonDecoder, ReportsErrors) {
+  std::vector<std::pair<std::string, zen::json_parse_error>> cases {
+    { "{\"city\":1}", zen::json_parse_error::type_mismatch },
+    { "{\"zip\":1.5}", zen::json_parse_error::type_mismatch },
+    { "{\"zip\":99999999999}", zen::json_parse_error::number_out_of_range },
+    { "{\"city\":\"a\",}", zen::json_parse_error::unexpected_character },
+    { "{\"city\":\"a\"", zen::json_parse_error::unexpected_character },
+    { "{\"city\":\"a\"} x", zen::json_parse_error::unexpected_character },
+    { "[]", zen::json_parse_error::type_mismatch },
+  };
+  for (const auto& [input, error]: cases) {
+    location l;
+    auto result = zen::decode_json(std::string_view(input), l);
+    ASSERT_TRUE(result.is_left()) << input;
+    ASSERT_EQ(result.left(), error) << input;
+  }
+  std::vector<unsigned> numbers;
+  auto result = zen::decode_json(std::string_view("[1,-1]"), numbers);
+  ASSERT_EQ(result.left(), zen::json_parse_error::number_out_of_range);
+  std::vector<std::pair<std::string, zen::json_parse_error>> unsigned_cases {
+    { "[2e19]", zen::json_parse_error::number_out_of_range },
+    { "[-1e19]", zen::json_parse_error::number_out_of_range },
+    { "[1e-1]", zen::json_parse_error::type_mismatch },
+  };
+  for (const auto& [input, error]: unsigned_cases) {
+    std::vector<unsigned long long> values;
+    auto result = zen::decode_json(std::string_view(input), values);
+    ASSERT_TRUE(result.is_left()) << input;
+    ASSERT_EQ(result.left(), error) << input;
+  }
+}
+
+TEST(JsonDecoder, ReadsUnsignedIntegersWithAnExponent) {
+  std::vector<unsigned long long> values;
+  auto result = zen::decode_json(std::string_view("[1e19, 1.8e19, 1e3, -0.0]"), values);
+  ASSERT_TRUE(result.is_right());
+  ASSERT_EQ(values, (std::vector<unsigned long long> { 10000000000000000000ULL, 18000000000000000000ULL, 1000, 0 }));
+  std::vector<long long> signed_values;
+  auto signed_result = zen::decode_json(std::string_view("[1e19]"), signed_values);
+  ASSERT_EQ(signed_result.left(), zen::json_parse_error::number_out_of_range);
+}
+
+struct tree {
+
+  std::vector<tree> children;
+
+  template<typename TransformerT>
+  void transform_fields(TransformerT& t) {
+    t.transform_field("children", children);
+  }
+
+};
+
+TEST(JsonDecoder, LimitsTheNestingDepth) {
+  std::string input;
+  for (std::size_t i = 0; i < 2000; ++i) {
+    input += "{\"children\":[";
+  }
+  tree t;
+  auto result = zen::decode_json(std::string_view(input), t);
+  ASSERT_EQ(result.left(), zen::json_parse_error::max_depth_exceeded);
+}
+
+/// Can only be decoded through the virtual interface.
+struct legacy_account {
+
+  std::string name;
+  int level = 0;
+  std::optional<std::string> note;
+  std::vector<int> scores;
+  std::shared_ptr<int> extra;
+  std::pair<bool, double> flags;
+
+  void transform(zen::transformer& t) {
+    auto s = t.transform_object("legacy_account");
+    s.transform_field("name", name);
+    s.transform_field("level", level);
+    s.transform_field("note", note);
+    s.transform_field("scores", scores);
+    s.transform_field("extra", extra);
+    s.transform_field("flags", flags);
+    s.finalize();
+  }
+
+};
+
+TEST(JsonDecoder, DecodesThroughTheVirtualInterface) {
+  std::istringstream in(R"([
+    { "name": "a", "level": 1, "note": "hi", "scores": [1, 2], "extra": 5, "flags": [true, 0.5] },
+    { "scores": [], "unknown": [1, 2, 3], "name": "b", "note": null, "extra": null },
+    { "level": 3 }
+  ])");
+  auto decoder = zen::make_json_decoder(in);
+  std::vector<legacy_account> accounts;
+  accounts.resize(3);
+  accounts[2].note = "kept";
+  accounts[2].scores = { 7 };
+  decoder->transform(accounts);
+  ASSERT_TRUE(decoder->finish().is_right());
+  ASSERT_EQ(accounts.size(), 3);
+  ASSERT_EQ(accounts[0].name, "a");
+  ASSERT_EQ(accounts[0].level, 1);
+  ASSERT_EQ(accounts[0].note, "hi");
+  ASSERT_EQ(accounts[0].scores, (std::vector<int> { 1, 2 }));
+  ASSERT_EQ(*accounts[0].extra, 5);
+  ASSERT_EQ(accounts[0].flags, std::make_pair(true, 0.5));
+  ASSERT_EQ(accounts[1].name, "b");
+  ASSERT_FALSE(accounts[1].note.has_value());
+  ASSERT_EQ(accounts[1].extra, nullptr);
+  ASSERT_TRUE(accounts[1].scores.empty());
+  ASSERT_EQ(accounts[2].level, 3);
+}
+
+TEST(JsonDecoder, VirtualInterfaceLeavesMissingFieldsAlone) {
+  legacy_account a;
+  a.note = "kept";
+  a.scores = { 7 };
+  a.extra = std::make_shared<int>(8);
+  zen::json_decoder decoder(std::string_view("{ \"level\": 3 }"));
+  decoder.transform(a);
+  ASSERT_TRUE(decoder.finish().is_right());
+  ASSERT_EQ(a.level, 3);
+  ASSERT_EQ(a.note, "kept");
+  ASSERT_EQ(a.scores, std::vector<int> { 7 });
+  ASSERT_EQ(*a.extra, 8);
+}
+
+TEST(JsonDecoder, RoundTripsWhatTheEncoderWrites) {
+  account a;
+  ASSERT_TRUE(zen::decode_json(std::string_view(account_json), a).is_right());
+  for (auto indentation: { "", "  " }) {
+    zen::json_encode_opts opts;
+    opts.indentation = indentation;
+    zen::output_buffer out;
+    zen::encode_json(out, a, opts);
+    account b;
+    ASSERT_TRUE(zen::decode_json(out.view(), b).is_right()) << out.view();
+    check_account(b);
+  }
+}
@@ -0,0 +1,85 @@
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "zen/json_document.hpp"
+
+TEST(JsonDocument, CanReadScalars) {
+  auto doc = zen::parse_json_document("[null,true,false,42,2.5,\"foo\\nbar\"]").unwrap();
+  auto root = doc.root();
+  ASSERT_TRUE(root.is_array());
+  ASSERT_EQ(root.as_array().size(), 6);
+  ASSERT_TRUE(root[0].is_null());
+  ASSERT_TRUE(root[1].is_true());
+  ASSERT_TRUE(root[2].is_false());
+  ASSERT_EQ(root[3].as_integer(), 42);
+  ASSERT_EQ(root[4].as_fractional(), 2.5);
+  ASSERT_EQ(root[5].as_string(), "foo\nbar");
+}
+
+TEST(JsonDocument, CanLookUpNestedMembers) {
+  auto doc = zen::parse_json_document(
+    "{\"skip\":{\"a\":[1,2,[3]],\"b\":{}},\"server\":{\"host\":\"localhost\",\"port\":8080}}"
+  ).unwrap();
+  auto root = doc.root();
+  ASSERT_EQ(root.as_object().size(), 2);
+  ASSERT_EQ(root["server"]["host"].as_string(), "localhost");
+  ASSERT_EQ(root["server"]["port"].as_integer(), 8080);
+  ASSERT_FALSE(root.find("missing").has_value());
+  ASSERT_TRUE(root["skip"]["b"].as_object().empty());
+  ASSERT_EQ(root["skip"]["a"][2][0].as_integer(), 3);
+}
+
+TEST(JsonDocument, IteratesInInputOrder) {
+  auto doc = zen::parse_json_document("{\"c\":1,\"a\":[true],\"b\":\"x\"}").unwrap();
+  std::vector<std::string> keys;
+  for (auto [key, member]: doc.root().as_object()) {
+    keys.push_back(std::string(key));
+  }
+  std::vector<std::string> expected { "c", "a", "b" };
+  ASSERT_EQ(keys, expected);
+  std::size_t count = 0;
+  for (auto element: doc.root()["a"].as_array()) {
+    ASSERT_TRUE(element.is_true());
+    ++count;
+  }
+  ASSERT_EQ(count, 1);
+}
+
+TEST(JsonDocument, CanParseEmptyContainers) {
+  auto doc = zen::parse_json_document("[[],{}]").unwrap();
+  auto root = doc.root();
+  ASSERT_EQ(root.as_array().size(), 2);
+  ASSERT_TRUE(root[0].as_array().empty());
+  ASSERT_EQ(root[0].as_array().size(), 0);
+  ASSERT_TRUE(root[1].as_object().empty());
+  ASSERT_EQ(root[1].as_object().begin(), root[1].as_object().end());
+}
+
+TEST(JsonDocument, ReportsErrors) {
+  ASSERT_TRUE(zen::parse_json_document("{\"a\":").is_left());
+  ASSERT_TRUE(zen::parse_json_document("[1 2]").is_left());
+  ASSERT_TRUE(zen::parse_json_document("1 2").is_left());
+  ASSERT_TRUE(zen::parse_json_document("[1,2]x").is_left());
+}
+
+TEST(JsonDocument, CanBorrowStringsFromTheInput) {
+  std::string input = "{\"name\":\"plain\",\"escaped\":\"a\\tb\",\"empty\":\"\"}";
+  zen::json_parse_opts opts;
+  opts.borrow_strings = true;
+  auto doc = zen::parse_json_document(input, opts).unwrap();
+  auto root = doc.root();
+  auto name = root["name"].as_string();
+  ASSERT_EQ(name, "plain");
+  ASSERT_GE(name.data(), input.data());
+  ASSERT_LT(name.data(), input.data() + input.size());
+  auto escaped = root["escaped"].as_string();
+  ASSERT_EQ(escaped, "a\tb");
+  ASSERT_TRUE(escaped.data() < input.data() || escaped.data() >= input.data() + input.size());
+  ASSERT_TRUE(root["empty"].is_string());
+  ASSERT_EQ(root["empty"].as_string(), "");
+  auto copied = zen::parse_json_document(input).unwrap();
+  ASSERT_LT(doc.memory_usage(), copied.memory_usage());
+}
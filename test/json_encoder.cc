@@ -0,0 +1,142 @@
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "zen/json.hpp"
+#include "zen/json_encoder.hpp"
+
+struct address {
+
+  std::string city;
+  std::optional<int> zip;
+
+  template<typename TransformerT>
+  void transform_fields(TransformerT& t) {
+    t.transform_field("city", city);
+    t.transform_field("zip", zip);
+  }
+
+};
+
+/// Can only be encoded through the static path, because it has no
+/// transform() method.
+struct person {
+
+  std::string name;
+  unsigned age;
+  double score;
+  bool active;
+  address home;
+  std::vector<address> others;
+  std::unique_ptr<address> work;
+  std::pair<char, long long> code;
+
+  template<typename TransformerT>
+  void transform_fields(TransformerT& t) {
+    t.transform_field("name", name);
+    t.transform_field("age", age);
+    t.transform_field("score", score);
+    t.transform_field("active", active);
+    t.transform_field("home", home);
+    t.transform_field("others", others);
+    t.transform_field("work", work);
+    t.transform_field("code", code);
+  }
+
+};
+
+static person make_person() {
+  person p;
+  p.name = "Ann \"the\" Coder";
+  p.age = 42;
+  p.score = 0.5;
+  p.active = true;
+  p.home = address { "Ghent", 9000 };
+  p.others.push_back(address { "Paris", std::nullopt });
+  p.code = { 'x', -7 };
+  return p;
+}
+
+TEST(JsonEncoder, EncodesTransformFieldsStatically) {
+  auto p = make_person();
+  zen::output_buffer out;
+  zen::encode_json(out, p);
+  ASSERT_EQ(
+    out.view(),
+    "{\"name\":\"Ann \\\"the\\\" Coder\",\"age\":42,\"score\":0.5,\"active\":true,"
+    "\"home\":{\"city\":\"Ghent\",\"zip\":9000},\"others\":[{\"city\":\"Paris\",\"zip\":null}],"
+    "\"work\":null,\"code\":[\"x\",-7]}"
+  );
+}
+
+/// Has both kinds of methods, so that the virtual interface can be compared
+/// with the static one.
+struct wrapper {
+
+  person inner;
+  std::vector<int> numbers;
+
+  void transform(zen::transformer& t) {
+    auto s = t.transform_object("wrapper");
+    s.transform_field("numbers", numbers);
+    s.finalize();
+  }
+
+  template<typename TransformerT>
+  void transform_fields(TransformerT& t) {
+    t.transform_field("numbers", numbers);
+  }
+
+};
+
+/// Only has the virtual interface.
+struct legacy {
+
+  int id;
+  std::optional<std::string> label;
+
+  void transform(zen::transformer& t) {
+    auto s = t.transform_object("legacy");
+    s.transform_field("id", id);
+    s.transform_field("label", label);
+    s.finalize();
+  }
+
+};
+
+TEST(JsonEncoder, StaticAndVirtualEncodingAgree) {
+  std::vector<wrapper> items(3);
+  items[1].numbers = { 1, 2, 3 };
+  for (auto indentation: { "", "  " }) {
+    zen::json_encode_opts opts;
+    opts.indentation = indentation;
+    std::ostringstream dynamic;
+    zen::make_json_encoder(dynamic, opts)->transform(items);
+    zen::output_buffer out;
+    zen::encode_json(out, items, opts);
+    ASSERT_EQ(out.view(), dynamic.str());
+  }
+}
+
+TEST(JsonEncoder, FallsBackToTheVirtualInterface) {
+  std::vector<legacy> items { { 1, "one" }, { 2, std::nullopt } };
+  std::ostringstream out;
+  zen::encode_json(out, items);
+  ASSERT_EQ(out.str(), "[{\"id\":1,\"label\":\"one\"},{\"id\":2,\"label\":null}]");
+}
+
+TEST(JsonEncoder, CanEncodePrettily) {
+  std::vector<address> items { { "Ghent", 9000 } };
+  std::vector<address> empty;
+  zen::output_buffer out;
+  zen::encode_json_pretty(out, items);
+  ASSERT_EQ(out.view(), "[\n    {\n        \"city\": \"Ghent\",\n        \"zip\": 9000\n    }\n]");
+  out.clear();
+  zen::encode_json_pretty(out, empty);
+  ASSERT_EQ(out.view(), "[\n]");
+}
@@ -0,0 +1,153 @@
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+#include "gtest/gtest.h"
+
+#include "zen/json.hpp"
+#include "zen/json_parallel.hpp"
+
+static zen::value generate_rows(std::size_t count) {
+  std::string document = "[";
+  for (std::size_t i = 0; i < count; ++i) {
+    if (i > 0) {
+      document += ",";
+    }
+    document += "{\"id\":" + std::to_string(i) + ",\"tags\":[\"a\",\"b\"],\"nested\":{\"x\":[]}}";
+  }
+  document += "]";
+  return zen::parse_json(document).unwrap();
+}
+
+TEST(JsonParallel, PrintsTheSameAsPrint) {
+  auto v = generate_rows(1000);
+  for (auto indentation: { "", "  " }) {
+    zen::json_print_opts print_opts;
+    print_opts.indentation = indentation;
+    auto expected = zen::to_string(v, print_opts);
+    for (std::size_t threads: { 1, 2, 4 }) {
+      for (std::size_t chunk_size: { 1, 7, 100, 5000 }) {
+        zen::json_parallel_opts opts;
+        opts.threads = threads;
+        opts.chunk_size = chunk_size;
+        zen::output_buffer out;
+        zen::print_parallel(v, out, print_opts, opts);
+        ASSERT_EQ(out.view(), expected) << threads << " " << chunk_size;
+      }
+    }
+  }
+}
+
+TEST(JsonParallel, PrintsValuesThatAreNotLargeArrays) {
+  zen::json_parallel_opts opts;
+  opts.threads = 4;
+  for (auto document: { "[]", "{\"a\":[1,2]}", "42", "[1]" }) {
+    auto v = zen::parse_json(std::string_view(document)).unwrap();
+    zen::output_buffer out;
+    zen::print_parallel(v, out, {}, opts);
+    ASSERT_EQ(out.view(), zen::to_string(v));
+  }
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+
+TEST(JsonParallel, CanWriteToAFileDescriptor) {
+  auto v = generate_rows(500);
+  auto file = std::tmpfile();
+  ASSERT_NE(file, nullptr);
+  zen::json_parallel_opts opts;
+  opts.threads = 3;
+  opts.chunk_size = 16;
+  ASSERT_TRUE(zen::print_parallel(v, fileno(file), {}, opts).is_right());
+  auto expected = zen::to_string(v);
+  std::string contents(expected.size() + 1, '\0');
+  std::rewind(file);
+  contents.resize(std::fread(contents.data(), 1, contents.size(), file));
+  ASSERT_EQ(contents, expected);
+  std::fclose(file);
+}
+
+TEST(JsonParallel, ReportsWriteErrors) {
+  auto v = generate_rows(100);
+  zen::json_parallel_opts opts;
+  opts.threads = 2;
+  opts.chunk_size = 10;
+  ASSERT_TRUE(zen::print_parallel(v, -1, {}, opts).is_left());
+}
+
+#endif
+
+struct row {
+
+  int id;
+  std::string name;
+  std::vector<double> values;
+
+  void transform(zen::transformer& t) {
+    if (id < 0) {
+      throw std::runtime_error("invalid row");
+    }
+    auto s = t.transform_object("row");
+    s.transform_field("id", id);
+    s.transform_field("name", name);
+    s.transform_field("values", values);
+    s.finalize();
+  }
+
+};
+
+static std::string encode_sequentially(std::vector<row>& rows, const zen::json_encode_opts& opts) {
+  std::ostringstream out;
+  zen::make_json_encoder(out, opts)->transform(rows);
+  return out.str();
+}
+
+TEST(JsonParallel, EncodesTheSameAsTheEncoder) {
+  std::vector<row> rows;
+  for (int i = 0; i < 500; ++i) {
+    rows.push_back(row { i, "row " + std::to_string(i), { i * 0.5, 1.0 } });
+  }
+  std::vector<row> empty;
+  for (auto indentation: { "", "  " }) {
+    zen::json_encode_opts encode_opts;
+    encode_opts.indentation = indentation;
+    for (std::size_t threads: { 1, 3 }) {
+      zen::json_parallel_opts opts;
+      opts.threads = threads;
+      opts.chunk_size = 32;
+      zen::output_buffer out;
+      zen::encode_json_parallel(rows, out, encode_opts, opts);
+      ASSERT_EQ(out.view(), encode_sequentially(rows, encode_opts));
+      out.clear();
+      zen::encode_json_parallel(empty, out, encode_opts, opts);
+      ASSERT_EQ(out.view(), encode_sequentially(empty, encode_opts));
+    }
+  }
+}
+
+TEST(JsonParallel, PassesOnExceptionsOfWorkers) {
+  std::vector<row> rows(1000, row { 1, "a", {} });
+  rows[777].id = -1;
+  zen::json_parallel_opts opts;
+  opts.threads = 4;
+  opts.chunk_size = 10;
+  zen::output_buffer out;
+  ASSERT_THROW(zen::encode_json_parallel(rows, out, {}, opts), std::runtime_error);
+}
+
+TEST(JsonParallel, PassesOnExceptionsOfTheSink) {
+  auto v = generate_rows(1000);
+  zen::json_parallel_opts opts;
+  opts.threads = 4;
+  opts.chunk_size = 10;
+  zen::output_buffer out([](const char*, std::size_t) {
+    throw std::runtime_error("disk full");
+  }, 16);
+  ASSERT_THROW(zen::print_parallel(v, out, {}, opts), std::runtime_error);
+}
@@ -0,0 +1,249 @@
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "zen/json.hpp"
+#include "zen/json_path.hpp"
+
+static const char* example = R"({
+  "store": {
+    "book": [
+      { "title": "Sayings of the Century", "price": 8 },
+      { "title": "Sword of Honour", "price": 12 },
+      { "title": "Moby Dick", "price": 9 }
+    ],
+    "a/b": 1,
+    "m~n": 2,
+    "0": "zero"
+  }
+})";
+
+static zen::string make_string(std::string_view text) {
+  return zen::string(text.begin(), text.end());
+}
+
+TEST(JsonPath, CanEvaluateJsonPointers) {
+  auto doc = zen::parse_json(example).unwrap();
+  auto p1 = zen::compile_json_pointer("/store/book/1/title").unwrap();
+  ASSERT_TRUE(p1.is_singular());
+  auto m1 = p1.find(doc);
+  ASSERT_NE(m1, nullptr);
+  ASSERT_EQ(m1->as_string(), make_string("Sword of Honour"));
+  ASSERT_EQ(zen::compile_json_pointer("/store/a~1b").unwrap().find(doc)->as_integer(), 1);
+  ASSERT_EQ(zen::compile_json_pointer("/store/m~0n").unwrap().find(doc)->as_integer(), 2);
+  ASSERT_EQ(zen::compile_json_pointer("/store/0").unwrap().find(doc)->as_string(), make_string("zero"));
+  ASSERT_EQ(zen::compile_json_pointer("").unwrap().find(doc), &doc);
+  ASSERT_EQ(zen::compile_json_pointer("/store/book/3").unwrap().find(doc), nullptr);
+  ASSERT_EQ(zen::compile_json_pointer("/store/book/-").unwrap().find(doc), nullptr);
+  ASSERT_EQ(zen::compile_json_pointer("/missing/x").unwrap().find(doc), nullptr);
+}
+
+TEST(JsonPath, RejectsInvalidPointers) {
+  ASSERT_TRUE(zen::compile_json_pointer("store").is_left());
+  ASSERT_TRUE(zen::compile_json_pointer("/a~2").is_left());
+  ASSERT_TRUE(zen::compile_json_pointer("/a~").is_left());
+}
+
+TEST(JsonPath, CanEvaluateJsonPaths) {
+  auto doc = zen::parse_json(example).unwrap();
+  ASSERT_EQ(zen::compile_json_path("$.store.book[0].price").unwrap().find(doc)->as_integer(), 8);
+  ASSERT_EQ(zen::compile_json_path("$['store'][\"book\"][-1].price").unwrap().find(doc)->as_integer(), 9);
+  ASSERT_EQ(zen::compile_json_path("$.store['a/b']").unwrap().find(doc)->as_integer(), 1);
+  auto p1 = zen::compile_json_path("$.store.book[*].title").unwrap();
+  ASSERT_FALSE(p1.is_singular());
+  std::vector<const zen::value*> titles;
+  p1.evaluate(doc, titles);
+  ASSERT_EQ(titles.size(), 3);
+  ASSERT_EQ(titles[2]->as_string(), make_string("Moby Dick"));
+  std::vector<const zen::value*> members;
+  zen::compile_json_path("$.store.*").unwrap().evaluate(doc, members);
+  ASSERT_EQ(members.size(), 4);
+}
+
+TEST(JsonPath, RejectsInvalidPaths) {
+  for (auto text: { "", "store", "$..book", "$.", "$[", "$['a'", "$[01]", "$[a]", "$.a[0" }) {
+    ASSERT_TRUE(zen::compile_json_path(text).is_left()) << text;
+  }
+}
+
+TEST(JsonPath, QuerySetGivesSameResultsAsSinglePaths) {
+  auto doc = zen::parse_json(example).unwrap();
+  std::vector<zen::json_path> paths {
+    zen::compile_json_path("$.store.book[*].price").unwrap(),
+    zen::compile_json_path("$.store.book[1].title").unwrap(),
+    zen::compile_json_pointer("/store/book/1/title").unwrap(),
+    zen::compile_json_pointer("/store/0").unwrap(),
+    zen::compile_json_path("$.store.missing").unwrap(),
+    zen::compile_json_path("$").unwrap(),
+  };
+  zen::json_query_set set;
+  for (auto& path: paths) {
+    set.add(path);
+  }
+  ASSERT_EQ(set.size(), paths.size());
+  std::vector<std::vector<const zen::value*>> results;
+  set.evaluate(doc, results);
+  ASSERT_EQ(results.size(), paths.size());
+  for (std::size_t i = 0; i < paths.size(); ++i) {
+    std::vector<const zen::value*> expected;
+    paths[i].evaluate(doc, expected);
+    ASSERT_EQ(results[i], expected) << i;
+  }
+}
+
+TEST(JsonPath, QuerySetHandlesLargeObjects) {
+  std::string text = "{";
+  for (int i = 0; i < 50; ++i) {
+    text += (i > 0 ? ",\"k" : "\"k") + std::to_string(i) + "\":" + std::to_string(i);
+  }
+  text += "}";
+  auto doc = zen::parse_json(text).unwrap();
+  zen::json_query_set set;
+  for (int i = 0; i < 100; i += 2) {
+    set.add(zen::compile_json_pointer("/k" + std::to_string(i)).unwrap());
+  }
+  std::vector<std::vector<const zen::value*>> results;
+  set.evaluate(doc, results);
+  for (int i = 0; i < 25; ++i) {
+    ASSERT_EQ(results[i].size(), 1);
+    ASSERT_EQ(results[i][0]->as_integer(), i * 2);
+  }
+  for (int i = 25; i < 50; ++i) {
+    ASSERT_TRUE(results[i].empty());
+  }
+}
+
+TEST(JsonPath, QuerySetKeepsMembersAndPointerTokensApart) {
+  for (auto text: { "[10,20,30]", "{\"1\":{\"x\":5}}" }) {
+    auto doc = zen::parse_json(text).unwrap();
+    std::vector<zen::json_path> paths {
+      zen::compile_json_path("$['1']").unwrap(),
+      zen::compile_json_pointer("/1").unwrap(),
+      zen::compile_json_pointer("/1/x").unwrap(),
+      zen::compile_json_path("$['1'].x").unwrap(),
+    };
+    zen::json_query_set set;
+    for (auto& path: paths) {
+      set.add(path);
+    }
+    std::vector<std::vector<const zen::value*>> results;
+    set.evaluate(doc, results);
+    auto extracted = zen::parse_json_paths(text, set).unwrap();
+    for (std::size_t i = 0; i < paths.size(); ++i) {
+      auto expected = paths[i].find(doc);
+      ASSERT_EQ(results[i].size(), expected == nullptr ? 0 : 1) << text << " " << i;
+      ASSERT_EQ(extracted[i].size(), results[i].size()) << text << " " << i;
+      if (expected != nullptr) {
+        ASSERT_EQ(results[i][0], expected);
+        ASSERT_EQ(zen::to_string(extracted[i][0]), zen::to_string(*expected));
+      }
+    }
+  }
+}
+
+TEST(JsonPath, CanFindKeysThatAreInUTF8) {
+  zen::json_parse_opts opts;
+  opts.strings = zen::string_storage::utf8;
+  auto doc = zen::parse_json("{\"a\":1,\"caf\xc3\xa9\":2}", opts).unwrap();
+  ASSERT_EQ(zen::compile_json_pointer("/caf\xc3\xa9").unwrap().find(doc)->as_integer(), 2);
+  zen::json_query_set set;
+  set.add(zen::compile_json_pointer("/caf\xc3\xa9").unwrap());
+  for (int i = 0; i < 10; ++i) {
+    set.add(zen::compile_json_pointer("/k" + std::to_string(i)).unwrap());
+  }
+  std::vector<std::vector<const zen::value*>> results;
+  set.evaluate(doc, results);
+  ASSERT_EQ(results[0].size(), 1);
+  ASSERT_EQ(results[0][0]->as_integer(), 2);
+}
+
+static void expect_same_extraction(std::string_view text, const std::vector<std::string>& queries) {
+  auto doc = zen::parse_json(text).unwrap();
+  zen::json_query_set set;
+  for (auto& query: queries) {
+    set.add(query[0] == '$'
+      ? zen::compile_json_path(query).unwrap()
+      : zen::compile_json_pointer(query).unwrap());
+  }
+  std::vector<std::vector<const zen::value*>> expected;
+  set.evaluate(doc, expected);
+  auto extracted = zen::parse_json_paths(text, set);
+  ASSERT_TRUE(extracted.is_right());
+  auto results = std::move(extracted).unwrap();
+  ASSERT_EQ(results.size(), queries.size());
+  for (std::size_t i = 0; i < queries.size(); ++i) {
+    ASSERT_EQ(results[i].size(), expected[i].size()) << queries[i];
+    for (std::size_t j = 0; j < results[i].size(); ++j) {
+      ASSERT_EQ(zen::to_string(results[i][j]), zen::to_string(*expected[i][j])) << queries[i];
+    }
+  }
+}
+
+TEST(JsonPath, ParseJsonPathsGivesSameResultsAsFullParse) {
+  expect_same_extraction(example, {
+    "$.store.book[*].price",
+    "$.store.book[1].title",
+    "/store/book/1/title",
+    "/store/0",
+    "$.store.missing",
+    "$.store.book[-1]",
+    "$.store.book[-4]",
+    "$.store.book",
+    "$.store.book[0].title",
+    "$.store.*",
+    "$.*.*[*].title",
+    "$",
+  });
+  expect_same_extraction(R"([[1, [2, 3]], {"a": "]}\"{["}, [[], {}], -1.5e3, true, null])", {
+    "$[0][1][-1]",
+    "$[1].a",
+    "$[*]",
+    "$[2][*]",
+    "/3",
+    "$[5]",
+  });
+}
+
+TEST(JsonPath, OnlySelectsTheFirstOfDuplicateKeys) {
+  std::string text = R"({"a": 1, "a": 2, "b": {"c": 3}, "b": {"c": 4}})";
+  std::vector<std::string> queries { "$.a", "/a", "$.b.c", "$.b" };
+  expect_same_extraction(text, queries);
+  // With more paths than members, evaluate() walks the members instead
+  for (int i = 0; i < 10; ++i) {
+    queries.push_back("/k" + std::to_string(i));
+  }
+  expect_same_extraction(text, queries);
+  zen::json_query_set set;
+  for (auto& query: queries) {
+    set.add(query[0] == '$'
+      ? zen::compile_json_path(query).unwrap()
+      : zen::compile_json_pointer(query).unwrap());
+  }
+  auto results = zen::parse_json_paths(text, set).unwrap();
+  ASSERT_EQ(results[0].size(), 1);
+  ASSERT_EQ(results[0][0].as_integer(), 1);
+  ASSERT_EQ(results[1].size(), 1);
+  ASSERT_EQ(results[2].size(), 1);
+  ASSERT_EQ(results[2][0].as_integer(), 3);
+}
+
+TEST(JsonPath, ParseJsonPathsSkipsLargeSubtrees) {
+  std::string text = R"({"skipped": [)";
+  for (int i = 0; i < 1000; ++i) {
+    text += i > 0 ? "," : "";
+    text += R"({"s": "\"}]\\", "n": [)" + std::to_string(i) + "]}";
+  }
+  text += R"(], "wanted": {"x": 1}})";
+  expect_same_extraction(text, { "/wanted/x", "/wanted", "/skipped/999/n/0" });
+}
+
+TEST(JsonPath, ParseJsonPathsRejectsMalformedInput) {
+  zen::json_query_set set;
+  set.add(zen::compile_json_pointer("/a").unwrap());
+  for (auto text: { R"({"a": [1, 2})", R"({"b": "x)", R"({"b": 1 "a": 2})", R"({"a": 01})", R"({"a": 1} x)" }) {
+    ASSERT_TRUE(zen::parse_json_paths(text, set).is_left()) << text;
+  }
+}
@@ -0,0 +1,132 @@
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "zen/ndjson.hpp"
+
+static std::string make_lines(std::size_t count) {
+  std::string out;
+  for (std::size_t i = 0; i < count; ++i) {
+    out += "[" + std::to_string(i) + ",true,[1,2,3]]\n";
+  }
+  return out;
+}
+
+static std::vector<std::size_t> collect_ids(std::vector<zen::ndjson_record>& records) {
+  std::vector<std::size_t> ids;
+  for (auto& record: records) {
+    ids.push_back(record.result.right().as_array()[0].as_integer());
+  }
+  return ids;
+}
+
+TEST(NDJSON, DeliversRecordsInOrder) {
+  auto input = make_lines(5000);
+  for (std::size_t threads: { 1, 2, 4 }) {
+    zen::ndjson_opts opts;
+    opts.threads = threads;
+    opts.batch_size = 1000;
+    std::vector<zen::ndjson_record> records;
+    zen::parse_ndjson(std::string_view(input), [&](zen::ndjson_record& record) {
+      records.push_back(std::move(record));
+    }, opts);
+    ASSERT_EQ(records.size(), 5000);
+    auto ids = collect_ids(records);
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+      ASSERT_EQ(ids[i], i);
+      ASSERT_EQ(records[i].index, i);
+    }
+  }
+}
+
+TEST(NDJSON, UnorderedDeliversEveryRecord) {
+  auto input = make_lines(5000);
+  zen::ndjson_opts opts;
+  opts.threads = 4;
+  opts.ordered = false;
+  opts.batch_size = 1000;
+  std::vector<zen::ndjson_record> records;
+  zen::parse_ndjson(std::string_view(input), [&](zen::ndjson_record& record) {
+    records.push_back(std::move(record));
+  }, opts);
+  auto ids = collect_ids(records);
+  std::sort(ids.begin(), ids.end());
+  ASSERT_EQ(ids.size(), 5000);
+  for (std::size_t i = 0; i < ids.size(); ++i) {
+    ASSERT_EQ(ids[i], i);
+  }
+}
+
+TEST(NDJSON, StreamGivesSameResultsAsBuffer) {
+  auto input = make_lines(3000);
+  std::istringstream in(input);
+  zen::ndjson_opts opts;
+  opts.threads = 3;
+  opts.batch_size = 777;
+  std::vector<zen::ndjson_record> records;
+  zen::parse_ndjson(in, [&](zen::ndjson_record& record) {
+    records.push_back(std::move(record));
+  }, opts);
+  auto ids = collect_ids(records);
+  ASSERT_EQ(ids.size(), 3000);
+  for (std::size_t i = 0; i < ids.size(); ++i) {
+    ASSERT_EQ(ids[i], i);
+    ASSERT_EQ(records[i].index, i);
+  }
+}
+
+TEST(NDJSON, TreatsABatchSizeOfZeroAsOne) {
+  auto input = make_lines(20);
+  zen::ndjson_opts opts;
+  opts.threads = 2;
+  opts.batch_size = 0;
+  std::istringstream in(input);
+  std::vector<zen::ndjson_record> from_buffer;
+  std::vector<zen::ndjson_record> from_stream;
+  zen::parse_ndjson(std::string_view(input), [&](zen::ndjson_record& record) {
+    from_buffer.push_back(std::move(record));
+  }, opts);
+  zen::parse_ndjson(in, [&](zen::ndjson_record& record) {
+    from_stream.push_back(std::move(record));
+  }, opts);
+  ASSERT_EQ(collect_ids(from_buffer).size(), 20);
+  ASSERT_EQ(collect_ids(from_stream), collect_ids(from_buffer));
+}
+
+TEST(NDJSON, ReportsLineOfInvalidRecords) {
+  std::string input = "1\r\n\n[1,2\n\"foo\"";
+  for (std::size_t threads: { 1, 2 }) {
+    zen::ndjson_opts opts;
+    opts.threads = threads;
+    std::vector<std::size_t> indices;
+    std::vector<bool> failed;
+    zen::parse_ndjson(std::string_view(input), [&](zen::ndjson_record& record) {
+      indices.push_back(record.index);
+      failed.push_back(record.result.is_left());
+    }, opts);
+    ASSERT_EQ(indices, std::vector<std::size_t>({ 0, 2, 3 }));
+    ASSERT_EQ(failed, std::vector<bool>({ false, true, false }));
+  }
+}
+
+TEST(NDJSON, CanInternKeysWithSeveralThreads) {
+  std::string input;
+  for (std::size_t i = 0; i < 2000; ++i) {
+    input += "{\"id\":" + std::to_string(i) + "}\n";
+  }
+  zen::key_table table;
+  zen::ndjson_opts opts;
+  opts.threads = 4;
+  opts.batch_size = 1000;
+  opts.parse_opts.keys = &table;
+  std::size_t count = 0;
+  zen::parse_ndjson(std::string_view(input), [&](zen::ndjson_record& record) {
+    ASSERT_EQ(record.result.right().as_object().size(), 1);
+    ++count;
+  }, opts);
+  ASSERT_EQ(count, 2000);
+}
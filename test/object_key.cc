@@ -0,0 +1,90 @@
+#include <functional>
+#include <string_view>
+#include <type_traits>
+
+#include "gtest/gtest.h"
+
+#include "zen/alloc.hpp"
+#include "zen/object_key.hpp"
+
+static zen::string make_string(std::string_view text) {
+  return zen::string(text.begin(), text.end());
+}
+
+TEST(ObjectKey, ComparesAndHashesLikeAString) {
+  auto text = make_string("name");
+  zen::object_key key(text);
+  ASSERT_EQ(key.size(), 4);
+  ASSERT_TRUE(key == text);
+  ASSERT_TRUE(text == key);
+  ASSERT_TRUE(key != make_string("other"));
+  ASSERT_EQ(key.hash(), zen::string_hash{}(text));
+  ASSERT_EQ(std::hash<zen::object_key>{}(key), key.hash());
+  zen::object_key empty;
+  ASSERT_TRUE(empty.empty());
+  ASSERT_EQ(empty.hash(), zen::string_hash{}(zen::string()));
+  ASSERT_TRUE(empty == zen::object_key(zen::string()));
+}
+
+TEST(ObjectKey, CopiesShareTheirCharacters) {
+  zen::object_key key(make_string("shared"));
+  auto copy = key;
+  ASSERT_EQ(copy.view().data(), key.view().data());
+  zen::object_key moved = std::move(copy);
+  ASSERT_EQ(moved.view().data(), key.view().data());
+  ASSERT_TRUE(copy.empty());
+}
+
+TEST(ObjectKey, CopiesLeaveTheArena) {
+  zen::object_key copy;
+  {
+    zen::pool_alloc arena;
+    zen::object_key key(make_string("in the arena"), &arena);
+    copy = key;
+    ASSERT_NE(copy.view().data(), key.view().data());
+  }
+  ASSERT_TRUE(copy == make_string("in the arena"));
+}
+
+TEST(ObjectKey, TableInternsKeys) {
+  zen::key_table table;
+  auto k1 = table.intern("caf\xc3\xa9");
+  auto k2 = table.intern("caf\xc3\xa9");
+  auto k3 = table.intern("bar");
+  ASSERT_EQ(table.size(), 2);
+  ASSERT_EQ(k1.view().data(), k2.view().data());
+  ASSERT_TRUE(k1 == zen::string({ 'c', 'a', 'f', 0xE9 }));
+  ASSERT_TRUE(k3 == make_string("bar"));
+}
+
+TEST(ObjectKey, UTF8KeysMatchKeysOfCodePoints) {
+  zen::object_key utf8(std::string_view("caf\xc3\xa9"));
+  zen::object_key decoded(zen::string({ 'c', 'a', 'f', 0xE9 }));
+  ASSERT_TRUE(utf8.is_utf8());
+  ASSERT_FALSE(decoded.is_utf8());
+  ASSERT_EQ(utf8.utf8(), "caf\xc3\xa9");
+  ASSERT_EQ(utf8.size(), 5);
+  ASSERT_EQ(utf8.hash(), decoded.hash());
+  ASSERT_TRUE(utf8 == decoded);
+  ASSERT_TRUE(decoded == utf8);
+  ASSERT_TRUE(utf8 == zen::string({ 'c', 'a', 'f', 0xE9 }));
+  ASSERT_TRUE(utf8 != make_string("cafe"));
+  ASSERT_TRUE(utf8 != zen::object_key(std::string_view("cafe")));
+  ASSERT_TRUE(utf8 == std::string_view("caf\xc3\xa9"));
+  ASSERT_TRUE(decoded == std::string_view("caf\xc3\xa9"));
+  ASSERT_TRUE(decoded != std::string_view("cafe"));
+  ASSERT_EQ(zen::object_key_hash{}(std::string_view("caf\xc3\xa9")), decoded.hash());
+  ASSERT_FALSE((std::is_convertible_v<std::string_view, zen::object_key>));
+  // A key in UTF-8 would be seen as empty
+  ASSERT_FALSE((std::is_convertible_v<zen::object_key, zen::code_point_view>));
+}
+
+TEST(ObjectKey, TableCanKeepKeysInUTF8) {
+  zen::key_table table(std::pmr::get_default_resource(), zen::string_storage::utf8);
+  auto k1 = table.intern("caf\xc3\xa9");
+  auto k2 = table.intern("caf\xc3\xa9");
+  ASSERT_EQ(table.size(), 1);
+  ASSERT_TRUE(k1.is_utf8());
+  ASSERT_EQ(k1.utf8().data(), k2.utf8().data());
+  ASSERT_TRUE(k1 == zen::string({ 'c', 'a', 'f', 0xE9 }));
+}
@@ -0,0 +1,137 @@
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+#include "gtest/gtest.h"
+
+#include "zen/json.hpp"
+#include "zen/output_buffer.hpp"
+
+TEST(OutputBuffer, KeepsEverythingWithoutASink) {
+  zen::output_buffer out;
+  std::string expected;
+  for (int i = 0; i < 1000; ++i) {
+    out.write("abc");
+    out.put('d');
+    out.fill('e', 3);
+    expected += "abcdeee";
+  }
+  ASSERT_FALSE(out.has_sink());
+  out.flush();
+  ASSERT_EQ(out.view(), expected);
+  out.clear();
+  ASSERT_EQ(out.size(), 0);
+}
+
+TEST(OutputBuffer, FlushesToACallbackInChunks) {
+  std::vector<std::string> chunks;
+  {
+    zen::output_buffer out([&](const char* data, std::size_t size) {
+      chunks.emplace_back(data, size);
+    }, 16);
+    for (int i = 0; i < 10; ++i) {
+      out.write("0123456789");
+    }
+    ASSERT_EQ(chunks.size(), 6);
+    for (const auto& chunk: chunks) {
+      ASSERT_EQ(chunk.size(), 16);
+    }
+    // What doesn't fit in the buffer after topping it up is not copied
+    out.write(std::string(40, 'x'));
+    ASSERT_EQ(chunks.size(), 8);
+    ASSERT_EQ(chunks.back(), std::string(28, 'x'));
+    auto ptr = out.prepare(3);
+    ptr[0] = 'a';
+    ptr[1] = 'b';
+    out.commit(2);
+  }
+  std::string all;
+  for (const auto& chunk: chunks) {
+    all += chunk;
+  }
+  std::string expected;
+  for (int i = 0; i < 10; ++i) {
+    expected += "0123456789";
+  }
+  expected += std::string(40, 'x');
+  expected += "ab";
+  ASSERT_EQ(all, expected);
+}
+
+TEST(OutputBuffer, FlushesToAStreamWhenDestroyed) {
+  std::ostringstream ss;
+  {
+    zen::output_buffer out(ss);
+    out.write("hello");
+    ASSERT_EQ(ss.str(), "");
+  }
+  ASSERT_EQ(ss.str(), "hello");
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+
+TEST(OutputBuffer, CanWriteToAFileDescriptor) {
+  auto file = std::tmpfile();
+  ASSERT_NE(file, nullptr);
+  zen::output_buffer out(fileno(file), 4);
+  out.write("hello, ");
+  out.write("world");
+  out.flush();
+  ASSERT_FALSE(out.error());
+  std::rewind(file);
+  char contents[32] = {};
+  ASSERT_EQ(std::fread(contents, 1, sizeof(contents), file), 12);
+  ASSERT_EQ(std::string(contents), "hello, world");
+  std::fclose(file);
+}
+
+TEST(OutputBuffer, ReportsWriteErrors) {
+  zen::output_buffer out(-1);
+  out.write("hello");
+  out.flush();
+  ASSERT_TRUE(out.error());
+}
+
+#endif
+
+TEST(OutputBuffer, CanPrintValues) {
+  auto v = zen::parse_json(std::string_view("{\"a\":[1,2.5,true,null]}")).unwrap();
+  zen::output_buffer out;
+  zen::print(v, out);
+  ASSERT_EQ(out.view(), zen::to_string(v));
+}
+
+struct point {
+
+  int x;
+  int y;
+
+  void transform(zen::transformer& t) {
+    auto s = t.transform_object("point");
+    s.transform_field("x", x);
+    s.transform_field("y", y);
+    s.finalize();
+  }
+
+};
+
+TEST(OutputBuffer, EncoderCanWriteIntoABuffer) {
+  std::vector<point> points { { 1, 2 }, { -3, 4 } };
+  zen::output_buffer out;
+  auto encoder = zen::make_json_encoder(out);
+  encoder->transform(points);
+  ASSERT_EQ(out.view(), "[{\"x\":1,\"y\":2},{\"x\":-3,\"y\":4}]");
+}
+
+TEST(OutputBuffer, EncoderFlushesToTheStreamAfterEachValue) {
+  std::ostringstream ss;
+  auto encoder = zen::make_json_encoder(ss);
+  std::string str = "a \"quoted\"\n word";
+  encoder->transform(str);
+  ASSERT_EQ(ss.str(), "\"a \\\"quoted\\\"\\n word\"");
+}
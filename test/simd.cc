@@ -0,0 +1,118 @@
+
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <random>
+
+#include "gtest/gtest.h"
+
+#include "zen/simd.hpp"
+
+static void expect_same_masks(const zen::block_masks& a, const zen::block_masks& b) {
+  ASSERT_EQ(a.quote, b.quote);
+  ASSERT_EQ(a.backslash, b.backslash);
+  ASSERT_EQ(a.op, b.op);
+  ASSERT_EQ(a.whitespace, b.whitespace);
+  ASSERT_EQ(a.control, b.control);
+  ASSERT_EQ(a.open, b.open);
+  ASSERT_EQ(a.close, b.close);
+  ASSERT_EQ(a.non_ascii, b.non_ascii);
+}
+
+TEST(SimdClassify, ScalarClassifiesSpecialCharacters) {
+  unsigned char block[zen::simd_block_size];
+  zen::load_partial_block(reinterpret_cast<const unsigned char*>("{\"a\\\": [1,\t2]}"), 14, block);
+  zen::block_masks masks;
+  zen::classify_scalar(block, masks);
+  ASSERT_EQ(masks.quote, 0b10010);
+  ASSERT_EQ(masks.backslash, 0b1000);
+  ASSERT_EQ(masks.op, 0b11001010100001);
+  ASSERT_EQ(masks.control, 0b10000000000);
+  ASSERT_EQ(masks.open, 0b10000001);
+  ASSERT_EQ(masks.close, 0b11000000000000);
+  ASSERT_EQ(masks.non_ascii, 0);
+  // Everything after the 14 bytes of input is padding
+  ASSERT_EQ(masks.whitespace, ~std::uint64_t(0) << 14 | 0b10001000000);
+}
+
+TEST(SimdClassify, AllLevelsAgree) {
+  std::mt19937 rng(42);
+  const char alphabet[] = "{}[]:,\"\\ \t\r\nab01\x01\x7f\x80\xff";
+  unsigned char block[zen::simd_block_size];
+  for (std::size_t round = 0; round < 1000; ++round) {
+    for (auto& ch: block) {
+      ch = alphabet[rng() % (sizeof(alphabet) - 1)];
+    }
+    zen::block_masks expected;
+    zen::classify_scalar(block, expected);
+    for (auto level: { zen::simd_level::sse42, zen::simd_level::avx2 }) {
+      if (level > zen::detect_simd_level()) {
+        continue;
+      }
+      zen::block_masks actual;
+      zen::select_classifier(level)(block, actual);
+      expect_same_masks(expected, actual);
+    }
+  }
+}
+
+TEST(SimdClassify, PrefixXorMarksStringInteriors) {
+  ASSERT_EQ(zen::prefix_xor(0b100010), 0b011110);
+  ASSERT_EQ(zen::prefix_xor(0), 0);
+}
+
+TEST(SimdClassify, EscapedMaskHandlesBackslashRuns) {
+  std::uint64_t carry = 0;
+  // \" escapes the quote, \\" does not
+  ASSERT_EQ(zen::escaped_mask(0b1, carry), 0b10);
+  ASSERT_EQ(carry, 0);
+  ASSERT_EQ(zen::escaped_mask(0b11, carry), 0b10);
+  ASSERT_EQ(carry, 0);
+  ASSERT_EQ(zen::escaped_mask(0b111, carry), 0b1010);
+  // A backslash in the last byte escapes the first byte of the next block
+  ASSERT_EQ(zen::escaped_mask(std::uint64_t(1) << 63, carry), 0);
+  ASSERT_EQ(carry, 1);
+  ASSERT_EQ(zen::escaped_mask(0b1, carry), 0b1);
+  ASSERT_EQ(carry, 0);
+}
+
+TEST(SimdEscape, AllLevelsFindTheSameBytes) {
+  std::mt19937 rng(42);
+  const char alphabet[] = "\"\\ ab\x01\x1f\x7f\x80\xff";
+  unsigned char block[zen::simd_block_size];
+  for (std::size_t round = 0; round < 1000; ++round) {
+    for (auto& ch: block) {
+      ch = alphabet[rng() % (sizeof(alphabet) - 1)];
+    }
+    auto expected = zen::escape_mask_scalar(block);
+    for (auto level: { zen::simd_level::sse42, zen::simd_level::avx2 }) {
+      if (level > zen::detect_simd_level()) {
+        continue;
+      }
+      ASSERT_EQ(zen::select_escape_scanner(level)(block), expected);
+    }
+  }
+}
+
+TEST(SimdEscape, AllLevelsNarrowTheSamePrefix) {
+  std::mt19937 rng(42);
+  const std::uint32_t alphabet[] = { 'a', 'Z', ' ', '~', '"', '\\', 0x1F, 0x7F, 0x80, 0xFF, 0x100, 0x10FFFF, 0xFFFFFFFF };
+  std::uint32_t in[64];
+  for (std::size_t round = 0; round < 1000; ++round) {
+    for (auto& ch: in) {
+      // Mostly plain characters, so that the prefixes are long
+      ch = rng() % 8 == 0 ? alphabet[rng() % std::size(alphabet)] : 'a' + rng() % 26;
+    }
+    unsigned char expected_out[64];
+    auto expected = zen::narrow_ascii_scalar(in, 64, expected_out);
+    if (zen::detect_simd_level() < zen::simd_level::sse42) {
+      continue;
+    }
+    unsigned char actual_out[64];
+    auto n = zen::select_ascii_narrower(zen::simd_level::sse42)(in, 64, actual_out);
+    // The vectorized version may stop early, but never too late
+    ASSERT_LE(n, expected);
+    ASSERT_GT(n + 16, expected);
+    ASSERT_EQ(std::memcmp(actual_out, expected_out, n), 0);
+  }
+}
@@ -1,4 +1,7 @@
 
+#include <string_view>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 #include "zen/unicode.hpp"
@@ -18,3 +21,25 @@ TEST(UTF8Decode, CanDecodeASCIIChars) {
   ASSERT_EQ(str[8], '3');
   ASSERT_EQ(str[9], '4');
 }
+
+static std::vector<zen::unicode_char> code_points_of(std::string_view text) {
+  std::vector<zen::unicode_char> out;
+  for (auto ch: zen::utf8_code_points(text)) {
+    out.push_back(ch);
+  }
+  return out;
+}
+
+TEST(UTF8Decode, CanIterateOverCodePoints) {
+  using chars = std::vector<zen::unicode_char>;
+  ASSERT_EQ(code_points_of(""), chars());
+  ASSERT_EQ(code_points_of("a\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80z"), chars({ 'a', 0xE9, 0x20AC, 0x1F600, 'z' }));
+  // Invalid and cut-off sequences are replaced
+  ASSERT_EQ(code_points_of("a\xff" "b"), chars({ 'a', 0xFFFD, 'b' }));
+  // A cut-off sequence is replaced as a whole
+  ASSERT_EQ(code_points_of("a\xe2\x82"), chars({ 'a', 0xFFFD }));
+  ASSERT_EQ(code_points_of("a\xe2\x82" "b"), chars({ 'a', 0xFFFD, 'b' }));
+  // Overlong encodings and surrogates are not valid
+  ASSERT_EQ(code_points_of("\xc0\xaf"), chars({ 0xFFFD, 0xFFFD }));
+  ASSERT_EQ(code_points_of("\xed\xa0\x80"), chars({ 0xFFFD, 0xFFFD, 0xFFFD }));
+}